@@ -0,0 +1,10 @@
+START
+ MOI A,3
+ MOI C,0
+ LOP A
+ JZR B,SKIP
+ INC C
+SKIP
+ DEC B
+ ELP
+ HLT
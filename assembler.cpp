@@ -16,22 +16,38 @@
 
 #include<cstdio>
 #include<fstream>
+#include<iostream>
 #include<cctype>
 #include<string>
 #include<cstring>
 #include<cstdlib>
 #include<iomanip>
 #include<cstdlib>
+#include<sstream>
+#include<chrono>
+#include<vector>
+#include<unordered_map>
+#include<unistd.h>
+#include "isa.h"
 
 /**
  *Macros
  */
 #define INPUT_WIDTH 50					//Specifies Max length for an instruction
 #define INPUT_HEIGHT 10000				//Specifies Max number of instructions
-#define SYMB_TAB_SIZE 1000 				//Specifies size of Symbol Table
+#define SYMB_TAB_SIZE 1000 				//Specifies size of Symbol Table, without --stream
 #define LABEL_SIZE 15 					//Specifies max-size of a Label
 #define MNEUMONIC_SIZE 5 				//Specifies max-size of a Mneumonic
 #define NUMBER_OF_REG 28				//Specifies total number of Registers
+#define MAX_LOOPS 1000					//Specifies max number of loops for WCET analysis
+#define UNBOUNDED (~0ULL)				//Cycle count of code whose execution time has no bound
+#define MAX_REWRITES 20000				//Specifies max number of rewrites read from rewrite database
+#define MAX_REWRITE_LENGTH 6			//Specifies max number of instructions in a rewrite pattern
+#define MAX_REWRITE_VARS 8				//Specifies max number of registers used by a rewrite
+#define SCHEDULE_WINDOW 64				//Specifies max number of instructions reordered together by scheduler
+#define MEM_READ 1						//Instruction reads memory
+#define MEM_WRITE 2						//Instruction writes memory
+#define MAY_TRAP 4						//Instruction may stop the program with an error
 
 using namespace std;
 
@@ -41,51 +57,124 @@ using namespace std;
  */
 int currentIndex=0,currentRow=0,instructionLocationCounter=0,symbTableCount=0;
 int verbosFlag=0;
-char sourceProgram[INPUT_HEIGHT][INPUT_WIDTH];		//Array to store source
+int optimizeLevel=0;			//Optimizations to run on the output, 0 for none
+int unrollFactor=0;				//Times a loop body is repeated by unroller, 0 for automatic
+int unrollBudget=256;			//Max number of bytes unroller may add to the program
+int wcetFlag=0;					//Report worst case execution time of the program
+int defaultLoopBound=0;			//Iterations assumed for loops whose count is not known, 0 for unbounded
+const char *profileFileName=NULL;	//Execution profile used to lay out blocks
+const char *rewriteFileName=NULL;	//Rewrite database made by cass-superopt
+int scheduleFlag=0;				//Reorder instructions of basic blocks to avoid pipeline stalls
+int debugFlag=0;				//Write labels and source line of every address in a symbol file
+char sourceProgram[INPUT_HEIGHT][INPUT_WIDTH+1];	//Array to store source, a window of it with --stream, 1 more for '\r' 
+int sourceRow[2*INPUT_HEIGHT+2];		//Source row of instruction at every word, filled in second pass
 bool isEnd;					//To check if End Of File is reached
+int streamFlag=0;			//Read source window by window in both passes, memory grows only with labels
+istream *streamIn=NULL;		//Source read by windows with --stream, NULL if it is all in "sourceProgram"
+int windowRows=0;			//Rows of "sourceProgram" holding source
+int rowBase=0;				//Line of source held in row 0 of "sourceProgram", counting from 0
+int linesRead=0;			//Lines read from source by "readLines"
+long bytesRead=0;			//Bytes read from source by "readLines"
+bool isInputEnd=false;		//Last line of source is read
 int baseAddress=0;			//Base Address of the program after loading into memory
 
 
+/**
+ *Value of a register at some point of the program, as known by the optimizer
+ *@int VAL_UNDEF if point is not reached yet, VAL_CONST if value is always "value", VAL_VARYING otherwise
+ *@unsigned int Value of register if it is a constant
+ */
+struct lattice {
+	int kind;
+	unsigned int value;
+};
+
+typedef struct lattice lattice;
+
+#define VAL_UNDEF 0
+#define VAL_CONST 1
+#define VAL_VARYING 2
+#define FLAG_SLOT NUMBER_OF_REG			//Index of flag register in state of registers
+#define FLAG_MASK (1u<<FLAG_SLOT)		//Bit of flag register in masks of registers
+
+
 /**
  *Function declarations
  */
 void stripNewLines(int);
-void parse(ofstream &);
+int readLines(istream & , int );
+void nextWindow(bool );
+void parse(ostream &);
+void writeTarget(ostream &, char * );
+void flushPending(ostream &);
 void eatWhiteSpace(void);
-void labelScan(ofstream &,bool);
+void labelScan(ostream &,bool);
 char * getLabelName();
 char * getMemory();
 void insertInSymbolTable(char * );
-void readMneumonic(ofstream &,bool );
-void mneumonicCompare(ofstream &, char * , bool );
-void interpretLDR(ofstream &, bool );
-void interpretSTR(ofstream & ,bool);
-void interpretMAI(ofstream & ,bool );
-void interpretJZR(ofstream & ,bool );
-void interpretJUM(ofstream &, bool );
-void interpretJMC(ofstream &, bool );
-void interpretJMZ(ofstream &, bool );
-void interpretJMP(ofstream &, bool );
-void interpretMVR(ofstream &, bool );
-void interpretADD(ofstream &, bool );
-void interpretSUB(ofstream &, bool );
-void interpretMUL(ofstream &, bool );
-void interpretDIV(ofstream &, bool );
-void interpretMOD(ofstream &, bool );
-void interpretSTI(ofstream &, bool );
-void interpretNOT(ofstream &, bool );
-void interpretMOI(ofstream &, bool );
-void interpretINC(ofstream &, bool );
-void interpretDEC(ofstream &, bool );
-void interpretLOP(ofstream &, bool );
-void interpretELP(ofstream &, bool );
-void interpretHLT(ofstream &, bool );
-void interpretNOP(ofstream &, bool );
-void dataToBinary(ofstream & ,char * );
-void regToBinary(ofstream &, char * );
-void hexToBinary(ofstream &,char * );
+void readMneumonic(ostream &,bool );
+void mneumonicCompare(ostream &, char * , bool );
+void interpretInstruction(ostream &, int , bool );
+int readRegister(bool );
+void readOperand(char * , int );
+void operandError(const char * );
+void writeBits(ostream &, unsigned int , int );
+void dataToBinary(ostream & ,char * );
+int hexToAddress(char * );
 int searchSymbolTable(char * );
 unsigned long long int decToBinary(int );
+void loadProgram(istream &);
+int nextLive(int );
+void compactProgram(void);
+bool flagsLiveAfter(int );
+void peephole(void);
+void writeProgram(ostream &);
+bool matchLoops(void);
+int successors(int , int * );
+unsigned int useMask(instruction * );
+unsigned int defMask(instruction * );
+bool hasSideEffect(int );
+void transferState(int , lattice * );
+void propagateConstants(void);
+void computeLiveness(void);
+bool foldInstruction(int );
+void dataflowOptimize(void);
+int findCounterRegister(int );
+bool unrollLoops(void);
+void setDefaultCosts(void);
+void readCostTable(const char * );
+void buildCFG(void);
+void findBackEdges(int );
+void findDominators(int * );
+bool dominates(int , int );
+void findLoops(void);
+unsigned long long addCycles(unsigned long long , unsigned long long );
+int nodeOf(int , int );
+unsigned long long nodeCycles(int );
+unsigned long long longestPath(int , int , int );
+char * nodeName(int , char * );
+void printPath(int );
+void estimateWCET(void);
+void readProfile(const char * );
+int fallSuccessor(int );
+unsigned long long takenJumps(int * , int );
+void layoutProgram(const char * );
+int parseRewriteSide(char * , instruction * , unsigned int * );
+void readRewrites(const char * );
+void writeSymbols(const char * , const char * );
+void endPhase(int );
+void printPhaseTimes(int , long );
+void printStats(int , long , long );
+void writeTraceJson(const char * , int , long , long );
+void applyRewrites(void);
+void setDefaultLatencies(void);
+void readLatencyTable(const char * );
+int memoryAccess(instruction * );
+unsigned int resultLatency(instruction * );
+unsigned long long blockStalls(int * , int );
+bool isDependent(int , int );
+void scheduleWindow(int * , int );
+void scheduleProgram(void);
 
 
 /**
@@ -100,7 +189,207 @@ struct symbol {
 
 typedef struct symbol symbol;
 
-symbol symbolTable[SYMB_TAB_SIZE];			//Global array to store symbol table
+vector<symbol> symbolTable;					//Global array to store symbol table
+unordered_map<string,int> symbolIndex;		//Index in "symbolTable" of every label
+
+
+/**
+ *Structure to hold a jump whose label was not defined yet, when input is read in one pass
+ *@long Position of 16 bit address in "pendingOut"
+ *@string Label Name
+ *@int Line number of jump
+ */
+struct fixup {
+	long position;
+	string label;
+	int line;
+};
+
+typedef struct fixup fixup;
+
+bool onePassFlag=false;						//Input "-" is assembled in one pass, as it arrives
+ostringstream pendingOut;					//Output held until every label used in it is defined
+vector<fixup> fixups;						//Jumps of "pendingOut" to be patched
+unordered_map<string,int> pendingLabels;	//Labels used but not defined yet, with line of first use
+
+
+/**
+ *Stream buffer to write to a C file, image is written by it to stdout when output is "-"
+ */
+class fileBuffer : public streambuf {
+public:
+	fileBuffer(FILE * file) : file(file), written(0) {}
+protected:
+	int overflow(int c)
+	{
+		if(c == EOF)
+			return 0;
+		written++;
+		return fputc(c,file);
+	}
+	streamsize xsputn(const char * text, streamsize count)
+	{
+		written += count;
+		return fwrite(text,1,count,file);
+	}
+	int sync()
+	{
+		return fflush(file);
+	}
+	pos_type seekoff(off_type offset, ios::seekdir direction, ios::openmode )
+	{
+		return offset == 0 && direction == ios::cur ? pos_type(written) : pos_type(-1);	//Only for tellp
+	}
+private:
+	FILE *file;
+	long written;
+};
+
+
+/**
+ *Structure to hold an instruction of the program while it is optimized
+ *@instruction Decoded fields of the instruction
+ *@int Index of instruction in "optProgram" where the jump lands, -1 if not a jump
+ *@int Instruction Location Counter value
+ *@int Row of source program the instruction came from
+ *@bool True if the optimizer has removed this instruction
+ */
+struct optInstruction {
+	instruction code;
+	int target;
+	int ILC;
+	int row;
+	bool isDeleted;
+};
+
+typedef struct optInstruction optInstruction;
+
+optInstruction optProgram[INPUT_HEIGHT+1];		//Program being optimized
+int optCount=0;								//Number of instructions in "optProgram"
+int labelIndex[SYMB_TAB_SIZE];				//Index in "optProgram" of each label in symbol table
+int loopMate[INPUT_HEIGHT+1];				//Index of matching ELP for a LOP and vice versa
+bool isReached[INPUT_HEIGHT+1];				//Instruction can be reached from start of program
+lattice stateIn[INPUT_HEIGHT+1][NUMBER_OF_REG+1];	//Registers and flags before each instruction
+unsigned int liveOut[INPUT_HEIGHT+1];		//Registers and flags read after each instruction
+
+
+/**
+ *Structure to hold a basic block of the control flow graph
+ *@int Index of first instruction in "optProgram"
+ *@int Index of instruction following the block
+ *@int Successor blocks, "blockCount" if program ends
+ *@unsigned long long Cycles to execute the block once
+ *@int Innermost loop containing the block, -1 if none
+ */
+struct basicBlock {
+	int first;
+	int end;
+	int succ[2];
+	int succCount;
+	unsigned long long cycles;
+	int loop;
+};
+
+typedef struct basicBlock basicBlock;
+
+
+/**
+ *Structure to hold a loop of the control flow graph
+ *@int Header block through which loop is entered
+ *@int Innermost loop containing this loop, -1 if none
+ *@bool True for LOP/ELP loops, false for loops made by jumps
+ *@unsigned long long Max number of iterations, UNBOUNDED if not known
+ *@unsigned long long Cycles of the longest iteration
+ *@unsigned long long Cycles of all iterations
+ *@bool* Blocks which are part of the loop
+ */
+struct loopInfo {
+	int header;
+	int parent;
+	bool isHardware;
+	unsigned long long bound;
+	unsigned long long iterationCycles;
+	unsigned long long totalCycles;
+	bool *isMember;
+};
+
+typedef struct loopInfo loopInfo;
+
+unsigned long long cycleCost[OP_INVALID+1];	//Cycles taken by each operation, set from cost table
+unsigned long long takenCost=0;				//Extra cycles when a jump is taken
+bool isCostSet=false;						//Default costs have been filled in "cycleCost"
+basicBlock blocks[INPUT_HEIGHT+1];			//Basic blocks of "optProgram"
+int blockCount=0;
+int blockOf[INPUT_HEIGHT+1];				//Block of every instruction
+loopInfo loops[MAX_LOOPS];
+int loopCount=0;
+int pathNext[2*INPUT_HEIGHT+2];				//Next node on the longest path from a node
+int visitState[INPUT_HEIGHT+1];				//Depth first search of blocks, 0 not visited, 1 on stack, 2 finished
+int postOrder[INPUT_HEIGHT+1];				//Blocks in order in which depth first search finished them
+int postCount=0;
+int idom[INPUT_HEIGHT+1];					//Immediate dominator of every block, -1 if not reached
+unsigned long long profileHits[INPUT_HEIGHT+1];		//Times each instruction was executed
+unsigned long long profileTaken[INPUT_HEIGHT+1];	//Times each jump was taken
+unsigned int latency[OP_INVALID+1];			//Cycles before result of each operation can be read
+unsigned int loadLatency=2;					//Cycles before result of MVR X,ME can be read
+bool isLatencySet=false;					//Default latencies have been filled in "latency"
+
+
+/**
+ *Structure to hold a rewrite of the superoptimizer
+ *Register fields of instructions hold variables (%0, %1 ...) which are bound to registers on match
+ *@instruction Sequence to be searched
+ *@instruction Cheaper sequence computing same registers
+ *@int Bytes saved by the rewrite
+ */
+struct rewriteRule {
+	instruction pattern[MAX_REWRITE_LENGTH];
+	int patternLength;
+	instruction replacement[MAX_REWRITE_LENGTH];
+	int replacementLength;
+	int saving;
+};
+
+typedef struct rewriteRule rewriteRule;
+
+rewriteRule rewriteRules[MAX_REWRITES];
+int rewriteCount=0;
+
+
+/**
+ *Phases of an assembly timed by --phase-times, --stats and --trace-json
+ *Order must be same as of array "phaseName"
+ */
+enum phase {
+	PHASE_READ,		PHASE_STRIP,	PHASE_PASS1,	PHASE_PASS2,
+	PHASE_OPTIMIZE,	PHASE_WRITE,	PHASE_COUNT
+};
+
+static const char * const phaseName[] = {
+	"read",		"strip",	"pass1",	"pass2",
+	"optimize",	"write"
+};
+
+/**
+ *Structure to hold one timed span of a phase, in seconds from start of assembly
+ */
+struct phaseSpan {
+	int phase;
+	double start;
+	double end;
+};
+
+typedef struct phaseSpan phaseSpan;
+
+int phaseTimesFlag=0;			//Print time taken by every phase as JSON
+int statsFlag=0;				//Print time of every phase and counters
+const char *traceJsonFileName=NULL;	//Chrome trace of phases
+bool isInstrumented=false;		//Any of above is on, phases are not timed otherwise
+double phaseSeconds[PHASE_COUNT];
+vector<phaseSpan> phaseSpans;
+chrono::steady_clock::time_point phaseStart,instrumentStart;
+long long symbolProbes=0;		//Entries of symbol table compared by searchSymbolTable
+int instructionCount=0;			//Instructions read by second pass
 
 
 /**
@@ -108,10 +397,12 @@ symbol symbolTable[SYMB_TAB_SIZE];			//Global array to store symbol table
  */
 int main(int argc, char const *argv[])
 {
-	int inputNumberOfLines,i,j;
+	int inputNumberOfLines=0,i;
+	long inputBytes,outputBytes;
 	char const *inputFileName,*outputFileName;
 	ifstream fileIn;
 	ofstream fileOut;
+	FILE *imageFile=NULL;				//stdout, when output is "-"
 
 	if(argc <2)
 	{
@@ -121,60 +412,186 @@ int main(int argc, char const *argv[])
 
 	if(!strcmp(argv[1],"--help"))
 	{
-		printf("\n\t\tcass: Usage: %s [options] input_file out_file\n\t\t[options]\t-v \t For verbose output\n\t\t\t\t--help \t For help and sample usage\n\n\t\tInput file must be present in same directory",argv[0]);
-		printf("\n\t\tNew line character \\r\\n\n\t\tMneumonics must begin with space\n\t\tLine containing Label should not contain any Mneumonic and must not begin with space\n\t\t");
+		printf("\n\t\tcass: Usage: %s [options] input_file out_file\n\t\t[options]\t-v \t For verbose output\n\t\t\t\t-g \t Write labels and source lines in out_file.sym\n\t\t\t\t-O1 \t Run peephole optimizer on the output\n\t\t\t\t-O2 \t Also fold constants and remove dead code\n\t\t\t\t-O3 \t Also unroll LOP/ELP loops with known trip count\n\t\t\t\t--unroll-factor=N \t Unroll loops N times, 0 to choose automatically\n\t\t\t\t--unroll-budget=N \t Max bytes added by unrolling (default 256)\n\t\t\t\t--wcet \t Report worst case execution time in cycles\n\t\t\t\t--cost-table=FILE \t Cycles of each mneumonic for --wcet\n\t\t\t\t--loop-bound=N \t Iterations assumed for loops with unknown count\n\t\t\t\t--profile=FILE \t Reorder blocks so that hot paths of profile fall through\n\t\t\t\t--rewrites=FILE \t Apply rewrite database made by cass-superopt\n\t\t\t\t--schedule \t Reorder instructions to avoid pipeline stalls (on by -O2)\n\t\t\t\t--latency-table=FILE \t Result latency of each mneumonic for scheduler\n\t\t\t\t--phase-times \t Print seconds taken by every phase as JSON\n\t\t\t\t--stats \t Print time of every phase, lines, instructions, symbol table probes and bytes written\n\t\t\t\t--trace-json=FILE \t Write phases as Chrome trace events\n\t\t\t\t--stream \t Read source in windows in both passes, for sources larger than memory\n\t\t\t\t--help \t For help and sample usage\n\n\t\tInput file must be present in same directory\n\t\tinput_file and out_file may be \"-\" for stdin and stdout",argv[0]);
+		printf("\n\t\tNew line character \\r\\n or \\n\n\t\tMneumonics must begin with space\n\t\tLine containing Label should not contain any Mneumonic and must not begin with space\n\t\t");
 		printf("Address must be specified in 4bit hexadecimal format.\n\t\tImmediate data must be in Decimal\n\t\tSample Usage:\n\t\tSTART\n\t\t LDR A,2048H\n\t\t MVR B,A\n\t\t LOP A\n\t\t MUL C,B\n\t\t DEC B\n\t\t HLT\n\n");
 		exit(0);
 	}
 
-	if(argc <3)
+	for(i=1;i<argc && argv[i][0] == '-' && argv[i][1] != '\0';i++)		//Reading options, "-" is stdin or stdout
+	{
+		if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(!strcmp(argv[i],"-g"))
+			debugFlag=1;
+		else if(!strcmp(argv[i],"-O0"))
+			optimizeLevel=0;
+		else if(!strcmp(argv[i],"-O1"))
+			optimizeLevel=1;
+		else if(!strcmp(argv[i],"-O2"))
+			optimizeLevel=2;
+		else if(!strcmp(argv[i],"-O3"))
+			optimizeLevel=3;
+		else if(!strncmp(argv[i],"--unroll-factor=",16))
+			unrollFactor = atoi(argv[i]+16);
+		else if(!strncmp(argv[i],"--unroll-budget=",16))
+			unrollBudget = atoi(argv[i]+16);
+		else if(!strcmp(argv[i],"--wcet"))
+			wcetFlag=1;
+		else if(!strncmp(argv[i],"--cost-table=",13))
+			readCostTable(argv[i]+13);
+		else if(!strncmp(argv[i],"--loop-bound=",13))
+			defaultLoopBound = atoi(argv[i]+13);
+		else if(!strncmp(argv[i],"--profile=",10))
+			profileFileName = argv[i]+10;
+		else if(!strcmp(argv[i],"--schedule"))
+			scheduleFlag=1;
+		else if(!strncmp(argv[i],"--latency-table=",16))
+			readLatencyTable(argv[i]+16);
+		else if(!strcmp(argv[i],"--phase-times"))
+			phaseTimesFlag=1;
+		else if(!strcmp(argv[i],"--stats"))
+			statsFlag=1;
+		else if(!strcmp(argv[i],"--stream"))
+			streamFlag=1;
+		else if(!strncmp(argv[i],"--trace-json=",13))
+			traceJsonFileName = argv[i]+13;
+		else if(!strncmp(argv[i],"--rewrites=",11))
+		{
+			rewriteFileName = argv[i]+11;
+			readRewrites(rewriteFileName);
+		}
+		else
+		{
+			fprintf(stderr,"cass: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+
+	if(argc-i <2)
 	{
 		printf("cass: Usage: %s input_file output_file\nFor help use %s --help\n",argv[0],argv[0]);
 		return 0;
 	}
+	inputFileName = argv[i];
+	outputFileName = argv[i+1];
+	if(streamFlag && (optimizeLevel || wcetFlag || profileFileName || rewriteFileName || scheduleFlag || debugFlag))
+	{
+		fprintf(stderr,"cass: --stream can not be used with optimizations, --wcet, --profile, --rewrites, --schedule or -g, they need whole program\n");
+		return 1;
+	}
+	if(!strcmp(inputFileName,"-") && (optimizeLevel || wcetFlag || profileFileName || rewriteFileName || scheduleFlag || debugFlag))
+	{
+		fprintf(stderr,"cass: Input \"-\" can not be used with optimizations, --wcet, --profile, --rewrites, --schedule or -g, they need whole program\n");
+		return 1;
+	}
+	if(!strcmp(outputFileName,"-"))
+	{
+		if(debugFlag)
+		{
+			fprintf(stderr,"cass: -g needs an output file to name out_file.sym\n");
+			return 1;
+		}
+		imageFile = fdopen(dup(1),"w");		//Image is written to stdout
+		dup2(2,1);							//and everything cass prints goes to stderr
+	}
+	fileBuffer imageBuffer(imageFile);
+	ostream imageOut(&imageBuffer);
+	ostream & out = imageFile ? imageOut : fileOut;
 
-	if(!strcmp(argv[1],"-v"))
+	if(!strcmp(inputFileName,"-"))
+	{
+		ios::sync_with_stdio(false);		//cin keeps its own buffer, to know if more input has arrived
+		streamIn = &cin;
+		onePassFlag = true;
+	}
+	else
 	{
-		verbosFlag=1;
-		if(argc<4)
+		fileIn.open(inputFileName,ios::in);
+		if(!fileIn)
 		{
-			printf("cass: Usage: %s input_file output_file\nFor help use %s --help\n",argv[0],argv[0]);
-			return 0;
+			fprintf(stderr,"cass: Input file not found !!\n");
+			return 1;
 		}
-		inputFileName = argv[2];
-		outputFileName = argv[3];
 	}
+	isInstrumented = phaseTimesFlag || statsFlag || traceJsonFileName;
+	if(isInstrumented)
+		instrumentStart = phaseStart = chrono::steady_clock::now();
+
+	if(streamIn)
+		;									//Windows of "-" are read by parse
+	else if(streamFlag)
+		streamIn = &fileIn;					//Windows are read by parse
 	else
 	{
-		inputFileName = argv[1];
-		outputFileName = argv[2];
+		windowRows = readLines(fileIn,INPUT_HEIGHT);
+		if(!isInputEnd)
+		{
+			fprintf(stderr,"cass: Program has more than %d lines, use --stream\n",INPUT_HEIGHT-1);
+			return 1;
+		}
+		inputNumberOfLines = windowRows-1;
+		fileIn.close();
+		endPhase(PHASE_READ);
+		stripNewLines(inputNumberOfLines);
+		endPhase(PHASE_STRIP);
 	}
-
-	fileIn.open(inputFileName,ios::in);
-	if(!fileIn)
+	if(!imageFile)
+		fileOut.open(outputFileName,ios::out);		//WARNING : This will destroy the previous contents of the file
+	endPhase(PHASE_WRITE);
+	if(optimizeLevel || wcetFlag || profileFileName || rewriteFileName || scheduleFlag)
 	{
-		fprintf(stderr,"cass: Input file not found !!\n");
-		return 1;
+		ostringstream encoded;					//Output of second pass is optimized before writing
+		parse(encoded);
+		istringstream encodedIn(encoded.str());
+		loadProgram(encodedIn);
+		if(optimizeLevel >= 2)
+			dataflowOptimize();
+		if(optimizeLevel >= 3 && unrollLoops())
+			dataflowOptimize();
+		if(rewriteFileName)
+			applyRewrites();
+		if(optimizeLevel >= 1)
+			peephole();
+		if(optimizeLevel >= 2 || scheduleFlag)
+			scheduleProgram();
+		if(profileFileName)
+			layoutProgram(profileFileName);
+		if(wcetFlag)
+			estimateWCET();
+		endPhase(PHASE_OPTIMIZE);
+		writeProgram(out);
 	}
-
-	inputNumberOfLines=0;
-	while(1)
+	else if(isInstrumented && !streamIn)
 	{
-		if(inputNumberOfLines != 0)
-			fileIn.ignore();			//ignoring excess "\n"
-		fileIn.getline(sourceProgram[inputNumberOfLines],INPUT_WIDTH,'\r');
-		fflush(stdout);
-		fflush(stdin);
-		if(fileIn.eof())
-			break;
-		inputNumberOfLines++;
+		ostringstream encoded;					//Pass 2 is kept apart from writing to be timed
+		parse(encoded);
+		out<<encoded.str();
 	}
-
-	fileIn.close();
-	fileOut.open(outputFileName,ios::out);		//WARNING : This will destroy the previous contents of the file
-	stripNewLines(inputNumberOfLines);
-	parse(fileOut);
-	printf("Output successfully written to file \"%s\" \n",outputFileName);
+	else
+		parse(out);
+	if(streamIn)
+		inputNumberOfLines = linesRead - isInputEnd;
+	inputBytes = bytesRead;
+	outputBytes = out.tellp();
+	if(imageFile)
+	{
+		out.flush();
+		fclose(imageFile);
+	}
+	else
+		fileOut.close();
+	if(debugFlag)
+		writeSymbols(inputFileName,outputFileName);
+	endPhase(PHASE_WRITE);
+	if(!imageFile)
+		printf("Output successfully written to file \"%s\" \n",outputFileName);
+	if(phaseTimesFlag)
+		printPhaseTimes(inputNumberOfLines,inputBytes);
+	if(statsFlag)
+		printStats(inputNumberOfLines,inputBytes,outputBytes);
+	if(traceJsonFileName)
+		writeTraceJson(traceJsonFileName,inputNumberOfLines,inputBytes,outputBytes);
 	return 0;
 }
 
@@ -211,25 +628,126 @@ void stripNewLines(int numberOfLines)
 
 /**
  *Function to parse the input file in two passes
- *@param 	ofstream& fileOut				//Output File stream
+ *@param 	ostream& fileOut				//Output File stream
  *@return void
  */
-void parse(ofstream & fileOut)
+void parse(ostream & fileOut)
 {
 	currentRow = 0;
 	currentIndex =0;
+	if(onePassFlag)
+	{
+		//One pass, output is held only while a label used in it is not defined
+		while(!isEnd)
+		{
+			if(currentRow == windowRows)
+			{
+				if(streamIn->rdbuf()->in_avail() <= 0)
+					fileOut.flush();		//Reader gets all output before waiting for more input
+				nextWindow(false);
+			}
+			labelScan(pendingOut,false);
+			if(pendingLabels.empty())
+				flushPending(fileOut);
+		}
+		if(!pendingLabels.empty())
+		{
+			fprintf(stderr,"cass: Error at line number: %d\n Label Not found\n",pendingLabels.begin()->second);
+			exit(1);
+		}
+		endPhase(PHASE_PASS2);
+		return;
+	}
 	//First Pass
 	while(!isEnd)
+	{
+		if(currentRow == windowRows)
+			nextWindow(true);
 		labelScan(fileOut,true);			//Just create symbol table
+	}
+	endPhase(PHASE_PASS1);
 
 	currentRow =0;						//Reverting all the counters to zero
 	currentIndex =0;
 	isEnd = false;
 	instructionLocationCounter = 0;
+	memset(sourceRow,-1,sizeof(sourceRow));
+	if(streamIn)						//Source is read again from its start
+	{
+		streamIn->clear();
+		streamIn->seekg(0,ios::beg);
+		windowRows = rowBase = linesRead = 0;
+		bytesRead = 0;
+		isInputEnd = false;
+	}
 
 	//Second Pass Pass
 	while(!isEnd)
+	{
+		if(currentRow == windowRows)
+			nextWindow(false);
 		labelScan(fileOut,false);			//Write output to the file
+	}
+	endPhase(PHASE_PASS2);
+}
+
+
+/**
+ *Function to read next lines of source into rows of "sourceProgram" from row 0
+ *Lines end with "\r\n" or "\n", text after last line end is read as one more row
+ *@param 	istream& fileIn					//Input File stream
+ *@param 	int maxRows 					//Max rows to read
+ *@return Number of rows read, "isInputEnd" is set once last row is read
+ */
+int readLines(istream & fileIn, int maxRows)
+{
+	int rows=0,length;
+	while(rows < maxRows && !isInputEnd)
+	{
+		fileIn.getline(sourceProgram[rows],INPUT_WIDTH+1,'\n');
+		linesRead++;
+		bytesRead += fileIn.gcount();
+		if(fileIn.eof())
+			isInputEnd = true;
+		else if(fileIn.fail())
+		{
+			fprintf(stderr,"cass: Error at line number : %d\n Line is longer than %d characters\n",linesRead,INPUT_WIDTH-1);
+			exit(1);
+		}
+		length = strlen(sourceProgram[rows]);
+		if(length != 0 && sourceProgram[rows][length-1] == '\r')
+			sourceProgram[rows][--length] = '\0';
+		if(length >= INPUT_WIDTH)
+		{
+			fprintf(stderr,"cass: Error at line number : %d\n Line is longer than %d characters\n",linesRead,INPUT_WIDTH-1);
+			exit(1);
+		}
+		rows++;
+	}
+	return rows;
+}
+
+
+/**
+ *Function to move to next window of source when a pass has used all rows of "sourceProgram"
+ *Rows read and stripped are timed as read and strip, not as the pass
+ *@param 	bool isFirstPass				//First pass or second pass
+ *@return void
+ */
+void nextWindow(bool isFirstPass)
+{
+	if(!streamIn || isInputEnd)
+	{
+		fprintf(stderr,"cass: Program has no HLT\n");
+		exit(1);
+	}
+	endPhase(isFirstPass ? PHASE_PASS1 : PHASE_PASS2);
+	rowBase += windowRows;
+	windowRows = readLines(*streamIn,onePassFlag ? 1 : INPUT_HEIGHT);	//A line of "-" is assembled once it arrives
+	endPhase(PHASE_READ);
+	stripNewLines(windowRows-1);
+	endPhase(PHASE_STRIP);
+	currentRow = 0;
 }
 
 
@@ -248,16 +766,16 @@ void eatWhiteSpace(void)
 
 /**
  *Function to scan input and detect if it is label or mnemonic
- *@param 	ofstream& fileOut				//Output File stream
+ *@param 	ostream& fileOut				//Output File stream
  *@param 	bool isFirstPass				//First pass or second pass
  *@return void
  */
-void labelScan(ofstream & fileOut,bool isFirstPass)
+void labelScan(ostream & fileOut,bool isFirstPass)
 {
 	if(sourceProgram[currentRow][currentIndex] != ' ' && sourceProgram[currentRow][currentIndex] != '\t') //Label will not contain any space at the beginning
 	{
 		//Code to generate symbol table
-		if(isFirstPass && sourceProgram[currentRow][currentIndex] != '\0')
+		if((isFirstPass || onePassFlag) && sourceProgram[currentRow][currentIndex] != '\0')
 		{
 			insertInSymbolTable(getLabelName());
 		}
@@ -266,6 +784,7 @@ void labelScan(ofstream & fileOut,bool isFirstPass)
 		return;
 	}
 	eatWhiteSpace();								//Mneumonic will always start with alteast 1 space
+	instructionCount += !isFirstPass;
 	readMneumonic(fileOut,isFirstPass);
 }
 
@@ -290,22 +809,36 @@ char * getLabelName()
 void insertInSymbolTable(char * name)
 {
 	int i;
-	static int index =0;			//To keep an count of index of array "searchSymbolTable"
+	int index = symbolTable.size();	//Index of label in array "symbolTable"
 
 	if(searchSymbolTable(name) != -1)  				//If Label already exists in symbol table
 	{
-		fprintf(stderr, "cass: Error at line number: %d\n Label Already used\n",currentRow+1);
+		fprintf(stderr, "cass: Error at line number: %d\n Label Already used\n",rowBase+currentRow+1);
+		exit(1);
+	}
+	if(index == SYMB_TAB_SIZE && !streamIn)
+	{
+		fprintf(stderr, "cass: Error at line number: %d\n More than %d labels, use --stream\n",rowBase+currentRow+1,SYMB_TAB_SIZE);
 		exit(1);
 	}
+	if(strlen(name) >= LABEL_SIZE)
+	{
+		fprintf(stderr, "cass: Error at line number: %d\n Label is longer than %d characters\n",rowBase+currentRow+1,LABEL_SIZE-1);
+		exit(1);
+	}
+	symbolTable.push_back(symbol());
+	symbolIndex[name] = index;
 	symbolTable[index].ILC = instructionLocationCounter;	//Using Global ILC
 	for(i=0;name[i] !='\0';i++)		//Copying Label Name
 	{
 		symbolTable[index].label[i] =name[i];
 	}
 	symbolTable[index].label[i] = '\0'; //Inserting null char at the end
+	if(onePassFlag)
+		pendingLabels.erase(name);
 	if(verbosFlag)
 	{
-		printf("\nLabel \"%s\" detected at Line number %d \nInstruction Location Counter: %d\n\n",name,currentRow+1,instructionLocationCounter );
+		printf("\nLabel \"%s\" detected at Line number %d \nInstruction Location Counter: %d\n\n",name,rowBase+currentRow+1,instructionLocationCounter );
 	}
 	index++;
 	symbTableCount = index;		//Global vairable symbTableCount to keep a count of total number of sym
@@ -316,11 +849,11 @@ void insertInSymbolTable(char * name)
 
 /**
  *Function to read a mneumonic
- *@param 	ofstream& fileOut				//Output File stream
+ *@param 	ostream& fileOut				//Output File stream
  *@param 	bool isFirstPass				//First pass or second pass
  *@return void
  */
-void readMneumonic(ofstream & fileOut,bool isFirstPass)
+void readMneumonic(ostream & fileOut,bool isFirstPass)
 {
 	int i=0;
 	char mneumonic[MNEUMONIC_SIZE];
@@ -333,6 +866,8 @@ void readMneumonic(ofstream & fileOut,bool isFirstPass)
 		currentIndex++;
 	}
 	mneumonic[i] = '\0';			//Storing mneumonic in array "mneumonic"
+	if(!isFirstPass && !streamIn)
+		sourceRow[instructionLocationCounter/4] = currentRow;
 	//Code to compare mnemnonic
 	mneumonicCompare(fileOut,mneumonic,isFirstPass);	//Function to compare given mneumonic
 	currentRow++;
@@ -341,1267 +876,2610 @@ void readMneumonic(ofstream & fileOut,bool isFirstPass)
 
 
 /**
- *Function to scan input and detect if it is label or mnemonic
- *@param 	ofstream& fileOut				//Output File stream
+ *Function to find operation of a mneumonic and interpret it
+ *@param 	ostream& fileOut				//Output File stream
  *@patam	char* Mneumonic 				//Actual name of mneumonic
  *@param 	bool isFirstPass				//First pass or second pass
  *@return void
  */
-void mneumonicCompare(ofstream & fileOut, char * mnemnonic, bool isFirstPass)
-{
-	if(!strcmp(mnemnonic,"LDR"))
-		interpretLDR(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"STR"))
-		interpretSTR(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"MAI"))
-		interpretMAI(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"JZR"))
-		interpretJZR(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"JUM"))
-		interpretJUM(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"JMC"))
-		interpretJMC(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"JMZ"))
-		interpretJMZ(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"JMP"))
-		interpretJMP(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"MVR"))
-		interpretMVR(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"ADD"))
-		interpretADD(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"SUB"))
-		interpretSUB(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"MUL"))
-		interpretMUL(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"DIV"))
-		interpretDIV(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"MOD"))
-		interpretMOD(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"OR2"))
-	// 	interpretOR2(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"AND"))
-	// 	interpretAND(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"XOR"))
-	// 	interpretXOR(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"COM"))
-	// 	interpretCOM(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"STI"))
-		interpretSTI(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"NOT"))
-		interpretNOT(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"MOI"))
-		interpretMOI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"ADI"))
-	// 	interpretADI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"SUI"))
-	// 	interpretSUI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"MUI"))
-	// 	interpretMUI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"DVI"))
-	// 	interpretDVI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"MDI"))
-	// 	interpretMDI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"ANI"))
-	// 	interpretANI(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"ORI"))
-	// 	interpretORI(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"INC"))
-		interpretINC(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"DEC"))
-		interpretDEC(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"LHS"))
-	// 	interpretLHS(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"RHS"))
-	// 	interpretRHS(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"PSH"))
-	// 	interpretPSH(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"POP"))
-	// 	interpretPOP(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"OUT"))
-	// 	interpretOUT(fileOut,isFirstPass);
-	// else if(!strcmp(mnemnonic,"INP"))
-	// 	interpretINP(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"LOP"))
-		interpretLOP(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"ELP"))
-		interpretELP(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"HLT"))
-		interpretHLT(fileOut,isFirstPass);
-	else if(!strcmp(mnemnonic,"NOP"))
-		interpretNOP(fileOut,isFirstPass);
-	else				//Invalid Mnemonic
-	{
-		fprintf(stderr,"cass: Error at line number : %d\nInvalid mnemnonic!\n",currentRow+1);
+void mneumonicCompare(ostream & fileOut, char * mnemnonic, bool isFirstPass)
+{
+	int op;
+	for(op=0;op<OP_INVALID && strcmp(mnemnonic,mneumonicName[op]);op++)
+		;
+	if(op == OP_INVALID)			//Invalid Mnemonic
+	{
+		fprintf(stderr,"cass: Error at line number : %d\nInvalid mnemnonic!\n",rowBase+currentRow+1);
 		exit(1);
 	}
+	interpretInstruction(fileOut,op,isFirstPass);
 }
 
 
 /**
- *Function to interpret mneumonic "LDR"
- *@param 	ofstream& fileOut				//Output File stream
+ *Function to interpret an instruction, operands are read as given by its line of isa.def
+ *@param 	ostream& fileOut				//Output File stream
+ *@param 	int op 							//Operation (OP_XXX)
  *@param 	bool isFirstPass				//First pass or second pass
  *@return void
  */
-void interpretLDR(ofstream & fileOut, bool isFirstPass)
+void interpretInstruction(ostream & fileOut, int op, bool isFirstPass)
 {
-	int i=0;
-	char reg[3],addr[6];
-	char opcode[] = "00000000000";			//Opcode of "LDR"
+	int kind = isaOperands[op];
+	char text[LABEL_SIZE];
+	instruction ins;
+
 	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)						//If second pass
+	instructionLocationCounter += instructionSize(op);
+	if(op == OP_HLT)
+		isEnd = true;
+	if(isFirstPass)
+		return;
+
+	ins.op = op;
+	ins.reg1 = ins.reg2 = ins.addr = 0;
+	if(kind != ARGS_NONE && kind != ARGS_LABEL)
+		ins.reg1 = readRegister(kind != ARGS_REG);
+	if(kind == ARGS_REG_REG)
+		ins.reg2 = readRegister(false);
+	if(kind != ARGS_NONE && kind != ARGS_REG && kind != ARGS_REG_REG)
+		readOperand(text,sizeof(text));
+	if(sourceProgram[currentRow][currentIndex] != '\0')
+		operandError("Invalid operands");
+	if(kind == ARGS_REG_ADDR)
+		ins.addr = hexToAddress(text);
+	if(kind == ARGS_REG_PORT && (text[strspn(text,"0123456789")] != '\0' || strlen(text) > 10))
+		operandError("Invalid port");
+
+	if(kind == ARGS_REG_LABEL || kind == ARGS_LABEL)
 	{
-		while(1)							//Loop to read register
-		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)							//Loop to read address in HEXADECIMAL FORMAT
-		{
-			if(sourceProgram[currentRow][currentIndex] == 'h' || sourceProgram[currentRow][currentIndex] == 'H' || sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			addr[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-		}
-		addr[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg);
-		hexToBinary(fileOut,addr);
-		fileOut<<endl;
+		writeBits(fileOut,encodeWord(&ins)>>16,16);
+		writeTarget(fileOut,text);
+	}
+	else
+		writeBits(fileOut,encodeWord(&ins),WORD_SIZE);
+	fileOut<<'\n';
+	if(kind == ARGS_REG_DATA || kind == ARGS_REG_PORT)
+	{
+		dataToBinary(fileOut,text);		//Immediate data of MOI and port of OUT and INP are decimal
+		fileOut<<'\n';
 	}
 }
 
 
 /**
- *Function to interpret mneumonic "STR"
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	bool isFirstPass				//First pass or second pass
- *@return void
+ *Function to read a register operand, whitespace inside the operand is skipped
+ *@param 	bool hasNext					//Operand is followed by ',' and another operand
+ *@return Number of register
  */
-void interpretSTR(ofstream & fileOut,bool isFirstPass)
+int readRegister(bool hasNext)
 {
-	int i=0;
-	char reg[3],addr[6];
-	char opcode[] = "00000000001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	int i=0,reg;
+	char name[3];
+	while(sourceProgram[currentRow][currentIndex] != ',' && sourceProgram[currentRow][currentIndex] != '\0')
 	{
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg[i] = '\0';
+		if(i == 2)
+			operandError("Invalid register");
+		name[i++] = toupper(sourceProgram[currentRow][currentIndex]);
+		currentIndex++;
+		eatWhiteSpace();
+	}
+	name[i] = '\0';
+	for(reg=0;reg<NUMBER_OF_REG && strcmp(name,registerName[reg]);reg++)
+		;
+	if(reg == NUMBER_OF_REG)
+		operandError("Invalid register");
+	if(hasNext)
+	{
+		if(sourceProgram[currentRow][currentIndex] != ',')
+			operandError("Operand missing");
 		currentIndex++;
 		eatWhiteSpace();
-		i=0;
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == 'h' || sourceProgram[currentRow][currentIndex] == 'H' || sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			addr[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-		}
-		addr[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg);
-		hexToBinary(fileOut,addr);
-		fileOut<<endl;
 	}
+	return reg;
 }
 
 
-
 /**
- *Function to interpret mneumonic "MAI"
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	bool isFirstPass				//First pass or second pass
+ *Function to read an address, label, data or port operand upto the next whitespace
+ *@param 	char* text 						//Operand read
+ *@param 	int size 						//Size of "text"
  *@return void
  */
-void interpretMAI(ofstream & fileOut,bool isFirstPass)
+void readOperand(char * text, int size)
 {
 	int i=0;
-	char reg[3],addr[6];
-	char opcode[] = "00000000010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	while(sourceProgram[currentRow][currentIndex] != '\0' && sourceProgram[currentRow][currentIndex] != ' ' && sourceProgram[currentRow][currentIndex] != '\t')
 	{
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == 'h' || sourceProgram[currentRow][currentIndex] == 'H' || sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			addr[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-		}
-		addr[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg);
-		hexToBinary(fileOut,addr);
-		fileOut<<endl;
+		if(i == size-1)
+			operandError("Operand is too long");
+		text[i++] = sourceProgram[currentRow][currentIndex++];
 	}
+	text[i] = '\0';
+	if(i == 0)
+		operandError("Operand missing");
+	eatWhiteSpace();
 }
 
 
 /**
- *Function to interpret mneumonic "JZR"
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	bool isFirstPass				//First pass or second pass
+ *Function to report an invalid operand of current line and stop
+ *@param 	const char* message 			//What is wrong
  *@return void
  */
-void interpretJZR(ofstream & fileOut,bool isFirstPass)
+void operandError(const char * message)
 {
-	int i=0,ILC=0;
-	char reg[3],label[LABEL_SIZE];
-	char opcode[] = "00000000011";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
-	{
-		while(1)							//Loop to detect register used
-		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)						//Loop to detect Label Name
-		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			label[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-		}
-		label[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg);
-		ILC = searchSymbolTable(label);
-		if(ILC == -1)
-		{
-			fprintf(stderr,"Error at line number: %d\n Label Not found\n",currentRow+1);
-			exit(1);
-		}
-		fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
-		fileOut<<endl;
-	}
+	fprintf(stderr,"cass: Error at line number : %d\n%s\n",rowBase+currentRow+1,message);
+	exit(1);
 }
 
 
 /**
- *Function to interpret mneumonic "JUM"
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	bool isFirstPass				//First pass or second pass
+ *Function to write lowest bits of a value in binary, highest bit first
+ *@param 	ostream& fileOut				//Output File stream
+ *@param 	unsigned int value 				//Value to be written
+ *@param 	int bits 						//Number of bits
  *@return void
  */
-void interpretJUM(ofstream & fileOut,bool isFirstPass)
+void writeBits(ostream & fileOut, unsigned int value, int bits)
 {
-	int i=0,ILC=0;
-	char label[LABEL_SIZE];
-	char opcode[] = "0000000010000000";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
-	{
-		eatWhiteSpace();
-		i=0;
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			label[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
+	char text[WORD_SIZE];
+	int i;
+	for(i=0;i<bits;i++)
+		text[i] = '0' + (value>>(bits-1-i) & 1);
+	fileOut.write(text,bits);
+}
+
+
+/**
+ *Function to convert "immediate" DECIMAL data(in char form) into 32 bit binary data
+ *Negative data is written in two's complement, data beyond 32 bits keeps its lower 32 bits
+ *@param 	ostream& fileOut				//Output File stream
+ *@param 	char* data						//Array of data
+ *@return void
+ */
+void dataToBinary(ostream & fileOut,char * data)
+{
+	unsigned int bits = (unsigned int)strtoll(data,NULL,10);
+	int i;
+	for(i=WORD_SIZE-1;i>=0;i--)
+		fileOut<<(char)('0' + (bits>>i & 1));
+}
+
+
+/**
+ *Function to write 16 bit address of label of a jump
+ *When input is assembled in one pass, a label not defined yet is written as 0 and patched by "flushPending"
+ *@param 	ostream& fileOut				//Output File stream
+ *@param 	char* label 					//Name of label
+ *@return void
+ */
+void writeTarget(ostream & fileOut, char * label)
+{
+	int ILC = searchSymbolTable(label);
+	fixup entry;
+	if(ILC == -1 && onePassFlag)
+	{
+		entry.position = fileOut.tellp();
+		entry.label = label;
+		entry.line = rowBase+currentRow+1;
+		fixups.push_back(entry);
+		pendingLabels.insert(make_pair(entry.label,entry.line));	//Keeps line of first use
+		fileOut<<"0000000000000000";
+		return;
+	}
+	if(ILC == -1)
+	{
+		fprintf(stderr,"Error at line number: %d\n Label Not found\n",rowBase+currentRow+1);
+		exit(1);
+	}
+	if(ILC+baseAddress > 0xFFFF)
+	{
+		fprintf(stderr,"Error at line number: %d\n Label is beyond 16 bit address space\n",rowBase+currentRow+1);
+		exit(1);
+	}
+	fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
+}
+
+
+/**
+ *Function to patch jumps of "pendingOut" and write it, once every label used in it is defined
+ *@param 	ostream& fileOut				//Output File stream
+ *@return void
+ */
+void flushPending(ostream & fileOut)
+{
+	int i,j,address;
+	string text;
+	if(pendingOut.tellp() <= 0)
+		return;
+	text = pendingOut.str();
+	for(i=0;i<(int)fixups.size();i++)
+	{
+		address = symbolTable[symbolIndex[fixups[i].label]].ILC+baseAddress;
+		if(address > 0xFFFF)
+		{
+			fprintf(stderr,"Error at line number: %d\n Label is beyond 16 bit address space\n",fixups[i].line);
+			exit(1);
+		}
+		for(j=0;j<16;j++)
+			text[fixups[i].position+j] = '0'+(address>>(15-j) & 1);
+	}
+	fileOut<<text;
+	fixups.clear();
+	pendingOut.str("");
+}
+
+
+/**
+ *Function to Search symbol table for a label
+ *@param 	char* element				//Label to be searched for
+ *@return ILC of label, -1 if label not found
+ */
+int searchSymbolTable(char * element)
+{
+	unordered_map<string,int>::const_iterator found = symbolIndex.find(element);
+	symbolProbes++;
+	return found == symbolIndex.end() ? -1 : symbolTable[found->second].ILC;
+}
+
+
+/**
+ *Function to convert decimal number to Binary
+ *@param  int								//Decimal number
+ *@return unsigned long long 				//Binary equivalent of the given data
+ */
+unsigned long long int decToBinary(int num)
+{
+	unsigned long long bin=0,t=1,bit;
+	while(num)
+	{
+		bit = num % 2;
+		num = num / 2;
+		bin += bit*t;
+		t *= 10;
+	}
+	return bin;
+}
+
+/**
+ *Function to convert 4 digit hexadecimal address into a number
+ *@param  	char* text 						//Address, "H" at its end is optional
+ *@return Address
+ */
+int hexToAddress(char * text)
+{
+	int i,address=0;
+	if(strlen(text) == 5 && toupper(text[4]) == 'H')
+		text[4] = '\0';
+	if(strlen(text) != 4)
+		operandError("Invalid 16 bit address");
+	for(i=0;i<4;i++)
+	{
+		if(!isxdigit(text[i]))
+			operandError("Invalid operands");
+		address = 16*address + (isdigit(text[i]) ? text[i]-'0' : toupper(text[i])-'A'+10);
+	}
+	return address;
+}
+
+
+/**
+ *Function to load the encoded program into "optProgram" for optimization
+ *Jump targets and labels are converted from ILC into index of instruction
+ *@param 	istream& encodedIn				//Encoded output of second pass
+ *@return void
+ */
+void loadProgram(istream & encodedIn)
+{
+	static unsigned int words[MAX_IMAGE_WORDS];
+	int numberOfWords,i,j,ILC=0;
+
+	numberOfWords = readImage(encodedIn,words,MAX_IMAGE_WORDS);
+	if(numberOfWords < 0)
+	{
+		fprintf(stderr,"cass: Optimizer could not read encoded program\n");
+		exit(1);
+	}
+	optCount=0;
+	for(i=0;i<numberOfWords;i++)
+	{
+		if(decodeWord(words[i],&optProgram[optCount].code) == OP_INVALID)
+		{
+			fprintf(stderr,"cass: Optimizer found invalid instruction at ILC %d\n",ILC);
+			exit(1);
+		}
+		if(instructionSize(optProgram[optCount].code.op) == 8)		//Data of MOI, port of OUT and INP
+			optProgram[optCount].code.data = (int)words[++i];
+		optProgram[optCount].ILC = ILC;
+		optProgram[optCount].row = sourceRow[ILC/4];
+		optProgram[optCount].isDeleted = false;
+		ILC += instructionSize(optProgram[optCount].code.op);
+		optCount++;
+	}
+	optProgram[optCount].ILC = ILC;					//Labels at the end of program point here
+
+	for(i=0;i<optCount;i++)
+	{
+		optProgram[i].target = -1;
+		if(!isJump(optProgram[i].code.op))
+			continue;
+		for(j=0;j<=optCount && optProgram[j].ILC != optProgram[i].code.addr-baseAddress;j++)
+			;
+		if(j > optCount)
+		{
+			fprintf(stderr,"cass: Optimizer found jump into middle of instruction at ILC %d\n",optProgram[i].ILC);
+			exit(1);
+		}
+		optProgram[i].target = j;
+	}
+	for(i=0;i<symbTableCount;i++)
+	{
+		for(j=0;j<optCount && optProgram[j].ILC != symbolTable[i].ILC;j++)
+			;
+		labelIndex[i] = j;
+	}
+}
+
+
+/**
+ *Function to find the first instruction not removed by optimizer
+ *@param 	int index 						//Index to start searching from
+ *@return Index of instruction, optCount if there is none
+ */
+int nextLive(int index)
+{
+	while(index < optCount && optProgram[index].isDeleted)
+		index++;
+	return index;
+}
+
+
+/**
+ *Function to drop removed instructions from "optProgram"
+ *Jumps and labels pointing to a removed instruction will point to the one following it
+ *ILC of all instructions and labels is recomputed
+ *@return void
+ */
+void compactProgram(void)
+{
+	static int newIndex[INPUT_HEIGHT+1];
+	int i,count=0,ILC=0;
+
+	for(i=0;i<optCount;i++)
+	{
+		newIndex[i] = count;
+		if(!optProgram[i].isDeleted)
+			count++;
+	}
+	newIndex[optCount] = count;
+	for(i=0;i<optCount;i++)
+	{
+		if(optProgram[i].isDeleted)
+			continue;
+		if(optProgram[i].target != -1)
+			optProgram[i].target = newIndex[optProgram[i].target];
+		optProgram[newIndex[i]] = optProgram[i];
+		optProgram[newIndex[i]].ILC = ILC;
+		ILC += instructionSize(optProgram[i].code.op);
+	}
+	optCount = count;
+	optProgram[optCount].ILC = ILC;
+	for(i=0;i<symbTableCount;i++)
+	{
+		labelIndex[i] = newIndex[labelIndex[i]];
+		symbolTable[i].ILC = optProgram[labelIndex[i]].ILC;
+	}
+}
+
+
+/**
+ *Function to check if flags set before an instruction can be read later
+ *Any control transfer is assumed to read flags
+ *@param 	int index 						//Index of instruction in "optProgram"
+ *@return true if flags may be read before being overwritten
+ */
+bool flagsLiveAfter(int index)
+{
+	int i;
+	for(i=nextLive(index+1);i<optCount;i=nextLive(i+1))
+	{
+		switch(optProgram[i].code.op)
+		{
+			case OP_ADD : case OP_SUB : case OP_MUL : case OP_DIV : case OP_MOD :
+			case OP_NOT : case OP_INC : case OP_DEC : case OP_HLT :
+				return false;
+			case OP_JZR : case OP_JUM : case OP_JMC : case OP_JMZ : case OP_JMP :
+			case OP_LOP : case OP_ELP :
+				return true;
+		}
+	}
+	return false;
+}
+
+
+/**
+ *Function to run peephole optimizer on "optProgram"
+ *Looks at a window of two instructions and removes NOP, MVR X,X, INC X followed by DEC X,
+ *LDR following STR of same address and jumps to the next instruction
+ *Runs till no more instructions can be removed
+ *@return void
+ */
+void peephole(void)
+{
+	static bool isTarget[INPUT_HEIGHT+1];
+	int i,j,removedCount=0,removedBytes=0,mergedCount=0,oldILC;
+	bool isChanged=true;
+	instruction *first,*second;
+
+	oldILC = optProgram[optCount].ILC;
+	while(isChanged)
+	{
+		isChanged = false;
+		memset(isTarget,0,sizeof(bool)*(optCount+1));
+		for(i=0;i<optCount;i++)
+			if(!optProgram[i].isDeleted && optProgram[i].target != -1)
+				isTarget[nextLive(optProgram[i].target)] = true;
+		for(i=0;i<symbTableCount;i++)
+			isTarget[nextLive(labelIndex[i])] = true;
+
+		for(i=nextLive(0);i<optCount;i=nextLive(i+1))
+		{
+			first = &optProgram[i].code;
+			j = nextLive(i+1);
+			second = j < optCount ? &optProgram[j].code : NULL;
+
+			if(first->op == OP_NOP || (first->op == OP_MVR && first->reg1 == first->reg2))
+			{
+				if(verbosFlag)
+					printf("Peephole: removed %s at ILC %d\n",mneumonicName[first->op],optProgram[i].ILC);
+				optProgram[i].isDeleted = true;
+				removedCount++;
+				isChanged = true;
+			}
+			else if(isJump(first->op) && nextLive(optProgram[i].target) == j)
+			{
+				if(verbosFlag)
+					printf("Peephole: removed %s to next instruction at ILC %d\n",mneumonicName[first->op],optProgram[i].ILC);
+				optProgram[i].isDeleted = true;
+				removedCount++;
+				isChanged = true;
+			}
+			else if(second == NULL || isTarget[j])
+				continue;
+			else if(((first->op == OP_INC && second->op == OP_DEC) || (first->op == OP_DEC && second->op == OP_INC))
+					&& first->reg1 == second->reg1 && !flagsLiveAfter(j))
+			{
+				if(verbosFlag)
+					printf("Peephole: removed %s/%s pair at ILC %d\n",mneumonicName[first->op],mneumonicName[second->op],optProgram[i].ILC);
+				optProgram[i].isDeleted = optProgram[j].isDeleted = true;
+				removedCount += 2;
+				isChanged = true;
+			}
+			else if(first->op == OP_STR && second->op == OP_LDR && first->addr == second->addr)
+			{
+				if(first->reg1 == second->reg1)
+				{
+					if(verbosFlag)
+						printf("Peephole: removed LDR of stored value at ILC %d\n",optProgram[j].ILC);
+					optProgram[j].isDeleted = true;
+					removedCount++;
+					isChanged = true;
+				}
+				else if(first->reg1 != REG_ME && second->reg1 != REG_ME)		//MVR treats ME as indirect
+				{
+					if(verbosFlag)
+						printf("Peephole: merged LDR of stored value into MVR at ILC %d\n",optProgram[j].ILC);
+					second->op = OP_MVR;
+					second->reg2 = first->reg1;
+					second->addr = -1;
+					mergedCount++;
+				}
+			}
+		}
+		compactProgram();
+	}
+	removedBytes = oldILC - optProgram[optCount].ILC;
+	printf("Peephole optimizer removed %d instructions (%d bytes), merged %d\n",removedCount,removedBytes,mergedCount);
+}
+
+
+/**
+ *Function to write the optimized program in the output file
+ *@param 	ostream& fileOut				//Output File stream
+ *@return void
+ */
+void writeProgram(ostream & fileOut)
+{
+	int i;
+	for(i=0;i<optCount;i++)
+	{
+		if(optProgram[i].target != -1)
+			optProgram[i].code.addr = optProgram[optProgram[i].target].ILC + baseAddress;
+		writeWord(fileOut,encodeWord(&optProgram[i].code));
+		if(instructionSize(optProgram[i].code.op) == 8)
+			writeWord(fileOut,optProgram[i].code.data);
+	}
+}
+
+
+/**
+ *Function to match every LOP in "optProgram" with its ELP
+ *@return false if loops are not properly nested
+ */
+bool matchLoops(void)
+{
+	static int stack[INPUT_HEIGHT];
+	int i,top=0;
+	for(i=0;i<optCount;i++)
+	{
+		loopMate[i] = -1;
+		if(optProgram[i].isDeleted)
+			continue;
+		if(optProgram[i].code.op == OP_LOP)
+			stack[top++] = i;
+		else if(optProgram[i].code.op == OP_ELP)
+		{
+			if(top == 0)
+				return false;
+			loopMate[i] = stack[--top];
+			loopMate[loopMate[i]] = i;
+		}
+	}
+	return top == 0;
+}
+
+
+/**
+ *Function to find instructions which may execute after an instruction
+ *An index equal to optCount means program falls off its end
+ *@param 	int index 						//Index of instruction in "optProgram"
+ *@param 	int* succ 						//Array of atleast 2 elements to store successors
+ *@return Number of successors
+ */
+int successors(int index, int * succ)
+{
+	int next = nextLive(index+1);
+	switch(optProgram[index].code.op)
+	{
+		case OP_HLT : return 0;
+		case OP_JUM : succ[0] = optProgram[index].target;
+					return 1;
+		case OP_JZR : case OP_JMC : case OP_JMZ : case OP_JMP :
+					succ[0] = next;
+					succ[1] = optProgram[index].target;
+					return 2;
+		case OP_LOP : succ[0] = next;						//Loop count zero skips the body
+					succ[1] = nextLive(loopMate[index]+1);
+					return 2;
+		case OP_ELP : succ[0] = next;
+					succ[1] = nextLive(loopMate[index]+1);
+					return 2;
+	}
+	succ[0] = next;
+	return 1;
+}
+
+
+/**
+ *Function to find registers read by an instruction
+ *Flag register is bit FLAG_SLOT
+ *@param 	instruction* ins 				//Decoded instruction
+ *@return Mask of registers
+ */
+unsigned int useMask(instruction * ins)
+{
+	switch(ins->op)
+	{
+		case OP_STR : case OP_JZR : case OP_NOT : case OP_INC : case OP_DEC : case OP_LOP : case OP_OUT :
+			return 1u<<ins->reg1;
+		case OP_JMC : case OP_JMZ : case OP_JMP :
+			return FLAG_MASK;
+		case OP_MVR :
+			return (1u<<ins->reg2) | (ins->reg1 == REG_ME ? 1u<<REG_ME : 0);
+		case OP_ADD : case OP_SUB : case OP_MUL : case OP_DIV : case OP_MOD : case OP_STI :
+			return (1u<<ins->reg1) | (1u<<ins->reg2);
+	}
+	return 0;
+}
+
+
+/**
+ *Function to find registers written by an instruction
+ *Flag register is bit FLAG_SLOT
+ *@param 	instruction* ins 				//Decoded instruction
+ *@return Mask of registers
+ */
+unsigned int defMask(instruction * ins)
+{
+	switch(ins->op)
+	{
+		case OP_LDR : case OP_MAI : case OP_MOI : case OP_INP :
+			return 1u<<ins->reg1;
+		case OP_MVR :
+			return ins->reg1 == REG_ME ? 0 : 1u<<ins->reg1;		//MVR ME,X writes to memory
+	}
+	if(isAlu(ins->op))
+		return (1u<<ins->reg1) | FLAG_MASK;
+	return 0;
+}
+
+
+/**
+ *Function to check if an instruction does something other than writing registers
+ *@param 	int index 						//Index of instruction in "optProgram"
+ *@return true if instruction writes memory, transfers control or may trap
+ */
+bool hasSideEffect(int index)
+{
+	instruction *ins = &optProgram[index].code;
+	lattice *divisor;
+	switch(ins->op)
+	{
+		case OP_STR : case OP_STI : case OP_JZR : case OP_JUM : case OP_JMC : case OP_JMZ : case OP_JMP :
+		case OP_LOP : case OP_ELP : case OP_HLT : case OP_OUT : case OP_INP :
+			return true;
+		case OP_MVR :
+			return ins->reg1 == REG_ME;
+		case OP_DIV : case OP_MOD :
+			divisor = &stateIn[index][ins->reg2];
+			return !isReached[index] || divisor->kind != VAL_CONST || divisor->value == 0 || divisor->value == 0xFFFFFFFFu;
+	}
+	return false;
+}
+
+
+/**
+ *Function to apply effect of an instruction on known values of registers
+ *@param 	int index 						//Index of instruction in "optProgram"
+ *@param 	lattice* state 					//Registers and flags, updated in place
+ *@return void
+ */
+void transferState(int index, lattice * state)
+{
+	instruction *ins = &optProgram[index].code;
+	unsigned int result;
+	lattice *first,*second;
+
+	switch(ins->op)
+	{
+		case OP_LDR : case OP_INP : state[ins->reg1].kind = VAL_VARYING;
+					return;
+		case OP_MAI : state[ins->reg1].kind = VAL_CONST;
+					state[ins->reg1].value = ins->addr;
+					return;
+		case OP_MOI : state[ins->reg1].kind = VAL_CONST;
+					state[ins->reg1].value = ins->data;
+					return;
+		case OP_MVR : if(ins->reg1 == REG_ME)
+						return;
+					if(ins->reg2 == REG_ME)					//Reads memory pointed by ME
+						state[ins->reg1].kind = VAL_VARYING;
+					else
+						state[ins->reg1] = state[ins->reg2];
+					return;
+	}
+	if(!isAlu(ins->op))
+		return;
+	first = &state[ins->reg1];
+	second = ins->reg2 == -1 ? NULL : &state[ins->reg2];
+	if(first->kind == VAL_CONST && (second == NULL || second->kind == VAL_CONST)
+		&& evaluateAlu(ins->op,first->value,second ? second->value : 0,&result))
+	{
+		state[FLAG_SLOT].kind = VAL_CONST;
+		state[FLAG_SLOT].value = aluFlags(ins->op,first->value,second ? second->value : 1,result);
+		first->value = result;
+	}
+	else
+	{
+		first->kind = VAL_VARYING;
+		state[FLAG_SLOT].kind = VAL_VARYING;
+	}
+}
+
+
+/**
+ *Function to find constant registers and reachable instructions of "optProgram"
+ *Fills "stateIn" and "isReached"
+ *@return void
+ */
+void propagateConstants(void)
+{
+	static int worklist[INPUT_HEIGHT+1];
+	static bool isQueued[INPUT_HEIGHT+1];
+	lattice state[NUMBER_OF_REG+1];
+	int i,j,top=0,index,count,succ[2],flag;
+	instruction *ins;
+
+	for(i=0;i<=optCount;i++)
+	{
+		isReached[i] = isQueued[i] = false;
+		for(j=0;j<=NUMBER_OF_REG;j++)
+			stateIn[i][j].kind = VAL_UNDEF;
+	}
+	index = nextLive(0);
+	for(j=0;j<=NUMBER_OF_REG;j++)
+		stateIn[index][j].kind = VAL_VARYING;			//Nothing is known at start of program
+	isReached[index] = isQueued[index] = true;
+	worklist[top++] = index;
+
+	while(top)
+	{
+		index = worklist[--top];
+		isQueued[index] = false;
+		if(index == optCount)
+			continue;
+		ins = &optProgram[index].code;
+		memcpy(state,stateIn[index],sizeof(state));
+		transferState(index,state);
+		count = successors(index,succ);
+
+		//Remove edges which can never be taken
+		flag = ins->op == OP_JMC ? FLAG_C : ins->op == OP_JMZ ? FLAG_Z : FLAG_P;
+		if(ins->op == OP_JZR && state[ins->reg1].kind == VAL_CONST)
+			succ[0] = succ[state[ins->reg1].value == 0 ? 1 : 0], count = 1;
+		else if((ins->op == OP_JMC || ins->op == OP_JMZ || ins->op == OP_JMP) && state[FLAG_SLOT].kind == VAL_CONST)
+			succ[0] = succ[(state[FLAG_SLOT].value & flag) ? 1 : 0], count = 1;
+		else if(ins->op == OP_LOP && state[ins->reg1].kind == VAL_CONST)
+			succ[0] = succ[state[ins->reg1].value == 0 ? 1 : 0], count = 1;
+
+		for(i=0;i<count;i++)
+		{
+			bool isChanged = !isReached[succ[i]];
+			isReached[succ[i]] = true;
+			for(j=0;j<=NUMBER_OF_REG;j++)
+			{
+				lattice *old = &stateIn[succ[i]][j];
+				if(old->kind == VAL_UNDEF || (state[j].kind == VAL_VARYING && old->kind != VAL_VARYING))
+					*old = state[j];
+				else if(old->kind == VAL_CONST && state[j].kind == VAL_CONST && old->value != state[j].value)
+					old->kind = VAL_VARYING;
+				else
+					continue;
+				isChanged = true;
+			}
+			if(isChanged && !isQueued[succ[i]])
+			{
+				isQueued[succ[i]] = true;
+				worklist[top++] = succ[i];
+			}
+		}
+	}
+}
+
+
+/**
+ *Function to find registers and flags which are read later, for every instruction
+ *Nothing is live after HLT or at the end of program
+ *Fills "liveOut"
+ *@return void
+ */
+void computeLiveness(void)
+{
+	int i,j,count,succ[2];
+	unsigned int live;
+	bool isChanged=true;
+
+	for(i=0;i<=optCount;i++)
+		liveOut[i] = 0;
+	while(isChanged)
+	{
+		isChanged = false;
+		for(i=optCount-1;i>=0;i--)
+		{
+			if(optProgram[i].isDeleted)
+				continue;
+			live = 0;
+			count = successors(i,succ);
+			for(j=0;j<count;j++)
+				if(succ[j] < optCount)
+					live |= useMask(&optProgram[succ[j]].code) | (liveOut[succ[j]] & ~defMask(&optProgram[succ[j]].code));
+			if(live != liveOut[i])
+			{
+				liveOut[i] = live;
+				isChanged = true;
+			}
+		}
+	}
+}
+
+
+/**
+ *Function to replace an instruction whose result is known by a cheaper one
+ *@param 	int index 						//Index of instruction in "optProgram"
+ *@return true if instruction was changed or removed
+ */
+bool foldInstruction(int index)
+{
+	instruction *ins = &optProgram[index].code;
+	lattice state[NUMBER_OF_REG+1];
+	unsigned int value;
+	int i;
+	bool isTaken;
+
+	memcpy(state,stateIn[index],sizeof(state));
+	switch(ins->op)
+	{
+		case OP_JZR : case OP_JMC : case OP_JMZ : case OP_JMP :
+			if(ins->op == OP_JZR && state[ins->reg1].kind == VAL_CONST)
+				isTaken = state[ins->reg1].value == 0;
+			else if(ins->op != OP_JZR && state[FLAG_SLOT].kind == VAL_CONST)
+				isTaken = state[FLAG_SLOT].value & (ins->op == OP_JMC ? FLAG_C : ins->op == OP_JMZ ? FLAG_Z : FLAG_P);
+			else
+				return false;
+			if(isTaken)
+			{
+				ins->op = OP_JUM;							//Jump is always taken
+				ins->reg1 = -1;
+			}
+			else
+				optProgram[index].isDeleted = true;			//Jump is never taken
+			return true;
+		case OP_MAI : case OP_MOI :
+			value = ins->op == OP_MAI ? (unsigned int)ins->addr : (unsigned int)ins->data;
+			break;
+		case OP_MVR :
+			if(ins->reg1 == REG_ME || ins->reg2 == REG_ME || state[ins->reg2].kind != VAL_CONST)
+				return false;
+			value = state[ins->reg2].value;
+			break;
+		default :
+			if(!isAlu(ins->op) || (liveOut[index] & FLAG_MASK))
+				return false;
+			transferState(index,state);
+			if(state[ins->reg1].kind != VAL_CONST)
+				return false;
+			value = state[ins->reg1].value;
+			memcpy(state,stateIn[index],sizeof(state));
+	}
+
+	if(state[ins->reg1].kind == VAL_CONST && state[ins->reg1].value == value)
+	{
+		optProgram[index].isDeleted = true;					//Register already holds the value
+		return true;
+	}
+	for(i=0;i<REG_ME;i++)
+	{
+		if(i != ins->reg1 && state[i].kind == VAL_CONST && state[i].value == value
+			&& ((liveOut[index] | useMask(ins)) & (1u<<i)))			//Definition of register will not be removed
+		{
+			if(ins->op == OP_MVR && ins->reg2 == i)
+				return false;
+			ins->op = OP_MVR;								//Copy from register holding the value
+			ins->reg2 = i;
+			ins->addr = -1;
+			return true;
+		}
+	}
+	if(ins->op == OP_MAI || ins->op == OP_MOI || ins->op == OP_MVR)
+		return false;
+	if(state[ins->reg1].kind == VAL_CONST && (value == state[ins->reg1].value+1 || value == state[ins->reg1].value-1))
+	{
+		i = value == state[ins->reg1].value+1 ? OP_INC : OP_DEC;
+		if(ins->op == i)
+			return false;
+		ins->op = i;
+		ins->reg2 = -1;
+		return true;
+	}
+	ins->op = OP_MOI;
+	ins->reg2 = -1;
+	ins->data = value;
+	return true;
+}
+
+
+/**
+ *Function to run constant propagation, liveness analysis and dead code elimination on "optProgram"
+ *Computations on known values are folded, writes to registers never read and
+ *instructions which can never execute are removed
+ *Program is left unchanged if it would become larger
+ *@return void
+ */
+void dataflowOptimize(void)
+{
+	static optInstruction savedProgram[INPUT_HEIGHT+1];
+	static int savedLabelIndex[SYMB_TAB_SIZE];
+	int i,savedCount,foldedCount=0,removedCount=0,oldILC,round;
+	bool isChanged=true;
+
+	if(!matchLoops())
+	{
+		printf("Dataflow optimizer skipped: LOP and ELP are not properly nested\n");
+		return;
+	}
+	savedCount = optCount;
+	oldILC = optProgram[optCount].ILC;
+	memcpy(savedProgram,optProgram,sizeof(optInstruction)*(optCount+1));
+	memcpy(savedLabelIndex,labelIndex,sizeof(labelIndex));
+
+	for(round=0;isChanged && round<INPUT_HEIGHT;round++)
+	{
+		isChanged = false;
+		matchLoops();
+		propagateConstants();
+		computeLiveness();
+		for(i=0;i<optCount;i++)
+		{
+			if(!isReached[i])
+			{
+				if(optProgram[i].code.op == OP_LOP || optProgram[i].code.op == OP_ELP)
+					if(isReached[loopMate[i]])
+						continue;
+				if(verbosFlag)
+					printf("Dataflow: removed unreachable %s at ILC %d\n",mneumonicName[optProgram[i].code.op],optProgram[i].ILC);
+				optProgram[i].isDeleted = true;
+				removedCount++;
+			}
+			else if(optProgram[i].code.op == OP_LOP && !isReached[loopMate[i]]
+					&& stateIn[i][optProgram[i].code.reg1].kind == VAL_CONST && stateIn[i][optProgram[i].code.reg1].value == 0)
+			{
+				if(verbosFlag)
+					printf("Dataflow: removed loop running zero times at ILC %d\n",optProgram[i].ILC);
+				optProgram[i].isDeleted = optProgram[loopMate[i]].isDeleted = true;
+				removedCount += 2;
+			}
+			else if(foldInstruction(i))
+			{
+				if(verbosFlag)
+					printf("Dataflow: folded %s at ILC %d\n",optProgram[i].isDeleted ? "redundant instruction" : mneumonicName[optProgram[i].code.op],optProgram[i].ILC);
+				foldedCount++;
+			}
+			else
+				continue;
+			isChanged = true;
+		}
+
+		if(!isChanged)				//Dead code is removed only when liveness is valid for whole program
+		{
+			for(i=0;i<optCount;i++)
+			{
+				if(!hasSideEffect(i) && !(defMask(&optProgram[i].code) & liveOut[i]))
+				{
+					if(verbosFlag)
+						printf("Dataflow: removed dead %s at ILC %d\n",mneumonicName[optProgram[i].code.op],optProgram[i].ILC);
+					optProgram[i].isDeleted = true;
+					removedCount++;
+					isChanged = true;
+				}
+			}
+		}
+		compactProgram();
+	}
+
+	if(optProgram[optCount].ILC > oldILC)
+	{
+		optCount = savedCount;
+		memcpy(optProgram,savedProgram,sizeof(optInstruction)*(optCount+1));
+		memcpy(labelIndex,savedLabelIndex,sizeof(labelIndex));
+		for(i=0;i<symbTableCount;i++)
+			symbolTable[i].ILC = optProgram[labelIndex[i]].ILC;
+		printf("Dataflow optimizer made no change: result would be larger\n");
+		return;
+	}
+	printf("Dataflow optimizer folded %d and removed %d instructions (%d bytes)\n",foldedCount,removedCount,oldILC-optProgram[optCount].ILC);
+}
+
+
+/**
+ *Function to find a register which can hold the new count of an unrolled loop
+ *Counter of loop is reused if it is not read after LOP
+ *@param 	int index 						//Index of LOP in "optProgram"
+ *@return Register, -1 if every register is live
+ */
+int findCounterRegister(int index)
+{
+	int i;
+	if(!(liveOut[index] & (1u<<optProgram[index].code.reg1)))
+		return optProgram[index].code.reg1;
+	for(i=0;i<REG_ME;i++)
+		if(!(liveOut[index] & (1u<<i)))
+			return i;
+	return -1;
+}
+
+
+/**
+ *Function to unroll LOP/ELP loops whose trip count is known
+ *Only innermost loops without labels or jumps in their body are unrolled
+ *Loop is unrolled fully if allowed by "unrollFactor" and "unrollBudget", otherwise body is
+ *repeated "unrollFactor" times (or largest of 8, 4, 2 within budget) and the remaining
+ *iterations are placed before the loop
+ *@return true if any loop was unrolled
+ */
+bool unrollLoops(void)
+{
+	static optInstruction newProgram[INPUT_HEIGHT+1];
+	static int newIndex[INPUT_HEIGHT+1];
+	static bool isTarget[INPUT_HEIGHT+1];
+	const int autoFactor[] = {8, 4, 2};
+	int i,j,k,newCount=0,bodySize,bodyCount,elp,factor,counterReg,copies,grown=0,unrolledCount=0,fullCount=0;
+	unsigned int tripCount;
+	bool isSimple;
+
+	if(!matchLoops())
+	{
+		printf("Loop unroller skipped: LOP and ELP are not properly nested\n");
+		return false;
+	}
+	propagateConstants();
+	computeLiveness();
+	memset(isTarget,0,sizeof(bool)*(optCount+1));
+	for(i=0;i<optCount;i++)
+		if(optProgram[i].target != -1)
+			isTarget[optProgram[i].target] = true;
+	for(i=0;i<symbTableCount;i++)
+		isTarget[labelIndex[i]] = true;
+
+	for(i=0;i<optCount;i++)
+	{
+		newIndex[i] = newCount;
+		if(optProgram[i].code.op != OP_LOP || !isReached[i] || stateIn[i][optProgram[i].code.reg1].kind != VAL_CONST)
+		{
+			newProgram[newCount++] = optProgram[i];
+			continue;
+		}
+		tripCount = stateIn[i][optProgram[i].code.reg1].value;
+		elp = loopMate[i];
+		bodySize = bodyCount = 0;
+		isSimple = true;
+		for(j=i+1;j<elp;j++)
+		{
+			k = optProgram[j].code.op;
+			if(isTarget[j] || isJump(k) || k == OP_LOP || k == OP_HLT)
+				isSimple = false;
+			bodySize += instructionSize(k);
+			bodyCount++;
+		}
+		if(isTarget[elp])
+			isSimple = false;
+
+		//Choose number of copies of body which fit in the budget
+		factor = 0;
+		counterReg = -1;
+		if(isSimple && tripCount >= 1 && (unrollFactor == 0 || tripCount <= (unsigned int)unrollFactor)
+			&& (unsigned long long)(tripCount-1)*bodySize <= (unsigned long long)(unrollBudget-grown+8)
+			&& newCount+(unsigned long long)tripCount*bodyCount < (unsigned long long)(INPUT_HEIGHT-(optCount-i)))
+			factor = tripCount;
+		else if(isSimple && tripCount >= 4 && (counterReg = findCounterRegister(i)) != -1)
+		{
+			for(j=0;j<3 && !factor;j++)
+			{
+				k = unrollFactor ? unrollFactor : autoFactor[j];
+				copies = k-1 + tripCount%k;
+				if(k >= 2 && (unsigned int)k < tripCount && copies*bodySize+8 <= unrollBudget-grown
+					&& newCount+(copies+1)*bodyCount+3 < INPUT_HEIGHT-(optCount-i))
+					factor = k;
+				if(unrollFactor)
+					break;
 			}
 		}
-		label[i] = '\0';
-		fileOut<<opcode;
-		ILC = searchSymbolTable(label);
-		if(ILC == -1)
+		if(!factor)
 		{
-			fprintf(stderr,"Error at line number: %d\n Label Not found\n",currentRow+1);
-			exit(1);
+			newProgram[newCount++] = optProgram[i];
+			continue;
+		}
+
+		if((unsigned int)factor == tripCount)			//Full unroll, LOP and ELP are dropped
+		{
+			for(k=0;k<factor;k++)
+				for(j=i+1;j<elp;j++)
+					newProgram[newCount++] = optProgram[j];
+			grown += (factor-1)*bodySize-8;
+			fullCount++;
+			if(verbosFlag)
+				printf("Unroll: loop at ILC %d fully unrolled %u times\n",optProgram[i].ILC,tripCount);
 		}
-		fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
-		fileOut<<endl;
+		else
+		{
+			for(k=0;k<(int)(tripCount%factor);k++)		//Remaining iterations before the loop
+				for(j=i+1;j<elp;j++)
+					newProgram[newCount++] = optProgram[j];
+			newProgram[newCount] = optProgram[i];
+			newProgram[newCount].code.op = OP_MOI;
+			newProgram[newCount].code.reg1 = counterReg;
+			newProgram[newCount++].code.data = tripCount/factor;
+			newProgram[newCount] = optProgram[i];
+			newProgram[newCount++].code.reg1 = counterReg;
+			for(k=0;k<factor;k++)
+				for(j=i+1;j<elp;j++)
+					newProgram[newCount++] = optProgram[j];
+			newProgram[newCount++] = optProgram[elp];
+			grown += (factor-1+tripCount%factor)*bodySize+8;
+			if(verbosFlag)
+				printf("Unroll: loop at ILC %d unrolled %d times, %u iterations left\n",optProgram[i].ILC,factor,tripCount/factor);
+		}
+		unrolledCount++;
+		for(j=i+1;j<=elp;j++)
+			newIndex[j] = newCount;				//Nothing jumps into the body
+		i = elp;
+	}
+	newIndex[optCount] = newCount;
+
+	if(!unrolledCount)
+	{
+		printf("Loop unroller found no loop to unroll\n");
+		return false;
 	}
+	for(i=0;i<newCount;i++)
+		if(newProgram[i].target != -1)
+			newProgram[i].target = newIndex[newProgram[i].target];
+	for(i=0;i<symbTableCount;i++)
+		labelIndex[i] = newIndex[labelIndex[i]];
+	memcpy(optProgram,newProgram,sizeof(optInstruction)*newCount);
+	optCount = newCount;
+	compactProgram();
+	printf("Loop unroller unrolled %d loops (%d fully), program grew by %d bytes\n",unrolledCount,fullCount,grown);
+	return true;
 }
 
-void interpretJMC(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to fill default cost of one cycle for every operation
+ *@return void
+ */
+void setDefaultCosts(void)
 {
-	int i=0,ILC=0;
-	char label[LABEL_SIZE];
-	char opcode[] = "0000000010000001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	int i;
+	if(isCostSet)
+		return;
+	for(i=0;i<=OP_INVALID;i++)
+		cycleCost[i] = 1;
+	isCostSet = true;
+}
+
+
+/**
+ *Function to read cycles of each mneumonic from a cost table file
+ *Every line contains a mneumonic and its cycles, TAKEN gives extra cycles of a taken jump
+ *Content after ';' or '#' is treated as comment
+ *@param 	const char* fileName			//Name of cost table file
+ *@return void
+ */
+void readCostTable(const char * fileName)
+{
+	FILE *fileCost;
+	char line[INPUT_WIDTH],name[MNEUMONIC_SIZE+2];
+	unsigned long long cycles;
+	int i,lineNumber=0;
+
+	setDefaultCosts();
+	fileCost = fopen(fileName,"r");
+	if(!fileCost)
 	{
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		fprintf(stderr,"cass: Cost table \"%s\" not found !!\n",fileName);
+		exit(1);
+	}
+	while(fgets(line,sizeof(line),fileCost))
+	{
+		lineNumber++;
+		line[strcspn(line,";#\r\n")] = '\0';
+		if(sscanf(line,"%6s",name) != 1)
+			continue;
+		if(sscanf(line,"%*s %llu",&cycles) != 1)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			label[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
+			fprintf(stderr,"cass: Error at line number %d of cost table\nCycles missing\n",lineNumber);
+			exit(1);
+		}
+		for(i=0;name[i]!='\0';i++)
+			name[i] = toupper(name[i]);
+		if(!strcmp(name,"TAKEN"))
+		{
+			takenCost = cycles;
+			continue;
 		}
-		label[i] = '\0';
-		fileOut<<opcode;
-		ILC = searchSymbolTable(label);
-		if(ILC == -1)
+		for(i=0;i<OP_INVALID && strcmp(name,mneumonicName[i]);i++)
+			;
+		if(i == OP_INVALID)
 		{
-			fprintf(stderr,"Error at line number: %d\n Label Not found\n",currentRow+1);
+			fprintf(stderr,"cass: Error at line number %d of cost table\nInvalid mnemnonic!\n",lineNumber);
 			exit(1);
 		}
-		fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
-		fileOut<<endl;
+		cycleCost[i] = cycles;
 	}
+	fclose(fileCost);
 }
 
-void interpretJMZ(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to split "optProgram" into basic blocks and connect them
+ *A block ends at a jump, LOP, ELP or HLT and before a label or jump target
+ *@return void
+ */
+void buildCFG(void)
 {
-	int i=0,ILC=0;
-	char label[LABEL_SIZE];
-	char opcode[] = "0000000010000010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	static bool isLeader[INPUT_HEIGHT+1];
+	int i,j,count,succ[2];
+
+	memset(isLeader,0,sizeof(bool)*(optCount+1));
+	isLeader[0] = true;
+	for(i=0;i<optCount;i++)
 	{
-		eatWhiteSpace();
-		i=0;
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			label[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-		}
-		label[i] = '\0';
-		fileOut<<opcode;
-		ILC = searchSymbolTable(label);
-		if(ILC == -1)
+		if(optProgram[i].target != -1)
+			isLeader[optProgram[i].target] = true;
+		if(isJump(optProgram[i].code.op) || optProgram[i].code.op == OP_LOP || optProgram[i].code.op == OP_ELP
+			|| optProgram[i].code.op == OP_HLT)
+			isLeader[i+1] = true;
+		if(optProgram[i].code.op == OP_ELP)
+			isLeader[loopMate[i]+1] = true;
+	}
+	for(i=0;i<symbTableCount;i++)
+		isLeader[labelIndex[i]] = true;
+
+	blockCount = 0;
+	for(i=0;i<optCount;i++)
+	{
+		if(isLeader[i])
 		{
-			fprintf(stderr,"Error at line number: %d\n Label Not found\n",currentRow+1);
-			exit(1);
+			if(blockCount)
+				blocks[blockCount-1].end = i;
+			blocks[blockCount].first = i;
+			blocks[blockCount].cycles = 0;
+			blocks[blockCount].loop = -1;
+			blockCount++;
 		}
-		fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
-		fileOut<<endl;
+		blockOf[i] = blockCount-1;
+		blocks[blockCount-1].cycles += cycleCost[optProgram[i].code.op];
+	}
+	if(blockCount)
+		blocks[blockCount-1].end = optCount;
+	blockOf[optCount] = blockCount;
+
+	for(i=0;i<blockCount;i++)
+	{
+		j = blocks[i].end-1;
+		count = successors(j,succ);
+		blocks[i].succCount = count;
+		for(j=0;j<count;j++)
+			blocks[i].succ[j] = blockOf[succ[j]];
+		if(count == 2 || optProgram[blocks[i].end-1].code.op == OP_JUM)
+			blocks[i].cycles += takenCost;					//Assume jump is taken
 	}
 }
 
-void interpretJMP(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to find back edges of the control flow graph by depth first search
+ *Every back edge creates or extends the loop of its target block
+ *@param 	int block 						//Block being visited
+ *@return void
+ */
+void findBackEdges(int block)
 {
-	int i=0,ILC=0;
-	char label[LABEL_SIZE];
-	char opcode[] = "0000000010000011";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	int i,succ,lop;
+
+	visitState[block] = 1;
+	for(i=0;i<blocks[block].succCount;i++)
 	{
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		succ = blocks[block].succ[i];
+		if(succ == blockCount)
+			continue;
+		if(visitState[succ] == 0)
+			findBackEdges(succ);
+		else if(visitState[succ] == 1)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			label[i++] = sourceProgram[currentRow][currentIndex++];
-			if(sourceProgram[currentRow][currentIndex] == ' ')
+			if(blocks[succ].loop == -1)
 			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
+				if(loopCount == MAX_LOOPS)
 				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
+					fprintf(stderr,"cass: Too many loops for WCET analysis\n");
+					exit(1);
 				}
-				break;
+				blocks[succ].loop = loopCount;
+				loops[loopCount].header = succ;
+				loops[loopCount].isMember = (bool *)calloc(blockCount+1,sizeof(bool));
+				loops[loopCount].isHardware = false;
+				loops[loopCount].bound = defaultLoopBound ? (unsigned long long)defaultLoopBound : UNBOUNDED;
+				lop = blocks[succ].first-1;
+				if(lop >= 0 && optProgram[lop].code.op == OP_LOP && optProgram[blocks[block].end-1].code.op == OP_ELP
+					&& loopMate[lop] == blocks[block].end-1)
+				{
+					loops[loopCount].isHardware = true;
+					if(isReached[lop] && stateIn[lop][optProgram[lop].code.reg1].kind == VAL_CONST)
+						loops[loopCount].bound = stateIn[lop][optProgram[lop].code.reg1].value;
+				}
+				loopCount++;
 			}
+			loops[blocks[succ].loop].isMember[block] = true;		//Latch, body is filled later
 		}
-		label[i] = '\0';
-		fileOut<<opcode;
-		ILC = searchSymbolTable(label);
-		if(ILC == -1)
-		{
-			fprintf(stderr,"Error at line number: %d\n Label Not found\n",currentRow+1);
-			exit(1);
-		}
-		fileOut<<setw(16)<<setfill('0')<<decToBinary(ILC+baseAddress);
-		fileOut<<endl;
 	}
+	visitState[block] = 2;
+	postOrder[postCount++] = block;
 }
 
-void interpretMVR(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to find immediate dominator of every block reached from block 0
+ *Iterates over blocks in reverse post order till nothing changes (Cooper, Harvey and Kennedy)
+ *@param 	int* predStart 					//Start of predecessors of every block in "preds"
+ *@param 	int* preds 						//Predecessors of all blocks
+ *@return void
+ */
+void findDominators(int * predStart, int * preds)
 {
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000000000";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	static int order[INPUT_HEIGHT+1];
+	int i,k,b,p,dom;
+	bool isChanged=true;
+
+	for(b=0;b<blockCount;b++)
+		idom[b] = -1;
+	for(i=0;i<postCount;i++)
+		order[postOrder[i]] = i;
+	idom[0] = 0;
+	while(isChanged)
 	{
-		while(1)
+		isChanged = false;
+		for(i=postCount-1;i>=0;i--)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
+			b = postOrder[i];
+			if(b == 0)
+				continue;
+			dom = -1;
+			for(k=predStart[b];k<predStart[b+1];k++)
 			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
+				p = preds[k];
+				if(idom[p] == -1)
+					continue;
+				if(dom == -1)
 				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
+					dom = p;
+					continue;
+				}
+				while(p != dom)
+				{
+					while(order[p] < order[dom])
+						p = idom[p];
+					while(order[dom] < order[p])
+						dom = idom[dom];
 				}
-				break;
 			}
-			if(i>2)					//Implement exception handling
+			if(idom[b] != dom)
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
+				idom[b] = dom;
+				isChanged = true;
 			}
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
 	}
 }
 
-void interpretADD(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to check if every path from block 0 to a block passes through another
+ *@param 	int header 						//Block which may dominate
+ *@param 	int block 						//Block
+ *@return true if header dominates block
+ */
+bool dominates(int header, int block)
 {
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000000001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	while(block != header)
 	{
-		while(1)
-		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
-		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		if(block == 0 || idom[block] == -1)
+			return false;
+		block = idom[block];
+	}
+	return true;
+}
+
+
+/**
+ *Function to fill blocks of every loop and nest the loops
+ *Body of a loop is every block dominated by the header which reaches a latch without passing
+ *through the header, so a jump into the middle of a loop does not pull the code before it in
+ *@return void
+ */
+void findLoops(void)
+{
+	static int predStart[INPUT_HEIGHT+2],predFill[INPUT_HEIGHT+2],preds[2*INPUT_HEIGHT+2],worklist[INPUT_HEIGHT+1];
+	static int size[MAX_LOOPS];
+	int i,j,k,b,top;
+
+	memset(predStart,0,sizeof(int)*(blockCount+2));
+	for(i=0;i<blockCount;i++)
+		for(j=0;j<blocks[i].succCount;j++)
+			predStart[blocks[i].succ[j]+1]++;
+	for(i=0;i<=blockCount;i++)
+		predStart[i+1] += predStart[i];
+	memcpy(predFill,predStart,sizeof(int)*(blockCount+2));		//Next free slot of every block
+	for(i=0;i<blockCount;i++)
+		for(j=0;j<blocks[i].succCount;j++)
+			preds[predFill[blocks[i].succ[j]]++] = i;
+	findDominators(predStart,preds);
+
+	for(i=0;i<loopCount;i++)
+	{
+		top = 0;
+		for(b=0;b<blockCount;b++)
+			if(loops[i].isMember[b] && b != loops[i].header)
+				worklist[top++] = b;
+		loops[i].isMember[loops[i].header] = true;
+		while(top)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
+			b = worklist[--top];
+			for(k=predStart[b];k<predStart[b+1];k++)
+				if(!loops[i].isMember[preds[k]] && dominates(loops[i].header,preds[k]))
 				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
+					loops[i].isMember[preds[k]] = true;
+					worklist[top++] = preds[k];
 				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
+		size[i] = 0;
+		for(b=0;b<blockCount;b++)
+			size[i] += loops[i].isMember[b];
+	}
+
+	//Innermost loop of a block or loop is the smallest loop containing it
+	for(b=0;b<blockCount;b++)
+	{
+		blocks[b].loop = -1;
+		for(i=0;i<loopCount;i++)
+			if(loops[i].isMember[b] && (blocks[b].loop == -1 || size[i] < size[blocks[b].loop]))
+				blocks[b].loop = i;
+	}
+	for(i=0;i<loopCount;i++)
+	{
+		loops[i].parent = -1;
+		for(j=0;j<loopCount;j++)
+			if(j != i && loops[j].isMember[loops[i].header] && size[j] > size[i]
+				&& (loops[i].parent == -1 || size[j] < size[loops[i].parent]))
+				loops[i].parent = j;
 	}
 }
 
-void interpretSUB(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to add cycle counts, result is UNBOUNDED if any of them is
+ *@return Sum of cycles
+ */
+unsigned long long addCycles(unsigned long long a, unsigned long long b)
 {
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000000010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	if(a == UNBOUNDED || b == UNBOUNDED || a+b < a)
+		return UNBOUNDED;
+	return a+b;
+}
+
+
+/**
+ *Function to find the node representing a block when looking from inside a loop
+ *Node of a block is the block itself, blocks of inner loops are represented by the
+ *outermost inner loop which is encoded as blockCount+1+loop
+ *@param 	int block 						//Block
+ *@param 	int loop 						//Loop being analysed, -1 for whole program
+ *@return Node of block
+ */
+int nodeOf(int block, int loop)
+{
+	int inner = blocks[block].loop;
+	if(inner == loop)
+		return block;
+	while(inner != -1 && loops[inner].parent != loop)
+		inner = loops[inner].parent;
+	return inner == -1 ? block : blockCount+1+inner;		//Block of a loop which is not nested in "loop"
+}
+
+
+/**
+ *Function to find cycles of a node
+ *@param 	int node 						//Block, or blockCount+1+loop for an inner loop
+ *@return Cycles of block or of all iterations of loop
+ */
+unsigned long long nodeCycles(int node)
+{
+	if(node < blockCount)
+		return blocks[node].cycles;
+	return loops[node-blockCount-1].totalCycles;
+}
+
+
+/**
+ *Function to find cycles of the longest path starting at a node, staying inside a loop
+ *Edges to the header of the loop are not followed, next node of the path is kept in "pathNext"
+ *@param 	int node 						//Block, or blockCount+1+loop for an inner loop
+ *@param 	int loop 						//Loop being analysed, -1 for whole program
+ *@param 	int pass 						//Number which is different for every search
+ *@return Cycles of longest path, UNBOUNDED if path contains a cycle which is not a loop
+ */
+unsigned long long longestPath(int node, int loop, int pass)
+{
+	static unsigned long long memo[2*INPUT_HEIGHT+2];
+	static int memoPass[2*INPUT_HEIGHT+2],visitPass[2*INPUT_HEIGHT+2];
+	unsigned long long best=0,cycles;
+	int b,i,next;
+
+	if(memoPass[node] == pass)
+		return memo[node];
+	if(visitPass[node] == pass)
+		return UNBOUNDED;
+	visitPass[node] = pass;
+	pathNext[node] = -1;
+	for(b=0;b<blockCount;b++)
 	{
-		while(1)
+		if(node < blockCount ? b != node : !loops[node-blockCount-1].isMember[b])
+			continue;
+		for(i=0;i<blocks[b].succCount;i++)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
+			next = blocks[b].succ[i];
+			if(next == blockCount || (loop != -1 && (!loops[loop].isMember[next] || next == loops[loop].header)))
+				continue;
+			next = nodeOf(next,loop);
+			if(next == node)
+				continue;
+			cycles = longestPath(next,loop,pass);
+			if(pathNext[node] == -1 || cycles == UNBOUNDED || (best != UNBOUNDED && cycles > best))
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
+				best = cycles;
+				pathNext[node] = next;
 			}
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+	}
+	memo[node] = addCycles(nodeCycles(node),best);
+	memoPass[node] = pass;
+	return memo[node];
+}
+
+
+/**
+ *Function to get name of a block or loop, with label of block if any
+ *@param 	int node 						//Block, or blockCount+1+loop for a loop
+ *@param 	char* name 						//Array to store name, atleast LABEL_SIZE+10 long
+ *@return char * 		//Pointer to name
+ */
+char * nodeName(int node, char * name)
+{
+	int i;
+	if(node > blockCount)
+	{
+		sprintf(name,"L%d",node-blockCount-1);
+		return name;
+	}
+	sprintf(name,"B%d",node);
+	for(i=0;i<symbTableCount;i++)
+		if(labelIndex[i] == blocks[node].first)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			sprintf(name,"B%d(%s)",node,symbolTable[i].label);
+			break;
+		}
+	return name;
+}
+
+
+/**
+ *Function to print the longest path starting at a node
+ *Jumps into a loop which are not through its header (irreducible flow) can leave a cycle which
+ *is not a loop, its UNBOUNDED path is printed upto the node met again
+ *@param 	int node 						//Block, or blockCount+1+loop for a loop
+ *@return void
+ */
+void printPath(int node)
+{
+	static int printPass[2*INPUT_HEIGHT+2],pass=0;
+	char name[LABEL_SIZE+10];
+
+	pass++;
+	while(node != -1)
+	{
+		printf("%s",nodeName(node,name));
+		if(printPass[node] == pass)
+		{
+			printf(" ... (cycle)");
+			break;
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
+		printPass[node] = pass;
+		node = pathNext[node];
+		if(node != -1)
+			printf(" -> ");
 	}
+	printf("\n");
 }
 
-void interpretMUL(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to estimate worst case execution time of "optProgram" without running it
+ *Builds control flow graph, finds LOP/ELP and jump loops, bounds LOP/ELP loops by
+ *their count when it is a known constant and reports cycles of every block, every loop
+ *and the whole program along with the paths taking most cycles
+ *@return void
+ */
+void estimateWCET(void)
 {
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000000011";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	static bool isDone[MAX_LOOPS];
+	unsigned long long total;
+	int i,j,pass=0,doneCount=0;
+	bool isReady;
+	char name[LABEL_SIZE+10];
+
+	setDefaultCosts();
+	if(optCount == 0)
+		return;
+	if(!matchLoops())
+	{
+		fprintf(stderr,"cass: WCET analysis needs LOP and ELP to be properly nested\n");
+		return;
+	}
+	propagateConstants();
+	loopCount = 0;
+	buildCFG();
+	memset(visitState,0,sizeof(int)*(blockCount+1));
+	postCount = 0;
+	findBackEdges(0);
+	findLoops();
+
+	//Inner loops are analysed before the loops containing them
+	memset(isDone,0,sizeof(bool)*loopCount);
+	while(doneCount < loopCount)
 	{
-		while(1)
+		for(i=0;i<loopCount;i++)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			if(isDone[i])
+				continue;
+			isReady = true;
+			for(j=0;j<loopCount;j++)
+				if(loops[j].parent == i && !isDone[j])
+					isReady = false;
+			if(!isReady)
+				continue;
+			loops[i].iterationCycles = longestPath(loops[i].header,i,++pass);
+			if(loops[i].bound == 0)
+				loops[i].totalCycles = 0;
+			else if(loops[i].bound == UNBOUNDED || loops[i].iterationCycles == UNBOUNDED
+					|| loops[i].iterationCycles > UNBOUNDED/loops[i].bound)
+				loops[i].totalCycles = UNBOUNDED;
+			else
+				loops[i].totalCycles = loops[i].bound*loops[i].iterationCycles;
+			isDone[i] = true;
+			doneCount++;
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+	}
+	total = longestPath(nodeOf(0,-1),-1,++pass);
+
+	printf("\nWCET analysis (cycles)\n");
+	printf("%-16s %-12s %-8s %-12s %s\n","Block","ILC","Instr","Cycles","Loop");
+	for(i=0;i<blockCount;i++)
+	{
+		printf("%-16s %5d-%-6d %-8d %-12llu ",nodeName(i,name),optProgram[blocks[i].first].ILC,optProgram[blocks[i].end].ILC-1,
+			blocks[i].end-blocks[i].first,blocks[i].cycles);
+		if(blocks[i].loop == -1)
+			printf("-\n");
+		else
+			printf("L%d\n",blocks[i].loop);
+	}
+	if(loopCount)
+		printf("\n%-6s %-16s %-8s %-12s %-12s %s\n","Loop","Header","Kind","Bound","Iteration","Total");
+	for(i=0;i<loopCount;i++)
+	{
+		printf("L%-5d %-16s %-8s ",i,nodeName(loops[i].header,name),loops[i].isHardware ? "LOP/ELP" : "Jump");
+		if(loops[i].bound == UNBOUNDED)
+			printf("%-12s ","unknown");
+		else
+			printf("%-12llu ",loops[i].bound);
+		if(loops[i].iterationCycles == UNBOUNDED)
+			printf("%-12s ","unbounded");
+		else
+			printf("%-12llu ",loops[i].iterationCycles);
+		if(loops[i].totalCycles == UNBOUNDED)
+			printf("unbounded\n");
+		else
+			printf("%llu\n",loops[i].totalCycles);
+		printf("       Hot path: ");
+		printPath(loops[i].header);
+	}
+
+	if(total == UNBOUNDED)
+		printf("\nWorst case execution time: unbounded (use --loop-bound=N for loops with unknown count)\n");
+	else
+		printf("\nWorst case execution time: %llu cycles\n",total);
+	printf("Worst case path: ");
+	printPath(nodeOf(0,-1));
+	printf("\n");
+
+	for(i=0;i<loopCount;i++)
+		free(loops[i].isMember);
+}
+
+
+/**
+ *Function to read an execution profile into "profileHits" and "profileTaken"
+ *Every line contains address of an instruction, times it was executed and times it jumped
+ *Content after ';' or '#' is treated as comment
+ *@param 	const char* fileName			//Name of profile file
+ *@return void
+ */
+void readProfile(const char * fileName)
+{
+	FILE *fileProfile;
+	char line[2*INPUT_WIDTH];
+	unsigned long long hits,taken;
+	int i,address,lineNumber=0,unknownCount=0;
+
+	fileProfile = fopen(fileName,"r");
+	if(!fileProfile)
+	{
+		fprintf(stderr,"cass: Profile \"%s\" not found !!\n",fileName);
+		exit(1);
+	}
+	memset(profileHits,0,sizeof(unsigned long long)*(optCount+1));
+	memset(profileTaken,0,sizeof(unsigned long long)*(optCount+1));
+	while(fgets(line,sizeof(line),fileProfile))
+	{
+		lineNumber++;
+		line[strcspn(line,";#\r\n")] = '\0';
+		if(sscanf(line,"%d",&address) != 1)
+			continue;
+		taken = 0;
+		if(sscanf(line,"%*d %llu %llu",&hits,&taken) < 1)
+		{
+			fprintf(stderr,"cass: Error at line number %d of profile\nHit count missing\n",lineNumber);
+			exit(1);
+		}
+		for(i=0;i<optCount && optProgram[i].ILC+baseAddress != address;i++)
+			;
+		if(i == optCount)
+		{
+			unknownCount++;
+			continue;
+		}
+		profileHits[i] = hits;
+		profileTaken[i] = taken;
+	}
+	fclose(fileProfile);
+	if(unknownCount)
+		fprintf(stderr,"cass: Warning: %d addresses of profile are not instructions of this program\n",unknownCount);
+}
+
+
+/**
+ *Function to find the block which a block falls into when it does not jump
+ *@param 	int block 						//Block
+ *@return Block, blockCount if program ends, -1 if block always jumps or halts
+ */
+int fallSuccessor(int block)
+{
+	int op = optProgram[blocks[block].end-1].code.op;
+	if(op == OP_JUM || op == OP_HLT)
+		return -1;
+	return blockOf[blocks[block].end];
+}
+
+
+/**
+ *Function to count jumps taken according to profile when blocks are placed in an order
+ *Conditional jumps are always counted, JUM only if its target does not follow it and
+ *falling into a block which is not placed next needs a JUM
+ *@param 	int* order 						//Blocks in order of placement
+ *@param 	int count 						//Number of blocks
+ *@return Number of jumps taken
+ */
+unsigned long long takenJumps(int * order, int count)
+{
+	unsigned long long total=0;
+	int i,last,fall,next;
+	for(i=0;i<count;i++)
+	{
+		last = blocks[order[i]].end-1;
+		next = i+1 < count ? order[i+1] : blockCount;
+		fall = fallSuccessor(order[i]);
+		if(optProgram[last].code.op == OP_JUM)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			if(blockOf[optProgram[last].target] != next)
+				total += profileHits[last];
+			continue;
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
+		if(optProgram[last].code.op != OP_ELP && optProgram[last].code.op != OP_LOP)
+			total += profileTaken[last];
+		if(fall != -1 && fall != next && profileHits[last] > profileTaken[last])
+			total += profileHits[last]-profileTaken[last];
 	}
+	return total;
 }
 
-void interpretDIV(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to reorder basic blocks of "optProgram" using an execution profile
+ *Chains of blocks are built by placing the target of the most executed edges right after
+ *its source, LOP/ELP loops are kept together as they are. Chain of first block is placed
+ *first and the others follow in decreasing order of execution count. JUM to the next
+ *block is dropped and JUM is added where a block no longer falls into its successor
+ *@param 	const char* fileName			//Name of profile file
+ *@return void
+ */
+void layoutProgram(const char * fileName)
 {
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000000100";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	static int chainOf[INPUT_HEIGHT+1],nextBlock[INPUT_HEIGHT+1],prevBlock[INPUT_HEIGHT+1];
+	static int edgeFrom[2*INPUT_HEIGHT],edgeTo[2*INPUT_HEIGHT],order[INPUT_HEIGHT+1],newIndex[INPUT_HEIGHT+1];
+	static unsigned long long edgeWeight[2*INPUT_HEIGHT],chainHeat[INPUT_HEIGHT+1];
+	static optInstruction newProgram[INPUT_HEIGHT+1];
+	int i,j,k,b,edgeCount=0,depth=0,orderCount=0,newCount=0,fall,last,head,best,addedCount=0,removedCount=0;
+	unsigned long long before,after;
+
+	if(!matchLoops())
+	{
+		printf("Profile guided layout skipped: LOP and ELP are not properly nested\n");
+		return;
+	}
+	readProfile(fileName);
+	buildCFG();
+
+	//Every block starts as a chain of its own, blocks of a LOP/ELP loop are joined in order
+	for(b=0;b<blockCount;b++)
+	{
+		nextBlock[b] = prevBlock[b] = -1;
+		chainOf[b] = b;
+	}
+	for(b=0;b<blockCount;b++)
 	{
-		while(1)
+		for(i=blocks[b].first;i<blocks[b].end;i++)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			if(optProgram[i].code.op == OP_LOP)
+				depth++;
+			else if(optProgram[i].code.op == OP_ELP)
+				depth--;
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		if(depth > 0)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			nextBlock[b] = b+1;
+			prevBlock[b+1] = b;
+			chainOf[b+1] = chainOf[b];
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
 	}
-}
 
-void interpretMOD(ofstream & fileOut,bool isFirstPass)
-{
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "000000001010000000010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	//Edges which can become fall through, with the times they were followed
+	for(b=0;b<blockCount;b++)
 	{
-		while(1)
+		last = blocks[b].end-1;
+		fall = fallSuccessor(b);
+		if(optProgram[last].code.op == OP_JUM && blockOf[optProgram[last].target] < blockCount)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			edgeFrom[edgeCount] = b;
+			edgeTo[edgeCount] = blockOf[optProgram[last].target];
+			edgeWeight[edgeCount++] = profileHits[last];
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		else if(fall != -1 && fall < blockCount)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			edgeFrom[edgeCount] = b;
+			edgeTo[edgeCount] = fall;
+			edgeWeight[edgeCount++] = profileHits[last] > profileTaken[last] ? profileHits[last]-profileTaken[last] : 0;
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
 	}
-}
 
+	//Join chains along heaviest edges first
+	for(i=0;i<edgeCount;i++)
+	{
+		best = i;
+		for(j=i+1;j<edgeCount;j++)
+			if(edgeWeight[j] > edgeWeight[best])
+				best = j;
+		k = edgeFrom[i], edgeFrom[i] = edgeFrom[best], edgeFrom[best] = k;
+		k = edgeTo[i], edgeTo[i] = edgeTo[best], edgeTo[best] = k;
+		before = edgeWeight[i], edgeWeight[i] = edgeWeight[best], edgeWeight[best] = before;
+		if(nextBlock[edgeFrom[i]] != -1 || prevBlock[edgeTo[i]] != -1 || edgeTo[i] == 0
+			|| chainOf[edgeFrom[i]] == chainOf[edgeTo[i]])
+			continue;
+		nextBlock[edgeFrom[i]] = edgeTo[i];
+		prevBlock[edgeTo[i]] = edgeFrom[i];
+		for(b=edgeTo[i];b!=-1;b=nextBlock[b])
+			chainOf[b] = chainOf[edgeFrom[i]];
+	}
 
-/**
- *Skipped :
- *OR2
- *AND
- *XOR
- *COM
- */
-void interpretSTI(ofstream & fileOut,bool isFirstPass)
-{
-	int i=0,ILC=0;
-	char reg1[3],reg2[3];
-	char opcode[] = "0000000010100000001010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	//Place chain of first block, then other chains from hottest to coldest
+	for(b=0;b<blockCount;b++)
+		chainHeat[b] = 0;
+	for(b=0;b<blockCount;b++)
+		if(profileHits[blocks[b].first] > chainHeat[chainOf[b]])
+			chainHeat[chainOf[b]] = profileHits[blocks[b].first];
+	for(head=0;head!=-1;)
+	{
+		for(b=head;b!=-1;b=nextBlock[b])
+			order[orderCount++] = b;
+		head = -1;
+		for(b=0;b<blockCount;b++)
+			if(prevBlock[b] == -1 && b != 0 && chainOf[b] != -1 && (head == -1 || chainHeat[chainOf[b]] > chainHeat[chainOf[head]]))
+				head = b;
+		for(b=head;b!=-1;b=nextBlock[b])
+			chainOf[b] = -1;
+		chainOf[0] = -1;
+	}
+	for(b=0;b<blockCount;b++)
+		newIndex[b] = b;
+	before = takenJumps(newIndex,blockCount);
+	after = takenJumps(order,orderCount);
+	if(after >= before)
+	{
+		printf("Profile guided layout made no change: %llu taken jumps can not be reduced\n",before);
+		return;
+	}
+
+	//Copy blocks in new order, fixing the jumps at their ends
+	for(i=0;i<orderCount;i++)
 	{
-		while(1)
+		b = order[i];
+		for(j=blocks[b].first;j<blocks[b].end;j++)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			newIndex[j] = newCount;
+			newProgram[newCount++] = optProgram[j];
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		last = blocks[b].end-1;
+		k = i+1 < orderCount ? order[i+1] : blockCount;
+		fall = fallSuccessor(b);
+		if(optProgram[last].code.op == OP_JUM && blockOf[optProgram[last].target] == k)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg2[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>2)					//Implement exception handling
+			newCount--;							//Target follows, jump is not needed
+			removedCount++;
+		}
+		else if(fall != -1 && fall != k)
+		{
+			if(newCount == INPUT_HEIGHT)
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
+				printf("Profile guided layout made no change: program would be too long\n");
+				return;
 			}
+			newProgram[newCount].code.op = OP_JUM;
+			newProgram[newCount].code.reg1 = newProgram[newCount].code.reg2 = -1;
+			newProgram[newCount].target = blocks[b].end;
+			newProgram[newCount].row = optProgram[blocks[b].end-1].row;
+			newProgram[newCount++].isDeleted = false;
+			addedCount++;
 		}
-		reg2[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		regToBinary(fileOut,reg2);
-		fileOut<<endl;
 	}
+	newIndex[optCount] = newCount;
+	for(i=0;i<newCount;i++)
+		if(newProgram[i].target != -1)
+			newProgram[i].target = newIndex[newProgram[i].target];
+	for(i=0;i<symbTableCount;i++)
+		labelIndex[i] = newIndex[labelIndex[i]];
+	memcpy(optProgram,newProgram,sizeof(optInstruction)*newCount);
+	optCount = newCount;
+	compactProgram();
+	printf("Profile guided layout: taken jumps %llu -> %llu, %d JUM removed, %d JUM added\n",before,after,removedCount,addedCount);
 }
 
-void interpretNOT(ofstream & fileOut,bool isFirstPass)
+
+/**
+ *Function to read one side of a rewrite, instructions separated by '|'
+ *@param 	char* text 						//Text of the side
+ *@param 	instruction* seq 				//Array to store instructions
+ *@param 	unsigned int* variables 		//Bits of variables used by the side are set
+ *@return Number of instructions, -1 if text is invalid
+ */
+int parseRewriteSide(char * text, instruction * seq, unsigned int * variables)
 {
-	int i=0,ILC=0;
-	char reg1[3];
-	char opcode[] = "000000001010000001000000000";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	char name[MNEUMONIC_SIZE+2],*piece,*next;
+	int length=0,op,count;
+
+	*variables = 0;
+	for(piece=text;piece;piece=next)
 	{
-		while(1)
+		next = strchr(piece,'|');
+		if(next)
+			*next++ = '\0';
+		if(sscanf(piece,"%6s",name) != 1)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			if(next || length)
+				return -1;
+			break;							//Empty side
 		}
-		reg1[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		fileOut<<endl;
+		for(op=0;op<OP_INVALID && strcmp(name,mneumonicName[op]);op++)
+			;
+		if(length == MAX_REWRITE_LENGTH || (!isAlu(op) && op != OP_MVR && op != OP_MOI))
+			return -1;
+		seq[length].op = op;
+		seq[length].reg2 = seq[length].addr = -1;
+		seq[length].data = 0;
+		piece = strstr(piece,name)+strlen(name);
+		if(op == OP_MOI)
+			count = sscanf(piece," %%%d , %d",&seq[length].reg1,&seq[length].data) - 2;
+		else if(op == OP_NOT || op == OP_INC || op == OP_DEC)
+			count = sscanf(piece," %%%d",&seq[length].reg1) - 1;
+		else
+			count = sscanf(piece," %%%d , %%%d",&seq[length].reg1,&seq[length].reg2) - 2;
+		if(count != 0 || seq[length].reg1 < 0 || seq[length].reg1 >= MAX_REWRITE_VARS
+			|| seq[length].reg2 < -1 || seq[length].reg2 >= MAX_REWRITE_VARS)
+			return -1;
+		*variables |= 1u<<seq[length].reg1;
+		if(seq[length].reg2 != -1)
+			*variables |= 1u<<seq[length].reg2;
+		length++;
 	}
+	return length;
 }
 
 
 /**
- *Immediate data must be in decimal
+ *Function to read the rewrite database made by cass-superopt
+ *Each line is "pattern => replacement", content after ';' is treated as comment
+ *@param 	const char* fileName 			//Name of rewrite database
+ *@return void
  */
-void interpretMOI(ofstream & fileOut,bool isFirstPass)
+void readRewrites(const char * fileName)
 {
-	int i=0;
-	char reg1[3],data[12];
-	char opcode[] = "000000001010000001000000001";
-	eatWhiteSpace();
-	instructionLocationCounter+=8;
-	if(!isFirstPass)
+	FILE *fileRewrite;
+	char line[256],*arrow;
+	unsigned int patternVars,replacementVars;
+	int i,lineNumber=0;
+	rewriteRule *rule;
+
+	fileRewrite = fopen(fileName,"r");
+	if(!fileRewrite)
+	{
+		fprintf(stderr,"cass: Rewrite database \"%s\" not found !!\n",fileName);
+		exit(1);
+	}
+	while(fgets(line,sizeof(line),fileRewrite))
 	{
-		while(1)
+		lineNumber++;
+		line[strcspn(line,";\r\n")] = '\0';
+		arrow = strstr(line,"=>");
+		if(!arrow)
 		{
-			if(sourceProgram[currentRow][currentIndex] == ',')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
+			if(strspn(line," \t") != strlen(line))
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
+				fprintf(stderr,"cass: Error at line number %d of rewrite database\n\"=>\" missing\n",lineNumber);
 				exit(1);
 			}
+			continue;
 		}
-		reg1[i] = '\0';
-		currentIndex++;
-		eatWhiteSpace();
-		i=0;
-		while(1)
+		if(rewriteCount == MAX_REWRITES)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			data[i++] = sourceProgram[currentRow][currentIndex];
-			currentIndex++;
-			if(sourceProgram[currentRow][currentIndex] == ' ')
-			{
-				eatWhiteSpace();
-				if(sourceProgram[currentRow][currentIndex] != '\0')
-				{
-				fprintf(stderr,"Error at line number : %d \nInvald Register\n", currentRow+1);
-				exit(1);
-				}
-				break;
-			}
-			if(i>10)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			fprintf(stderr,"cass: Rewrite database has more than %d rewrites\n",MAX_REWRITES);
+			exit(1);
 		}
-		data[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		fileOut<<endl;
-		dataToBinary(fileOut,data);
-		fileOut<<endl;
+		*arrow = '\0';
+		rule = &rewriteRules[rewriteCount];
+		rule->patternLength = parseRewriteSide(line,rule->pattern,&patternVars);
+		rule->replacementLength = parseRewriteSide(arrow+2,rule->replacement,&replacementVars);
+		if(rule->patternLength <= 0 || rule->replacementLength < 0)
+		{
+			fprintf(stderr,"cass: Error at line number %d of rewrite database\nInvalid instruction!\n",lineNumber);
+			exit(1);
+		}
+		//Replacement may only use registers bound by pattern and must fit in its place
+		if((replacementVars & ~patternVars) || rule->replacementLength > rule->patternLength)
+			continue;
+		rule->saving = 0;
+		for(i=0;i<rule->patternLength;i++)
+			rule->saving += instructionSize(rule->pattern[i].op);
+		for(i=0;i<rule->replacementLength;i++)
+			rule->saving -= instructionSize(rule->replacement[i].op);
+		if(rule->saving > 0)
+			rewriteCount++;
 	}
+	fclose(fileRewrite);
 }
 
+
 /**
- *Skipped
- *ADI,SUI,MUI,DVI,MDI,ANI,ORI,
- *
+ *Function to check if a rewrite matches the instructions starting at an index
+ *Variables are bound to distinct registers other than ME, which MVR treats as indirect
+ *@param 	rewriteRule* rule 				//Rewrite to be matched
+ *@param 	int index 						//Index of first instruction in "optProgram"
+ *@param 	bool* isTarget 					//Instructions where control may enter
+ *@param 	int* window 					//Index of every matched instruction
+ *@param 	int* binding 					//Register bound to every variable
+ *@return true if rewrite matches
  */
-void interpretINC(ofstream & fileOut,bool isFirstPass)
+bool matchRewrite(rewriteRule * rule, int index, bool * isTarget, int * window, int * binding)
 {
-	int i=0,ILC=0;
-	char reg1[3];
-	char opcode[] = "000000001010000001000001001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	int i,j,k,var[2],reg[2];
+	bool isUsed[NUMBER_OF_REG];
+	instruction *ins;
+
+	memset(isUsed,0,sizeof(isUsed));
+	for(i=0;i<MAX_REWRITE_VARS;i++)
+		binding[i] = -1;
+	for(i=0,j=index;i<rule->patternLength;i++,j=nextLive(j+1))
 	{
-		while(1)
+		if(j >= optCount || (i && isTarget[j]))
+			return false;
+		ins = &optProgram[j].code;
+		if(ins->op != rule->pattern[i].op || (ins->op == OP_MOI && ins->data != rule->pattern[i].data))
+			return false;
+		var[0] = rule->pattern[i].reg1;
+		var[1] = rule->pattern[i].reg2;
+		reg[0] = ins->reg1;
+		reg[1] = ins->reg2;
+		for(k=0;k<2 && var[k] != -1;k++)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
+			if(binding[var[k]] == -1)
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
+				if(reg[k] == REG_ME || isUsed[reg[k]])
+					return false;
+				binding[var[k]] = reg[k];
+				isUsed[reg[k]] = true;
 			}
+			else if(binding[var[k]] != reg[k])
+				return false;
 		}
-		reg1[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		fileOut<<endl;
+		window[i] = j;
 	}
+	return !flagsLiveAfter(window[rule->patternLength-1]);
 }
 
 
-void interpretDEC(ofstream & fileOut,bool isFirstPass)
+/**
+ *Function to apply rewrites of the superoptimizer on "optProgram"
+ *At every instruction the matching rewrite saving most bytes is applied
+ *Runs till no more rewrites match
+ *@return void
+ */
+void applyRewrites(void)
 {
-	int i=0,ILC=0;
-	char reg1[3];
-	char opcode[] = "000000001010000001000001010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	static bool isTarget[INPUT_HEIGHT+1];
+	int i,j,k,best,appliedCount=0,oldILC;
+	int window[MAX_REWRITE_LENGTH],binding[MAX_REWRITE_VARS],bestWindow[MAX_REWRITE_LENGTH],bestBinding[MAX_REWRITE_VARS];
+	bool isChanged=true;
+	rewriteRule *rule;
+
+	oldILC = optProgram[optCount].ILC;
+	while(isChanged)
 	{
-		while(1)
+		isChanged = false;
+		memset(isTarget,0,sizeof(bool)*(optCount+1));
+		for(i=0;i<optCount;i++)
+			if(!optProgram[i].isDeleted && optProgram[i].target != -1)
+				isTarget[nextLive(optProgram[i].target)] = true;
+		for(i=0;i<symbTableCount;i++)
+			isTarget[nextLive(labelIndex[i])] = true;
+
+		for(i=nextLive(0);i<optCount;i=nextLive(i+1))
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
+			best = -1;
+			for(j=0;j<rewriteCount;j++)
+				if((best == -1 || rewriteRules[j].saving > rewriteRules[best].saving) && matchRewrite(&rewriteRules[j],i,isTarget,window,binding))
+				{
+					best = j;
+					memcpy(bestWindow,window,sizeof(window));
+					memcpy(bestBinding,binding,sizeof(binding));
+				}
+			if(best == -1)
+				continue;
+			rule = &rewriteRules[best];
+			if(verbosFlag)
+				printf("Rewrite: replaced %d instructions at ILC %d, saving %d bytes\n",rule->patternLength,optProgram[i].ILC,rule->saving);
+			for(k=0;k<rule->patternLength;k++)
 			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
+				if(k >= rule->replacementLength)
+				{
+					optProgram[bestWindow[k]].isDeleted = true;
+					continue;
+				}
+				optProgram[bestWindow[k]].code = rule->replacement[k];
+				optProgram[bestWindow[k]].code.reg1 = bestBinding[rule->replacement[k].reg1];
+				if(rule->replacement[k].reg2 != -1)
+					optProgram[bestWindow[k]].code.reg2 = bestBinding[rule->replacement[k].reg2];
 			}
+			appliedCount++;
+			isChanged = true;
 		}
-		reg1[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		fileOut<<endl;
+		compactProgram();
 	}
+	printf("Rewrite database applied %d rewrites (%d bytes)\n",appliedCount,oldILC - optProgram[optCount].ILC);
 }
 
+
 /**
- *Skipped : LHS,RHS,PSH,POP,OUT,IN
+ *Function to fill default latencies used by scheduler
+ *Results are available to the next instruction except for LDR, MVR X,ME, MUL, DIV and MOD
+ *@return void
  */
-void interpretLOP(ofstream & fileOut,bool isFirstPass)
+void setDefaultLatencies(void)
 {
-	int i=0;
-	char reg1[3];
-	char opcode[] = "000000001010000001000010001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
-	if(!isFirstPass)
+	int i;
+	if(isLatencySet)
+		return;
+	for(i=0;i<=OP_INVALID;i++)
+		latency[i] = isaLatency[i];			//From isa.def
+	isLatencySet = true;
+}
+
+
+/**
+ *Function to read result latency of each mneumonic from a latency table file
+ *Every line contains a mneumonic and its latency, LOAD gives latency of MVR X,ME
+ *Content after ';' or '#' is treated as comment
+ *@param 	const char* fileName			//Name of latency table file
+ *@return void
+ */
+void readLatencyTable(const char * fileName)
+{
+	FILE *fileLatency;
+	char line[INPUT_WIDTH],name[MNEUMONIC_SIZE+2];
+	unsigned int cycles;
+	int i,lineNumber=0;
+
+	setDefaultLatencies();
+	fileLatency = fopen(fileName,"r");
+	if(!fileLatency)
+	{
+		fprintf(stderr,"cass: Latency table \"%s\" not found !!\n",fileName);
+		exit(1);
+	}
+	while(fgets(line,sizeof(line),fileLatency))
 	{
-		while(1)
+		lineNumber++;
+		line[strcspn(line,";#\r\n")] = '\0';
+		if(sscanf(line,"%6s",name) != 1)
+			continue;
+		if(sscanf(line,"%*s %u",&cycles) != 1 || cycles == 0)
 		{
-			if(sourceProgram[currentRow][currentIndex] == '\0')
-				break;
-			reg1[i++] = toupper(sourceProgram[currentRow][currentIndex]);
-			currentIndex++;
-			eatWhiteSpace();
-			if(i>2)					//Implement exception handling
-			{
-				fprintf(stderr,"Error at line number : %d \n", currentRow+1);
-				exit(1);
-			}
+			fprintf(stderr,"cass: Error at line number %d of latency table\nLatency missing\n",lineNumber);
+			exit(1);
+		}
+		for(i=0;name[i]!='\0';i++)
+			name[i] = toupper(name[i]);
+		if(!strcmp(name,"LOAD"))
+		{
+			loadLatency = cycles;
+			continue;
+		}
+		for(i=0;i<OP_INVALID && strcmp(name,mneumonicName[i]);i++)
+			;
+		if(i == OP_INVALID)
+		{
+			fprintf(stderr,"cass: Error at line number %d of latency table\nInvalid mnemnonic!\n",lineNumber);
+			exit(1);
 		}
-		reg1[i] = '\0';
-		fileOut<<opcode;
-		regToBinary(fileOut,reg1);
-		fileOut<<endl;
+		latency[i] = cycles;
 	}
+	fclose(fileLatency);
 }
 
-void interpretELP(ofstream & fileOut, bool isFirstPass)
-{
-	char opcode[] = "00000000101000000100001010000000";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
 
-	if(!isFirstPass)
+/**
+ *Function to find how an instruction accesses memory
+ *MVR treats ME as address of memory, STI stores first register at address in second
+ *@param 	instruction* ins 				//Decoded instruction
+ *@return Mask of MEM_READ, MEM_WRITE and MAY_TRAP
+ */
+int memoryAccess(instruction * ins)
+{
+	switch(ins->op)
 	{
-		fileOut<<opcode;
-		fileOut<<endl;
+		case OP_LDR : return MEM_READ;
+		case OP_STR : case OP_STI : return MEM_WRITE;
+		case OP_DIV : case OP_MOD : return MAY_TRAP;
+		case OP_OUT : case OP_INP : return MEM_WRITE | MAY_TRAP;		//Port accesses stay in order
+		case OP_MVR : return (ins->reg2 == REG_ME ? MEM_READ : 0) | (ins->reg1 == REG_ME ? MEM_WRITE : 0);
 	}
+	return 0;
 }
 
-void interpretHLT(ofstream & fileOut, bool isFirstPass)
-{
-	char opcode[] = "00000000101000000100001010000001";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
 
-	if(!isFirstPass)
-	{
-		fileOut<<opcode;
-		fileOut<<endl;
-	}
-	isEnd =true;
+/**
+ *Function to find cycles after which result of an instruction can be read
+ *@param 	instruction* ins 				//Decoded instruction
+ *@return Latency in cycles
+ */
+unsigned int resultLatency(instruction * ins)
+{
+	if(ins->op == OP_MVR && ins->reg2 == REG_ME)
+		return loadLatency;
+	return latency[ins->op];
 }
 
-void interpretNOP(ofstream & fileOut, bool isFirstPass)
+
+/**
+ *Function to count stall cycles of instructions issued in order, one per cycle
+ *An instruction waits till all registers and flags it reads are available
+ *@param 	int* order 						//Index of every instruction in "optProgram"
+ *@param 	int count 						//Number of instructions
+ *@return Cycles spent waiting
+ */
+unsigned long long blockStalls(int * order, int count)
 {
-	char opcode[] = "00000000101000000100001010000010";
-	eatWhiteSpace();
-	instructionLocationCounter+=4;
+	unsigned long long ready[NUMBER_OF_REG+1],issue,previous=0,stalls=0;
+	unsigned int uses,defs;
+	int i,r;
 
-	if(!isFirstPass)
+	memset(ready,0,sizeof(ready));
+	for(i=0;i<count;i++)
 	{
-		fileOut<<opcode;
-		fileOut<<endl;
+		uses = useMask(&optProgram[order[i]].code);
+		defs = defMask(&optProgram[order[i]].code);
+		issue = previous+1;
+		for(r=0;r<=NUMBER_OF_REG;r++)
+			if((uses>>r & 1) && ready[r] > issue)
+				issue = ready[r];
+		stalls += issue-previous-1;
+		previous = issue;
+		for(r=0;r<=NUMBER_OF_REG;r++)
+			if(defs>>r & 1)
+				ready[r] = issue + resultLatency(&optProgram[order[i]].code);
 	}
+	return stalls;
 }
 
+
 /**
- *Function to convert "immediate" DECIMAL data(in char form) into 32 bit binary data
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	char* data						//Array of data
+ *Function to check if a later instruction must stay after an earlier one
+ *Registers and flags must not be read or written out of order, stores are not
+ *moved across other memory accesses and instructions which may trap
+ *@param 	int first 						//Index of earlier instruction in "optProgram"
+ *@param 	int second 						//Index of later instruction in "optProgram"
+ *@return true if order of instructions must be kept
+ */
+bool isDependent(int first, int second)
+{
+	instruction *a = &optProgram[first].code,*b = &optProgram[second].code;
+	int memA = memoryAccess(a),memB = memoryAccess(b);
+
+	if((useMask(b) & defMask(a)) || (defMask(b) & useMask(a)) || (defMask(b) & defMask(a)))
+		return true;
+	if(((memA & MEM_WRITE) && memB) || ((memB & MEM_WRITE) && memA))
+		return true;
+	return (memA & MAY_TRAP) && (memB & MAY_TRAP);
+}
+
+
+/**
+ *Function to list schedule a window of instructions of a basic block
+ *At every step the instruction which can issue earliest is chosen among those whose
+ *predecessors are scheduled, ties are broken by longest latency path to end of window
+ *@param 	int* order 						//Index of every instruction in "optProgram", reordered in place
+ *@param 	int count 						//Number of instructions, atmost SCHEDULE_WINDOW
  *@return void
  */
-void dataToBinary(ofstream & fileOut,char * data)
+void scheduleWindow(int * order, int count)
 {
-	int integer;
-	unsigned long long int bin;
-	integer = atoi(data);
-	bin = decToBinary(integer);
-	fileOut<<setw(32)<<setfill('0')<<bin;
+	static bool isEdge[SCHEDULE_WINDOW][SCHEDULE_WINDOW];
+	unsigned long long height[SCHEDULE_WINDOW],ready[NUMBER_OF_REG+1],issue,bestIssue=0,previous=0,edge;
+	int result[SCHEDULE_WINDOW],waiting[SCHEDULE_WINDOW],i,j,r,best,step;
+	bool isScheduled[SCHEDULE_WINDOW];
+	unsigned int uses;
+
+	for(i=0;i<count;i++)
+		for(j=0;j<count;j++)
+			isEdge[i][j] = i < j && isDependent(order[i],order[j]);
+	for(i=count-1;i>=0;i--)
+	{
+		height[i] = resultLatency(&optProgram[order[i]].code);
+		waiting[i] = 0;
+		for(j=i+1;j<count;j++)
+		{
+			if(!isEdge[i][j])
+				continue;
+			edge = (useMask(&optProgram[order[j]].code) & defMask(&optProgram[order[i]].code)) ? resultLatency(&optProgram[order[i]].code) : 1;
+			if(edge + height[j] > height[i])
+				height[i] = edge + height[j];
+		}
+		for(j=0;j<i;j++)
+			if(isEdge[j][i])
+				waiting[i]++;
+		isScheduled[i] = false;
+	}
+
+	memset(ready,0,sizeof(ready));
+	for(step=0;step<count;step++)
+	{
+		best = -1;
+		for(i=0;i<count;i++)
+		{
+			if(isScheduled[i] || waiting[i])
+				continue;
+			uses = useMask(&optProgram[order[i]].code);
+			issue = previous+1;
+			for(r=0;r<=NUMBER_OF_REG;r++)
+				if((uses>>r & 1) && ready[r] > issue)
+					issue = ready[r];
+			if(best == -1 || issue < bestIssue || (issue == bestIssue && height[i] > height[best]))
+			{
+				best = i;
+				bestIssue = issue;
+			}
+		}
+		isScheduled[best] = true;
+		result[step] = order[best];
+		previous = bestIssue;
+		for(r=0;r<=NUMBER_OF_REG;r++)
+			if(defMask(&optProgram[order[best]].code)>>r & 1)
+				ready[r] = bestIssue + resultLatency(&optProgram[order[best]].code);
+		for(j=best+1;j<count;j++)
+			if(isEdge[best][j])
+				waiting[j]--;
+	}
+	memcpy(order,result,sizeof(int)*count);
 }
 
 
 /**
- *Function to Search symbol table for a label
- *@param 	char* element				//Label to be searched for
- *@return ILC of label, -1 if label not found
+ *Function to reorder instructions of every basic block of "optProgram" to remove stalls
+ *Jumps, LOP, ELP and HLT stay at the end of their block so loops and labels are not
+ *disturbed. A block is changed only if its stall cycles decrease
+ *@return void
  */
-int searchSymbolTable(char * element)
+void scheduleProgram(void)
 {
-	int i;
-	for(i=0;i<=symbTableCount;i++)
+	static int order[INPUT_HEIGHT+1];
+	static optInstruction newProgram[INPUT_HEIGHT+1];
+	unsigned long long before,after,totalBefore=0,totalAfter=0;
+	int b,i,count,body,changedCount=0;
+
+	setDefaultLatencies();
+	if(!matchLoops())
 	{
-		if(!strcmp(symbolTable[i].label,element))
-			return symbolTable[i].ILC;
+		printf("Scheduler skipped: LOP and ELP are not properly nested\n");
+		return;
 	}
-	return -1;
+	buildCFG();
+	for(b=0;b<blockCount;b++)
+	{
+		count = blocks[b].end - blocks[b].first;
+		for(i=0;i<count;i++)
+			order[i] = blocks[b].first + i;
+		before = blockStalls(order,count);
+		body = count;
+		switch(optProgram[blocks[b].end-1].code.op)
+		{
+			case OP_JZR : case OP_JUM : case OP_JMC : case OP_JMZ : case OP_JMP :
+			case OP_LOP : case OP_ELP : case OP_HLT :
+				body--;
+		}
+		for(i=0;i<body;i+=SCHEDULE_WINDOW)
+			scheduleWindow(order+i,body-i < SCHEDULE_WINDOW ? body-i : SCHEDULE_WINDOW);
+		after = blockStalls(order,count);
+		totalBefore += before;
+		if(after >= before)
+		{
+			totalAfter += before;
+			continue;
+		}
+		totalAfter += after;
+		changedCount++;
+		if(verbosFlag)
+			printf("Scheduler: block at ILC %d, stall cycles %llu -> %llu\n",optProgram[blocks[b].first].ILC,before,after);
+		for(i=0;i<count;i++)
+			newProgram[i] = optProgram[order[i]];
+		memcpy(&optProgram[blocks[b].first],newProgram,sizeof(optInstruction)*count);
+	}
+	compactProgram();
+	printf("Scheduler removed %llu stall cycles (%llu -> %llu) in %d blocks\n",totalBefore-totalAfter,totalBefore,totalAfter,changedCount);
 }
 
 
 /**
- *Function to convert decimal number to Binary
- *@param  int								//Decimal number
- *@return unsigned long long 				//Binary equivalent of the given data
+ *Function to write symbol file used by cass-sim and other tools, named out_file.sym
+ *Source file is written as "SOURCE name", every label as "LABEL name address" and
+ *every instruction as "LINE address line source", addresses are in bytes
+ *@param 	const char* inputFileName 		//Name of source file
+ *@param 	const char* outputFileName 		//Name of output file
+ *@return void
  */
-unsigned long long int decToBinary(int num)
+void writeSymbols(const char * inputFileName, const char * outputFileName)
 {
-	unsigned long long bin=0,t=1,bit;
-	while(num)
+	FILE *fileSymbols;
+	char fileName[FILENAME_MAX];
+	int i,ILC,row;
+	bool isOptimized = optimizeLevel || wcetFlag || profileFileName || rewriteFileName || scheduleFlag;
+
+	snprintf(fileName,sizeof(fileName),"%s.sym",outputFileName);
+	fileSymbols = fopen(fileName,"w");
+	if(!fileSymbols)
 	{
-		bit = num % 2;
-		num = num / 2;
-		bin += bit*t;
-		t *= 10;
+		fprintf(stderr,"cass: Could not write symbol file \"%s\"\n",fileName);
+		exit(1);
 	}
-	return bin;
+	fprintf(fileSymbols,"; cass symbols of \"%s\"\nSOURCE %s\n",outputFileName,inputFileName);
+	for(i=0;i<symbTableCount;i++)
+		fprintf(fileSymbols,"LABEL %s %d\n",symbolTable[i].label,symbolTable[i].ILC+baseAddress);
+	if(isOptimized)
+	{
+		for(i=0;i<optCount;i++)
+			if(optProgram[i].row >= 0)
+				fprintf(fileSymbols,"LINE %d %d %s\n",optProgram[i].ILC+baseAddress,optProgram[i].row+1,
+					sourceProgram[optProgram[i].row]+strspn(sourceProgram[optProgram[i].row]," \t"));
+	}
+	else
+	{
+		for(ILC=0;ILC<instructionLocationCounter;ILC+=4)
+		{
+			row = sourceRow[ILC/4];
+			if(row >= 0)
+				fprintf(fileSymbols,"LINE %d %d %s\n",ILC+baseAddress,row+1,sourceProgram[row]+strspn(sourceProgram[row]," \t"));
+		}
+	}
+	fclose(fileSymbols);
 }
 
+
 /**
- *Function to convert register to a binary and write the output in file
- *@param 	ofstream& fileOut				//Output File stream
- *@param 	char* reg 						//Name of register
+ *Function to add time since end of previous phase to a phase
+ *Does nothing unless --phase-times, --stats or --trace-json is given
+ *@param 	int phase 						//Phase which has just ended (PHASE_XXX)
  *@return void
  */
-void regToBinary(ofstream & fileOut, char * reg)
+void endPhase(int phase)
 {
-	const char *registr[] = {
-		"A",		"B",		"C",		"D",
-		"E",		"F",		"G",		"H",
-		"I",		"J",		"K",		"L",
-		"M",		"N",		"O",		"P",
-		"Q",		"R",		"S",		"T",
-		"U",		"V",		"W",		"X",
-		"Y",		"Z",		"ZA",		"ME"
-	};
+	chrono::steady_clock::time_point now;
+	phaseSpan span;
+
+	if(!isInstrumented)
+		return;
+	now = chrono::steady_clock::now();
+	span.phase = phase;
+	span.start = chrono::duration<double>(phaseStart - instrumentStart).count();
+	span.end = chrono::duration<double>(now - instrumentStart).count();
+	phaseSeconds[phase] += span.end - span.start;
+	phaseSpans.push_back(span);
+	phaseStart = now;
+}
 
-	const char *opcode[] = {
-		"00000",		"00001",		"00010",		"00011",
-		"00100",		"00101",		"00110",		"00111",
-		"01000",		"01001",		"01010",		"01011",
-		"01100",		"01101",		"01110",		"01111",
-		"10000",		"10001",		"10010",		"10011",
-		"10100",		"10101",		"10110",		"10111",
-		"11000",		"11001",		"11010",		"11011"
-	};
 
-	for (int i = 0; i < NUMBER_OF_REG ; ++i)
+/**
+ *Function to print time taken by every phase as one line of JSON, read by cass-bench
+ *@param 	int lines 						//Lines of source
+ *@param 	long bytes 						//Bytes of source
+ *@return void
+ */
+void printPhaseTimes(int lines, long bytes)
+{
+	double total=0;
+	int k;
+
+	printf("{\"lines\":%d,\"bytes\":%ld",lines,bytes);
+	for(k=0;k<PHASE_COUNT;k++)
 	{
-		if(!strcmp(reg,registr[i]))
-			fileOut<<opcode[i];
+		printf(",\"%s\":%.9f",phaseName[k],phaseSeconds[k]);
+		total += phaseSeconds[k];
 	}
+	printf(",\"total\":%.9f}\n",total);
 }
 
-//Modify the code so that if entered hex is of only 1 or 2 or 3 characters then output must be in 16 bit format only
+
 /**
- *Function to convert 4bit hexadecimal address into 16 bit binary
- *@param 	ofstream& fileOut				//Output File stream
- *@param  	char* reg 						//Address pointer
+ *Function to print time of every phase and counters of an assembly
+ *@param 	int lines 						//Lines of source
+ *@param 	long inputBytes 				//Bytes of source
+ *@param 	long outputBytes 				//Bytes of image written
  *@return void
  */
-void hexToBinary(ofstream & fileOut,char * reg)			//Its not register, but pointer to address
+void printStats(int lines, long inputBytes, long outputBytes)
 {
-	int i;
-	if(strlen(reg)!=4)
+	double total=0;
+	int k;
+
+	for(k=0;k<PHASE_COUNT;k++)
+		total += phaseSeconds[k];
+	printf("Stats : %.6f seconds\n",total);
+	for(k=0;k<PHASE_COUNT;k++)
+		printf("\t%-10s %12.6f s %6.2f%%\n",phaseName[k],phaseSeconds[k],total > 0 ? 100*phaseSeconds[k]/total : 0.0);
+	printf("\tLines read            : %d (%ld bytes)\n",lines,inputBytes);
+	printf("\tInstructions          : %d\n",instructionCount);
+	printf("\tLabels                : %d\n",symbTableCount);
+	printf("\tSymbol table probes   : %lld\n",symbolProbes);
+	printf("\tBytes written         : %ld\n",outputBytes);
+}
+
+
+/**
+ *Function to write phases of an assembly as Chrome trace events
+ *Every span of a phase is a complete event of the one thread of cass, counters are a
+ *counter event at end. File can be opened in chrome://tracing or Perfetto
+ *@param 	const char* fileName 			//Trace file
+ *@param 	int lines 						//Lines of source
+ *@param 	long inputBytes 				//Bytes of source
+ *@param 	long outputBytes 				//Bytes of image written
+ *@return void
+ */
+void writeTraceJson(const char * fileName, int lines, long inputBytes, long outputBytes)
+{
+	FILE *fileTrace;
+	double end=0;
+	size_t i;
+
+	fileTrace = fopen(fileName,"w");
+	if(!fileTrace)
 	{
-		fprintf(stderr, "cass: Error at line number %d\nInvalid 16 bit address",currentRow+1);
-		exit(1);
+		fprintf(stderr,"cass: Could not write trace \"%s\"\n",fileName);
+		return;
+	}
+	fprintf(fileTrace,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fileTrace,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cass\"}},\n");
+	fprintf(fileTrace,"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}");
+	for(i=0;i<phaseSpans.size();i++)
+	{
+		fprintf(fileTrace,",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			phaseName[phaseSpans[i].phase],1e6*phaseSpans[i].start,1e6*(phaseSpans[i].end - phaseSpans[i].start));
+		end = max(end,phaseSpans[i].end);
 	}
-	for (i = 0; reg[i] != '\0' ; ++i)
-	{
-		switch(reg[i])
-		{
-			case '0' : fileOut<<"0000";
-						break;
-			case '1' : fileOut<<"0001";
-						break;
-			case '2' : fileOut<<"0010";
-						break;
-			case '3' : fileOut<<"0011";
-						break;
-			case '4' : fileOut<<"0100";
-						break;
-			case '5' : fileOut<<"0101";
-						break;
-			case '6' : fileOut<<"0110";
-						break;
-			case '7' : fileOut<<"0111";
-						break;
-			case '8' : fileOut<<"1000";
-						break;
-			case '9' : fileOut<<"1001";
-						break;
-			case 'A' : fileOut<<"1010";
-						break;
-			case 'B' : fileOut<<"1011";
-						break;
-			case 'C' : fileOut<<"1100";
-						break;
-			case 'D' : fileOut<<"1101";
-						break;
-			case 'E' : fileOut<<"1110";
-						break;
-			case 'F' : fileOut<<"1111";
-						break;
-			default : fprintf(stderr,"Error at line number : %d \nInvalid operands.\n",currentRow+1);
-		}
-	}
-}
\ No newline at end of file
+	fprintf(fileTrace,",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{\"lines\":%d,"
+		"\"inputBytes\":%ld,\"instructions\":%d,\"labels\":%d,\"symbolProbes\":%lld,\"bytesWritten\":%ld}}\n]}\n",
+		1e6*end,lines,inputBytes,instructionCount,symbTableCount,symbolProbes,outputBytes);
+	fclose(fileTrace);
+}
@@ -0,0 +1,475 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-BENCH : Benchmarks of the assembler on synthetic and sample programs				****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Generates synthetic programs of given size, label density, branch density and
+ *				MOI mix, runs cass --phase-times on them and on the sample programs and writes
+ *				lines and bytes per second of every phase as JSON
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<vector>
+#include<algorithm>
+#include<chrono>
+#include<dirent.h>
+#include<sys/wait.h>
+#include "isa.h"
+
+using namespace std;
+
+
+/**
+ *Macros
+ */
+#define GENERATED_REGS 26				//Registers A to Z are used by synthetic programs
+#define RESULT_LINE 4096				//Max characters of a line printed by cass
+#define PHASE_COUNT 7					//Phases printed by cass --phase-times, with total
+
+
+/**
+ *Structure to hold parameters of a synthetic program
+ *@double Fraction of lines which are labels
+ *@double Fraction of instructions which are jumps
+ *@double Fraction of instructions which are MOI
+ *@unsigned int Seed of random numbers
+ */
+struct generatorConfig {
+	double labelDensity;
+	double branchDensity;
+	double moiMix;
+	unsigned int seed;
+};
+
+typedef struct generatorConfig generatorConfig;
+
+
+/**
+ *Structure to hold result of benchmark of one program
+ *@string Name of program
+ *@string Empty if cass succeeded, else first line it printed on error
+ *@bool cass was run with --stream
+ *@long Lines and bytes of source
+ *@double Seconds of every phase, best run
+ *@double Seconds of best run measured from outside, with start of process
+ */
+struct benchResult {
+	string name;
+	string error;
+	bool isStream;
+	long lines;
+	long bytes;
+	double seconds[PHASE_COUNT];
+	double wallSeconds;
+};
+
+typedef struct benchResult benchResult;
+
+static const char * const phaseName[PHASE_COUNT] = {
+	"read",		"strip",	"pass1",	"pass2",
+	"optimize",	"write",	"total"
+};
+
+
+/**
+ *Global Variables
+ */
+int repeatCount=3;
+long streamFrom=10000;					//Synthetic programs of this many lines or more use cass --stream
+string cassPath = "./cass";
+string workDirectory = ".";
+unsigned int randomState;
+
+
+/**
+ *Function declarations
+ */
+unsigned int nextRandom(void);
+void generateProgram(FILE * , long , const generatorConfig * );
+string quote(const string & );
+bool runCass(const string & , bool , benchResult * );
+void writeResult(FILE * , const benchResult * , bool );
+vector<long> parseSizes(const char * );
+
+
+/**
+ *Accepting command line arguments for sizes, generator and output
+ */
+int main(int argc, char const *argv[])
+{
+	generatorConfig config = {0.05, 0.1, 0.2, 1};
+	vector<long> sizes;
+	vector<benchResult> synthetic,samples;
+	vector<string> sampleFiles;
+	benchResult result;
+	string sampleDirectory = "Sample Inputs",programName,outputFileName;
+	FILE *fileOut,*fileProgram;
+	DIR *directory;
+	struct dirent *entry;
+	long generateLines=-1;
+	size_t i,length;
+	int k;
+
+	sizes = parseSizes("1000,10000,100000,1000000,10000000");
+	for(k=1;k<argc;k++)
+	{
+		if(!strcmp(argv[k],"--help"))
+		{
+			printf("\n\t\tcass-bench: Usage: %s [options]\n\t\t[options]\t--generate=N \t Write a synthetic program of N lines to stdout and exit\n",argv[0]);
+			printf("\t\t\t\t--label-density=F \t Fraction of lines which are labels (default 0.05)\n");
+			printf("\t\t\t\t--branch-density=F \t Fraction of instructions which are jumps (default 0.1)\n");
+			printf("\t\t\t\t--moi-mix=F \t Fraction of instructions which are MOI (default 0.2)\n");
+			printf("\t\t\t\t--seed=N \t Seed of synthetic programs (default 1)\n");
+			printf("\t\t\t\t--sizes=LIST \t Lines of synthetic programs (default 1000,10000,...,10000000)\n");
+			printf("\t\t\t\t--repeat=N \t Runs of every program, best one is kept (default 3)\n");
+			printf("\t\t\t\t--stream-from=N \t Run cass --stream on programs of N lines or more (default 10000)\n");
+			printf("\t\t\t\t--cass=PATH \t Assembler to benchmark (default ./cass)\n");
+			printf("\t\t\t\t--samples=DIR \t Directory of sample programs (default \"Sample Inputs\")\n");
+			printf("\t\t\t\t--work-dir=DIR \t Directory for synthetic programs (default .)\n");
+			printf("\t\t\t\t--output=FILE \t Write JSON to FILE instead of stdout\n\n");
+			return 0;
+		}
+		else if(!strncmp(argv[k],"--generate=",11))
+			generateLines = atol(argv[k]+11);
+		else if(!strncmp(argv[k],"--label-density=",16))
+			config.labelDensity = atof(argv[k]+16);
+		else if(!strncmp(argv[k],"--branch-density=",17))
+			config.branchDensity = atof(argv[k]+17);
+		else if(!strncmp(argv[k],"--moi-mix=",10))
+			config.moiMix = atof(argv[k]+10);
+		else if(!strncmp(argv[k],"--seed=",7))
+			config.seed = strtoul(argv[k]+7,NULL,10);
+		else if(!strncmp(argv[k],"--sizes=",8))
+			sizes = parseSizes(argv[k]+8);
+		else if(!strncmp(argv[k],"--repeat=",9))
+			repeatCount = max(1,atoi(argv[k]+9));
+		else if(!strncmp(argv[k],"--stream-from=",14))
+			streamFrom = atol(argv[k]+14);
+		else if(!strncmp(argv[k],"--cass=",7))
+			cassPath = argv[k]+7;
+		else if(!strncmp(argv[k],"--samples=",10))
+			sampleDirectory = argv[k]+10;
+		else if(!strncmp(argv[k],"--work-dir=",11))
+			workDirectory = argv[k]+11;
+		else if(!strncmp(argv[k],"--output=",9))
+			outputFileName = argv[k]+9;
+		else
+		{
+			fprintf(stderr,"cass-bench: Unknown option \"%s\"\nFor help use %s --help\n",argv[k],argv[0]);
+			return 1;
+		}
+	}
+	if(config.labelDensity < 0 || config.branchDensity < 0 || config.moiMix < 0 || config.labelDensity >= 1
+		|| config.branchDensity + config.moiMix > 1)
+	{
+		fprintf(stderr,"cass-bench: Densities must be from 0 to 1, label density below 1 and branch density and MOI mix upto 1 together\n");
+		return 1;
+	}
+	if(generateLines >= 0)
+	{
+		generateProgram(stdout,generateLines,&config);
+		return 0;
+	}
+
+	programName = workDirectory + "/cass-bench.asm";
+	for(i=0;i<sizes.size();i++)
+	{
+		fileProgram = fopen(programName.c_str(),"wb");
+		if(!fileProgram)
+		{
+			fprintf(stderr,"cass-bench: Could not write \"%s\"\n",programName.c_str());
+			return 1;
+		}
+		generateProgram(fileProgram,sizes[i],&config);
+		fclose(fileProgram);
+		fprintf(stderr,"cass-bench: %ld lines\n",sizes[i]);
+		runCass(programName,sizes[i] >= streamFrom,&result);
+		result.name = "synthetic-" + to_string(sizes[i]);
+		synthetic.push_back(result);
+	}
+	remove(programName.c_str());
+
+	directory = opendir(sampleDirectory.c_str());
+	while(directory && (entry = readdir(directory)))
+	{
+		length = strlen(entry->d_name);
+		if(length > 4 && !strcmp(entry->d_name+length-4,".asm"))
+			sampleFiles.push_back(entry->d_name);
+	}
+	if(directory)
+		closedir(directory);
+	else
+		fprintf(stderr,"cass-bench: Sample directory \"%s\" not found, only synthetic programs are run\n",sampleDirectory.c_str());
+	sort(sampleFiles.begin(),sampleFiles.end());
+	for(i=0;i<sampleFiles.size();i++)
+	{
+		runCass(sampleDirectory + "/" + sampleFiles[i],false,&result);
+		result.name = sampleFiles[i];
+		samples.push_back(result);
+	}
+	remove((workDirectory + "/cass-bench.out").c_str());
+
+	fileOut = outputFileName.empty() ? stdout : fopen(outputFileName.c_str(),"w");
+	if(!fileOut)
+	{
+		fprintf(stderr,"cass-bench: Could not write \"%s\"\n",outputFileName.c_str());
+		return 1;
+	}
+	fprintf(fileOut,"{\n\t\"cass\": \"%s\",\n\t\"repeat\": %d,\n",cassPath.c_str(),repeatCount);
+	fprintf(fileOut,"\t\"generator\": {\"labelDensity\": %g, \"branchDensity\": %g, \"moiMix\": %g, \"seed\": %u},\n",
+		config.labelDensity,config.branchDensity,config.moiMix,config.seed);
+	fprintf(fileOut,"\t\"synthetic\": [");
+	for(i=0;i<synthetic.size();i++)
+		writeResult(fileOut,&synthetic[i],i+1 == synthetic.size());
+	fprintf(fileOut,"\n\t],\n\t\"samples\": [");
+	for(i=0;i<samples.size();i++)
+		writeResult(fileOut,&samples[i],i+1 == samples.size());
+	fprintf(fileOut,"\n\t]\n}\n");
+	if(fileOut != stdout)
+		fclose(fileOut);
+	return 0;
+}
+
+
+/**
+ *Function to get next number of a xorshift generator
+ *@return Random number
+ */
+unsigned int nextRandom(void)
+{
+	randomState ^= randomState<<13;
+	randomState ^= randomState>>17;
+	randomState ^= randomState<<5;
+	return randomState;
+}
+
+
+/**
+ *Function to write a synthetic program
+ *Labels are spread evenly over the program. Jumps go to one of next two labels or to
+ *a random label before them, only to labels within 16 bit address space, so every
+ *program assembles whatever its size. Lines end with "\r\n" as cass needs
+ *@param 	FILE* fileOut 					//Output file
+ *@param 	long lines 						//Lines of program, with START and HLT
+ *@param 	generatorConfig* config 		//Densities and seed
+ *@return void
+ */
+void generateProgram(FILE * fileOut, long lines, const generatorConfig * config)
+{
+	static const int aluOps[] = {OP_MVR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD};
+	static const int oneRegOps[] = {OP_NOT, OP_INC, OP_DEC};
+	static const int jumpOps[] = {OP_JUM, OP_JMC, OP_JMZ, OP_JMP, OP_JZR};
+	const char *reg1,*reg2;
+	long body,labels,label=0,reachable=0,spacing,address=0,i;
+	double pick;
+	int op;
+
+	randomState = config->seed ? config->seed : 1;
+	fprintf(fileOut,"START\r\n");
+	body = max(0L,lines-2);
+	labels = (long)(body*config->labelDensity);
+	spacing = labels ? body/labels + 1 : 0;
+	for(i=0;i<body;i++)
+	{
+		if(label < labels && (i+1)*labels/body > label)
+		{
+			fprintf(fileOut,"L%ld\r\n",label++);
+			if(address <= 0xFFFF)
+				reachable = label;
+			continue;
+		}
+		reg1 = registerName[nextRandom()%GENERATED_REGS];
+		reg2 = registerName[nextRandom()%GENERATED_REGS];
+		pick = (nextRandom() & 0xFFFFFF)/(double)0x1000000;
+		if(pick < config->branchDensity)
+		{
+			op = jumpOps[nextRandom()%5];
+			if(op == OP_JZR)
+				fprintf(fileOut," JZR %s,",reg1);
+			else
+				fprintf(fileOut," %s ",mneumonicName[op]);
+			if(label+1 < labels && address + 2*8*spacing <= 0xFFFF && nextRandom()%2)
+				fprintf(fileOut,"L%ld\r\n",label + nextRandom()%2);
+			else if(reachable)
+				fprintf(fileOut,"L%u\r\n",(unsigned int)(nextRandom()%reachable));
+			else
+				fprintf(fileOut,"START\r\n");
+		}
+		else if(pick < config->branchDensity + config->moiMix)
+		{
+			fprintf(fileOut," MOI %s,%u\r\n",reg1,nextRandom()%100000);
+			address += 4;
+		}
+		else
+		{
+			switch(nextRandom()%4)
+			{
+				case 0 : fprintf(fileOut," %s %s,%s\r\n",mneumonicName[aluOps[nextRandom()%6]],reg1,reg2);
+						break;
+				case 1 : fprintf(fileOut," %s %s\r\n",mneumonicName[oneRegOps[nextRandom()%3]],reg1);
+						break;
+				case 2 : fprintf(fileOut," LDR %s,%04XH\r\n",reg1,0x2000 + nextRandom()%0x1000);
+						break;
+				default : fprintf(fileOut," STR %s,%04XH\r\n",reg1,0x5000 + nextRandom()%0x1000);
+						break;
+			}
+		}
+		address += 4;
+	}
+	if(lines > 1)
+		fprintf(fileOut," HLT\r\n");
+}
+
+
+/**
+ *Function to quote a path for the shell
+ *@param 	string& text 					//Path
+ *@return Path in single quotes
+ */
+string quote(const string & text)
+{
+	string quoted = "'";
+	size_t i;
+	for(i=0;i<text.size();i++)
+		quoted += text[i] == '\'' ? string("'\\''") : string(1,text[i]);
+	return quoted + "'";
+}
+
+
+/**
+ *Function to run cass --phase-times on a program "repeatCount" times
+ *Run with the least total is kept, its phase times are read from the JSON line cass prints
+ *@param 	string& fileName 				//Source program
+ *@param 	bool isStream 					//Run cass with --stream
+ *@param 	benchResult* result 			//Result of best run
+ *@return false if cass failed
+ */
+bool runCass(const string & fileName, bool isStream, benchResult * result)
+{
+	string command = quote(cassPath) + (isStream ? " --stream" : "") + " --phase-times " + quote(fileName) + " " + quote(workDirectory + "/cass-bench.out") + " 2>&1";
+	chrono::steady_clock::time_point start;
+	double seconds[PHASE_COUNT],wall;
+	char line[RESULT_LINE];
+	const char *field;
+	FILE *pipe;
+	bool hasTimes;
+	int run,k,status;
+
+	result->error.clear();
+	result->isStream = isStream;
+	result->lines = result->bytes = 0;
+	result->wallSeconds = 0;
+	for(k=0;k<PHASE_COUNT;k++)
+		result->seconds[k] = 0;
+	for(run=0;run<repeatCount;run++)
+	{
+		start = chrono::steady_clock::now();
+		pipe = popen(command.c_str(),"r");
+		if(!pipe)
+		{
+			result->error = "Could not run " + cassPath;
+			return false;
+		}
+		hasTimes = false;
+		while(fgets(line,sizeof(line),pipe))
+		{
+			line[strcspn(line,"\r\n")] = '\0';
+			if(line[0] == '{' && strstr(line,"\"total\":"))
+			{
+				sscanf(line,"{\"lines\":%ld,\"bytes\":%ld",&result->lines,&result->bytes);
+				for(k=0;k<PHASE_COUNT;k++)
+				{
+					field = strstr(line,(string("\"") + phaseName[k] + "\":").c_str());
+					seconds[k] = field ? atof(strchr(field,':')+1) : 0;
+				}
+				hasTimes = true;
+			}
+			else if(!strncmp(line,"cass",4) && result->error.empty())
+				result->error = line;
+		}
+		status = pclose(pipe);
+		wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if(status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) || !hasTimes)
+		{
+			if(result->error.empty())
+				result->error = WIFSIGNALED(status) ? "cass was killed by signal " + to_string(WTERMSIG(status)) : "cass failed";
+			return false;
+		}
+		result->error.clear();
+		if(run == 0 || seconds[PHASE_COUNT-1] < result->seconds[PHASE_COUNT-1])
+		{
+			for(k=0;k<PHASE_COUNT;k++)
+				result->seconds[k] = seconds[k];
+			result->wallSeconds = wall;
+		}
+	}
+	return true;
+}
+
+
+/**
+ *Function to write result of a program as an element of a JSON array
+ *@param 	FILE* fileOut 					//Output file
+ *@param 	benchResult* result 			//Result
+ *@param 	bool isLast 					//Last element of array
+ *@return void
+ */
+void writeResult(FILE * fileOut, const benchResult * result, bool isLast)
+{
+	string error;
+	size_t i;
+	int k;
+
+	fprintf(fileOut,"\n\t\t{\"name\": \"%s\", \"stream\": %s, ",result->name.c_str(),result->isStream ? "true" : "false");
+	if(!result->error.empty())
+	{
+		for(i=0;i<result->error.size();i++)
+		{
+			if(result->error[i] == '"' || result->error[i] == '\\')
+				error += '\\';
+			if((unsigned char)result->error[i] >= ' ')
+				error += result->error[i];
+		}
+		fprintf(fileOut,"\"status\": \"failed\", \"error\": \"%s\"}%s",error.c_str(),isLast ? "" : ",");
+		return;
+	}
+	fprintf(fileOut,"\"status\": \"ok\", \"lines\": %ld, \"bytes\": %ld, \"wallSeconds\": %.6f,\n\t\t\"phases\": {",
+		result->lines,result->bytes,result->wallSeconds);
+	for(k=0;k<PHASE_COUNT;k++)
+		fprintf(fileOut,"%s\n\t\t\t\"%s\": {\"seconds\": %.9f, \"linesPerSecond\": %.0f, \"bytesPerSecond\": %.0f}",k ? "," : "",
+			phaseName[k],result->seconds[k],result->seconds[k] > 0 ? result->lines/result->seconds[k] : 0.0,
+			result->seconds[k] > 0 ? result->bytes/result->seconds[k] : 0.0);
+	fprintf(fileOut,"\n\t\t}}%s",isLast ? "" : ",");
+}
+
+
+/**
+ *Function to parse a comma separated list of sizes
+ *@param 	const char* list 				//List
+ *@return Sizes
+ */
+vector<long> parseSizes(const char * list)
+{
+	vector<long> sizes;
+	char *end;
+	long size;
+
+	while(*list)
+	{
+		size = strtol(list,&end,10);
+		if(end == list)
+			break;
+		if(size > 0)
+			sizes.push_back(size);
+		list = *end == ',' ? end+1 : end;
+	}
+	return sizes;
+}
@@ -0,0 +1,382 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-DIS : Disassembler of images written by cass										****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Turns an image back into source which cass assembles into the same image.
+ *				Words are decoded through tables built from isa.def, labels come
+ *				from the symbol file written by cass -g or are made up for jump targets
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<string>
+#include<vector>
+#include "isa.h"
+#include "symbols.h"
+
+using namespace std;
+
+
+/**
+ *Macros
+ */
+#define OP_ESCAPE 0xFF					//Entry of a table which is resolved by the next table
+#define NO_FIELD 0xFF					//Field is not used by operation
+#define LINE_WIDTH 160					//Max characters of one line of output
+#define PREFIX_CUT 16					//First table is indexed by bits from here to 31
+#define FUNCTION_CUT 5					//Second table is indexed by bits from here to 19
+
+
+/**
+ *Structure to hold where fields of an operation lie in its word
+ *@unsigned char Lowest bit of first register, NO_FIELD if not used
+ *@unsigned char Lowest bit of second register, NO_FIELD if not used
+ *@bool Word holds 16 bit address in its lowest bits
+ */
+struct fieldLayout {
+	unsigned char reg1Shift;
+	unsigned char reg2Shift;
+	bool hasAddress;
+};
+
+typedef struct fieldLayout fieldLayout;
+
+
+/**
+ *Global Variables
+ */
+int verbosFlag=0;
+unsigned char prefixOp[1<<16];			//Operation of bits 16 to 31 of a word
+unsigned char functionOp[1<<15];		//Operation of bits 5 to 19, for words escaped by "prefixOp"
+unsigned char lowOp[32];				//Operation of bits 0 to 4, for words escaped by "functionOp"
+fieldLayout layout[OP_INVALID+1];
+unsigned int words[MAX_IMAGE_WORDS+1];
+
+
+/**
+ *Function declarations
+ */
+void buildTables(void);
+int decodeFast(unsigned int , instruction * );
+void disassemble(const char * , int , const debugInfo * , bool );
+
+
+/**
+ *Accepting command line arguments for image and symbol file
+ */
+int main(int argc, char const *argv[])
+{
+	ifstream fileIn;
+	debugInfo info;
+	string symbolFileName;
+	bool hasSymbols;
+	int i,count;
+
+	for(i=1;i<argc && argv[i][0] == '-' && argv[i][1] != '\0';i++)
+	{
+		if(!strcmp(argv[i],"--help"))
+		{
+			printf("\n\t\tcass-dis: Usage: %s [options] image_file\n\t\t[options]\t-v \t Show address, word and source line of every instruction\n",argv[0]);
+			printf("\t\t\t\t--symbols=FILE \t Symbol file written by cass -g (default image_file.sym)\n\n");
+			printf("\t\tSource is written to stdout and can be given back to cass\n\n");
+			return 0;
+		}
+		else if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(!strncmp(argv[i],"--symbols=",10))
+			symbolFileName = argv[i]+10;
+		else
+		{
+			fprintf(stderr,"cass-dis: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+	if(i != argc-1)
+	{
+		printf("cass-dis: Usage: %s [options] image_file\nFor help use %s --help\n",argv[0],argv[0]);
+		return 0;
+	}
+
+	if(!strcmp(argv[i],"-"))
+		count = readImage(cin,words,MAX_IMAGE_WORDS);		//Image from stdin
+	else
+	{
+		fileIn.open(argv[i],ios::in | ios::binary);
+		if(!fileIn)
+		{
+			fprintf(stderr,"cass-dis: Image file \"%s\" not found !!\n",argv[i]);
+			return 1;
+		}
+		count = readImage(fileIn,words,MAX_IMAGE_WORDS);
+	}
+	if(count < 0)
+	{
+		fprintf(stderr,"cass-dis: \"%s\" is not an image written by cass\n",argv[i]);
+		return 1;
+	}
+	if(symbolFileName.empty())
+		symbolFileName = string(argv[i]) + ".sym";
+	hasSymbols = readSymbols(symbolFileName.c_str(),&info,count);
+
+	buildTables();
+	disassemble(argv[i],count,&info,hasSymbols);
+	return 0;
+}
+
+
+/**
+ *Function to build decoding tables from isa.def
+ *Fields of every operation are given by kind of its operands. Bits which are not
+ *fields are fixed; an operation whose fixed bits are all in bits 16 to 31 is found
+ *by "prefixOp" alone, others escape to "functionOp" and then to "lowOp"
+ *@return void
+ */
+void buildTables(void)
+{
+	instruction ins;
+	unsigned int fieldMask,word;
+	int op,reg1,reg2,depth,kind;
+
+	memset(prefixOp,OP_INVALID,sizeof(prefixOp));
+	memset(functionOp,OP_INVALID,sizeof(functionOp));
+	memset(lowOp,OP_INVALID,sizeof(lowOp));
+	layout[OP_INVALID].reg1Shift = layout[OP_INVALID].reg2Shift = NO_FIELD;
+	layout[OP_INVALID].hasAddress = false;
+
+	for(op=0;op<OP_INVALID;op++)
+	{
+		kind = isaOperands[op];
+		layout[op].reg1Shift = isaReg1Shift[kind] == -1 ? NO_FIELD : isaReg1Shift[kind];
+		layout[op].reg2Shift = isaReg2Shift[kind] == -1 ? NO_FIELD : isaReg2Shift[kind];
+		layout[op].hasAddress = kind == ARGS_REG_ADDR || kind == ARGS_REG_LABEL || kind == ARGS_LABEL;
+		fieldMask = isaFieldMask[kind];
+		ins.op = op;
+		ins.reg1 = ins.reg2 = ins.addr = 0;
+		if(!(~fieldMask & ((1u<<PREFIX_CUT)-1)))
+			depth = 1;
+		else if(!(~fieldMask & ((1u<<FUNCTION_CUT)-1)))
+			depth = 2;
+		else
+			depth = 3;
+
+		//Every value of registers, fields below the cut of a table do not change its index
+		for(reg1=0;reg1<=(layout[op].reg1Shift == NO_FIELD ? 0 : REG_ME);reg1++)
+			for(reg2=0;reg2<=(layout[op].reg2Shift == NO_FIELD ? 0 : REG_ME);reg2++)
+			{
+				ins.reg1 = reg1;
+				ins.reg2 = reg2;
+				word = encodeWord(&ins);
+				if(depth == 1)
+				{
+					prefixOp[word>>PREFIX_CUT] = op;
+					continue;
+				}
+				prefixOp[word>>PREFIX_CUT] = OP_ESCAPE;
+				if(depth == 2)
+				{
+					functionOp[(word>>FUNCTION_CUT) & 0x7FFF] = op;
+					continue;
+				}
+				functionOp[(word>>FUNCTION_CUT) & 0x7FFF] = OP_ESCAPE;
+				lowOp[word & 31] = op;
+			}
+	}
+}
+
+
+/**
+ *Function to decode a word through the tables, gives same result as decodeWord
+ *@param 	unsigned int word				//Encoded instruction
+ *@param 	instruction* ins				//Decoded fields
+ *@return Operation, OP_INVALID if word is not a valid instruction
+ */
+inline int decodeFast(unsigned int word, instruction * ins)
+{
+	const fieldLayout *fields;
+	int op;
+
+	op = prefixOp[word>>PREFIX_CUT];
+	if(op == OP_ESCAPE)
+	{
+		op = functionOp[(word>>FUNCTION_CUT) & 0x7FFF];
+		if(op == OP_ESCAPE)
+			op = lowOp[word & 31];
+	}
+	fields = &layout[op];
+	ins->reg1 = fields->reg1Shift == NO_FIELD ? -1 : (word>>fields->reg1Shift) & 31;
+	ins->reg2 = fields->reg2Shift == NO_FIELD ? -1 : (word>>fields->reg2Shift) & 31;
+	ins->addr = fields->hasAddress ? (int)(word & 0xFFFF) : -1;
+	ins->data = 0;
+	if(ins->reg1 > REG_ME || ins->reg2 > REG_ME)
+		op = OP_INVALID;
+	ins->op = op;
+	return op;
+}
+
+
+/**
+ *Functions to append text to a line of output
+ */
+static inline char * putText(char * p, const char * text)
+{
+	while(*text)
+		*p++ = *text++;
+	return p;
+}
+
+static inline char * putHex(char * p, unsigned int value, int digits)
+{
+	static const char hexDigit[] = "0123456789ABCDEF";
+	while(digits--)
+		*p++ = hexDigit[(value>>(4*digits)) & 15];
+	return p;
+}
+
+static inline char * putDecimal(char * p, int value)
+{
+	char digits[12];
+	unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+	int i=0;
+
+	if(value < 0)
+		*p++ = '-';
+	do
+	{
+		digits[i++] = '0' + magnitude%10;
+		magnitude /= 10;
+	}while(magnitude);
+	while(i)
+		*p++ = digits[--i];
+	return p;
+}
+
+
+/**
+ *Function to write source of an image to stdout
+ *Labels of symbol file are kept, jump targets without one get "L_ADDR". Data word of
+ *MOI and port word of OUT and INP are taken with their instruction; a word which is not
+ *an instruction is written as a comment
+ *@param 	const char* fileName 			//Name of image
+ *@param 	int count 						//Words of image
+ *@param 	debugInfo* info 				//Contents of symbol file
+ *@param 	bool hasSymbols 				//Symbol file was read
+ *@return void
+ */
+void disassemble(const char * fileName, int count, const debugInfo * info, bool hasSymbols)
+{
+	vector<unsigned char> ops(count+1,OP_INVALID),isStart(count+1,0),isTarget(count+1,0);
+	vector<int> firstLabel(count+1,-1);
+	vector<char> out;
+	instruction ins;
+	char line[LINE_WIDTH],*p;
+	int i,j,size,target,label;
+
+	//First pass finds where instructions start and which of them are jumped to
+	for(i=0;i<count;i+=size)
+	{
+		ops[i] = decodeFast(words[i],&ins);
+		isStart[i] = 1;
+		size = ops[i] == OP_INVALID ? 1 : instructionSize(ops[i])/4;
+		if(isJump(ops[i]) && !(ins.addr & 3) && ins.addr/4 <= count)
+			isTarget[ins.addr/4] = 1;
+	}
+	isStart[count] = 1;
+	for(j=(int)info->labelAddress.size()-1;j>=0;j--)
+		if(info->labelAddress[j] >= 0 && !(info->labelAddress[j] & 3) && info->labelAddress[j]/4 <= count)
+			firstLabel[info->labelAddress[j]/4] = j;
+
+	out.reserve((size_t)count*(verbosFlag ? 64 : 24) + 256);
+	p = line;
+	p = putText(p,"; Disassembled from ");
+	p = putText(p,fileName);
+	p = putText(p,"\r\n");
+	if(firstLabel[0] == -1)
+		p = putText(p,"START\r\n");
+	out.insert(out.end(),line,p);
+
+	for(i=0;i<=count;i+=size)
+	{
+		p = line;
+		size = 1;
+		if(firstLabel[i] != -1)
+		{
+			for(label=firstLabel[i];label<(int)info->labelAddress.size() && info->labelAddress[label] == 4*i;label++)
+			{
+				out.insert(out.end(),line,putText(line,info->labelName[label].c_str()));
+				out.push_back('\r');
+				out.push_back('\n');
+			}
+		}
+		else if(isTarget[i])
+		{
+			p = putHex(putText(p,"L_"),4*i,4);
+			p = putText(p,"\r\n");
+			out.insert(out.end(),line,p);
+			p = line;
+		}
+		if(i == count)
+			break;
+
+		decodeFast(words[i],&ins);
+		if(ins.op == OP_INVALID)
+		{
+			p = putHex(putText(p," ; Word "),words[i],8);
+			p = putText(p," is not an instruction");
+		}
+		else
+		{
+			size = instructionSize(ins.op)/4;
+			if(i+size > count)
+			{
+				size = count-i;
+				p = putHex(putText(p," ; Word "),words[i],8);
+				p = putText(p," has lost its second word");
+				goto endLine;
+			}
+			*p++ = ' ';
+			p = putText(p,mneumonicName[ins.op]);
+			if(ins.reg1 != -1)
+				p = putText(putText(p," "),registerName[ins.reg1]);
+			if(ins.reg2 != -1)
+				p = putText(putText(p,","),registerName[ins.reg2]);
+			if(size == 2)
+				p = putDecimal(putText(p,","),(int)words[i+1]);
+			if(isJump(ins.op))
+			{
+				*p++ = isaOperands[ins.op] == ARGS_REG_LABEL ? ',' : ' ';
+				target = ins.addr/4;
+				if(!(ins.addr & 3) && target <= count && firstLabel[target] != -1)
+					p = putText(p,info->labelName[firstLabel[target]].c_str());
+				else
+				{
+					p = putHex(putText(p,"L_"),ins.addr,4);
+					if((ins.addr & 3) || target > count || !isStart[target])
+						p = putText(p," ; Target is not an instruction");
+				}
+			}
+			else if(ins.addr != -1)
+				p = putText(putHex(putText(p,","),ins.addr,4),"H");
+		}
+		if(verbosFlag)
+		{
+			p = putText(putHex(putText(p," ; "),4*i,4),"H");
+			for(j=0;j<size;j++)
+				p = putHex(putText(p," "),words[i+j],8);
+			if(hasSymbols && info->line[i])
+				p = putDecimal(putText(p," line "),info->line[i]);
+		}
+endLine:
+		p = putText(p,"\r\n");
+		out.insert(out.end(),line,p);
+	}
+	fwrite(out.data(),1,out.size(),stdout);
+}
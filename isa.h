@@ -0,0 +1,477 @@
+/**
+ *******************************************************************************************************************
+ *						CASS : Instruction word definitions shared by cass and its tools						****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Decoding and encoding of the 32 bit instruction words produced by
+ *				cass, as described in documentation/isa.pdf
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+#ifndef ISA_H
+#define ISA_H
+
+#include<istream>
+#include<ostream>
+#include<cstring>
+#include<vector>
+#if defined(__GNUC__) && defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+/**
+ *Macros
+ */
+#define WORD_SIZE 32					//Specifies number of bits in an instruction word
+#define REG_ME 27						//Register holding memory address for indirect access
+#define MAX_IMAGE_WORDS 65536			//Specifies max number of words in an encoded image
+
+#define FLAG_Z 1						//Zero flag
+#define FLAG_C 2						//Carry flag
+#define FLAG_P 4						//Parity flag
+#define FLAG_A 8						//Auxillary carry flag
+#define FLAG_S 16						//Sign flag
+
+
+/**
+ *Kinds of operands of an instruction, as written in source
+ *Kind also fixes where fields lie in the word, see "isaReg1Shift", "isaReg2Shift" and "isaFieldMask"
+ */
+enum operandKind {
+	ARGS_NONE,			//No operand
+	ARGS_REG,			//X, register in bits 0 to 4
+	ARGS_REG_REG,		//X,Y, registers in bits 5 to 9 and 0 to 4
+	ARGS_REG_ADDR,		//X,ADDRH, register in bits 16 to 20, 16 bit address in bits 0 to 15
+	ARGS_REG_LABEL,		//X,LABEL, as ARGS_REG_ADDR with address of label
+	ARGS_LABEL,			//LABEL, address of label in bits 0 to 15
+	ARGS_REG_DATA,		//X,DATA, register in bits 0 to 4, decimal data in following word
+	ARGS_REG_PORT,		//X,PORT, register in bits 0 to 4, decimal port in following word
+	ARGS_COUNT
+};
+
+static const signed char isaReg1Shift[ARGS_COUNT] = {-1, 0, 5, 16, 16, -1, 0, 0};
+static const signed char isaReg2Shift[ARGS_COUNT] = {-1, -1, 0, -1, -1, -1, -1, -1};
+static const unsigned int isaFieldMask[ARGS_COUNT] = {0, 0x1F, 0x3FF, 0x1FFFFF, 0x1FFFFF, 0xFFFF, 0x1F, 0x1F};
+
+
+/**
+ *Operations of the ISA which are implemented by cass, one for every line of isa.def
+ */
+enum operation {
+#define ISA_OP(name,operands,opcode,size,latency,group) OP_##name,
+#include "isa.def"
+#undef ISA_OP
+	OP_INVALID
+};
+
+static const char * const mneumonicName[] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) #name,
+#include "isa.def"
+#undef ISA_OP
+	"???"
+};
+
+static const unsigned char isaOperands[] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) operands,
+#include "isa.def"
+#undef ISA_OP
+	ARGS_NONE
+};
+
+static const unsigned int isaOpcode[] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) opcode,
+#include "isa.def"
+#undef ISA_OP
+	0
+};
+
+static const unsigned char isaSize[] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) size,
+#include "isa.def"
+#undef ISA_OP
+	4
+};
+
+static const unsigned char isaLatency[] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) latency,
+#include "isa.def"
+#undef ISA_OP
+	1
+};
+
+static const char * const registerName[] = {
+	"A",		"B",		"C",		"D",
+	"E",		"F",		"G",		"H",
+	"I",		"J",		"K",		"L",
+	"M",		"N",		"O",		"P",
+	"Q",		"R",		"S",		"T",
+	"U",		"V",		"W",		"X",
+	"Y",		"Z",		"ZA",		"ME"
+};
+
+
+/**
+ *Structure to hold the fields of a decoded instruction
+ *@int 	Operation (OP_XXX)
+ *@int 	First register field, -1 if not used
+ *@int 	Second register field, -1 if not used
+ *@int 	16 bit address or jump target, -1 if not used
+ *@int 	Immediate data of MOI or port of OUT and INP (second word)
+ */
+struct instruction {
+	int op;
+	int reg1;
+	int reg2;
+	int addr;
+	int data;
+};
+
+typedef struct instruction instruction;
+
+
+/**
+ *Function to decode a 32 bit instruction word
+ *Immediate data of MOI and port of OUT and INP are in the following word and are not filled here
+ *A word is an operation when it equals opcode of the operation outside the fields of its operands
+ *@param 	unsigned int word				//Encoded instruction
+ *@param 	instruction* ins				//Decoded fields
+ *@return Operation, OP_INVALID if word is not a valid instruction
+ */
+inline int decodeWord(unsigned int word, instruction * ins)
+{
+	int op,kind;
+
+	ins->reg1 = ins->reg2 = ins->addr = -1;
+	ins->data = 0;
+	for(op=0;op<OP_INVALID && (word & ~isaFieldMask[isaOperands[op]]) != isaOpcode[op];op++)
+		;
+	ins->op = op;
+	if(op == OP_INVALID)
+		return op;
+	kind = isaOperands[op];
+	if(isaReg1Shift[kind] != -1)
+		ins->reg1 = (word>>isaReg1Shift[kind]) & 31;
+	if(isaReg2Shift[kind] != -1)
+		ins->reg2 = (word>>isaReg2Shift[kind]) & 31;
+	if(kind == ARGS_REG_ADDR || kind == ARGS_REG_LABEL || kind == ARGS_LABEL)
+		ins->addr = word & 0xFFFF;
+	if(ins->reg1 > REG_ME || ins->reg2 > REG_ME)
+		ins->op = OP_INVALID;
+	return ins->op;
+}
+
+
+/**
+ *Function to encode an instruction into a 32 bit word
+ *Immediate data of MOI and port of OUT and INP must be written separately as the following word
+ *@param 	instruction* ins				//Fields of instruction
+ *@return Encoded instruction word
+ */
+inline unsigned int encodeWord(const instruction * ins)
+{
+	unsigned int word;
+	int kind;
+
+	if(ins->op < 0 || ins->op >= OP_INVALID)
+		return 0;
+	word = isaOpcode[ins->op];
+	kind = isaOperands[ins->op];
+	if(isaReg1Shift[kind] != -1)
+		word |= (unsigned int)ins->reg1<<isaReg1Shift[kind];
+	if(isaReg2Shift[kind] != -1)
+		word |= (unsigned int)ins->reg2<<isaReg2Shift[kind];
+	if(kind == ARGS_REG_ADDR || kind == ARGS_REG_LABEL || kind == ARGS_LABEL)
+		word |= ins->addr & 0xFFFF;
+	return word;
+}
+
+
+/**
+ *Function to find number of bytes occupied by an instruction
+ *MOI, OUT and INP are followed by a word of data
+ *@param 	int op 							//Operation
+ *@return Size in bytes
+ */
+inline int instructionSize(int op)
+{
+	return op >= 0 && op < OP_INVALID ? isaSize[op] : 4;
+}
+
+
+/**
+ *Function to check if an operation transfers control to a label
+ *@param 	int op 							//Operation
+ *@return true if op is JZR, JUM, JMC, JMZ or JMP
+ */
+inline bool isJump(int op)
+{
+	return op >= 0 && op < OP_INVALID && (isaOperands[op] == ARGS_REG_LABEL || isaOperands[op] == ARGS_LABEL);
+}
+
+
+/**
+ *Function to check if an operation is an arithmetic or logical operation
+ *These read their operands, write first register and set all the flags
+ *@param 	int op 							//Operation
+ *@return true for ADD, SUB, MUL, DIV, MOD, NOT, INC and DEC
+ */
+inline bool isAlu(int op)
+{
+	return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_MOD
+		|| op == OP_NOT || op == OP_INC || op == OP_DEC;
+}
+
+
+/**
+ *Function to evaluate an arithmetic or logical operation
+ *Registers are 32 bit, DIV and MOD treat them as signed
+ *@param 	int op 							//Operation
+ *@param 	unsigned int a 					//Value of first register
+ *@param 	unsigned int b 					//Value of second register
+ *@param 	unsigned int* result			//Value to be written in first register
+ *@return false if operation traps (division by zero or overflow)
+ */
+inline bool evaluateAlu(int op, unsigned int a, unsigned int b, unsigned int * result)
+{
+	switch(op)
+	{
+		case OP_MVR : *result = b;
+					break;
+		case OP_ADD : *result = a + b;
+					break;
+		case OP_SUB : *result = a - b;
+					break;
+		case OP_MUL : *result = a * b;
+					break;
+		case OP_DIV : case OP_MOD :
+					if(b == 0 || (a == 0x80000000u && b == 0xFFFFFFFFu))
+						return false;
+					*result = op == OP_DIV ? (unsigned int)((int)a / (int)b) : (unsigned int)((int)a % (int)b);
+					break;
+		case OP_NOT : *result = ~a;
+					break;
+		case OP_INC : *result = a + 1;
+					break;
+		case OP_DEC : *result = a - 1;
+					break;
+		default : return false;
+	}
+	return true;
+}
+
+
+/**
+ *Function to compute flags set by an arithmetic or logical operation
+ *Parity is even parity of lower 8 bits, carry is carry out (borrow for SUB and DEC)
+ *@param 	int op 							//Operation
+ *@param 	unsigned int a 					//Value of first register
+ *@param 	unsigned int b 					//Value of second register (1 for INC and DEC)
+ *@param 	unsigned int result				//Result of operation
+ *@return Flag register value
+ */
+inline unsigned int aluFlags(int op, unsigned int a, unsigned int b, unsigned int result)
+{
+	unsigned int flags=0,parity;
+
+	if(result == 0)
+		flags |= FLAG_Z;
+	if(result>>31)
+		flags |= FLAG_S;
+	parity = result & 0xFF;
+	parity ^= parity>>4;
+	parity ^= parity>>2;
+	parity ^= parity>>1;
+	if(!(parity & 1))
+		flags |= FLAG_P;
+	switch(op)
+	{
+		case OP_ADD : case OP_INC :
+			if(result < a)
+				flags |= FLAG_C;
+			if((a & 0xF) + (b & 0xF) > 0xF)
+				flags |= FLAG_A;
+			break;
+		case OP_SUB : case OP_DEC :
+			if(a < b)
+				flags |= FLAG_C;
+			if((a & 0xF) < (b & 0xF))
+				flags |= FLAG_A;
+			break;
+		case OP_MUL :
+			if(((unsigned long long)a * b)>>32)
+				flags |= FLAG_C;
+			break;
+	}
+	return flags;
+}
+
+
+/**
+ *Function to write a word in the '0'/'1' text format used by cass
+ *@param 	ostream& fileOut				//Output stream
+ *@param 	unsigned int word				//Word to be written
+ *@return void
+ */
+inline void writeWord(std::ostream & fileOut, unsigned int word)
+{
+	char line[WORD_SIZE+1];
+	int i;
+	for(i=0;i<WORD_SIZE;i++)
+		line[i] = (word>>(WORD_SIZE-1-i)) & 1 ? '1' : '0';
+	line[WORD_SIZE] = '\n';
+	fileOut.write(line,WORD_SIZE+1);
+}
+
+
+/**
+ *Function to parse one line of an image without SIMD
+ *@param 	const char* line				//First character of line, atleast WORD_SIZE characters long
+ *@param 	unsigned int* word				//Parsed word
+ *@return false if line has a character other than '0' and '1'
+ */
+inline bool parseLineScalar(const char * line, unsigned int * word)
+{
+	unsigned int value=0,bad=0;
+	int i;
+	for(i=0;i<WORD_SIZE;i++)
+	{
+		bad |= (unsigned int)(line[i] - '0') > 1;
+		value = (value<<1) | (line[i] & 1);
+	}
+	*word = value;
+	return !bad;
+}
+
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define HAS_SIMD_LOADER 1
+
+/**
+ *Function to parse one line of an image with AVX2
+ *32 characters are compared with '0' and '1', movemask gives one bit per character
+ *Characters are reversed first so that the first character becomes the highest bit
+ *@param 	const char* line				//First character of line, atleast WORD_SIZE characters readable
+ *@param 	unsigned int* word				//Parsed word
+ *@return false if line has a character other than '0' and '1'
+ */
+__attribute__((target("avx2"))) inline bool parseLineAvx2(const char * line, unsigned int * word)
+{
+	const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	__m256i text = _mm256_loadu_si256((const __m256i *)line);
+	text = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(text,reverse),0x4E);
+	__m256i ones = _mm256_cmpeq_epi8(text,_mm256_set1_epi8('1'));
+	__m256i zeros = _mm256_cmpeq_epi8(text,_mm256_set1_epi8('0'));
+	*word = (unsigned int)_mm256_movemask_epi8(ones);
+	return (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(ones,zeros)) == 0xFFFFFFFFu;
+}
+
+
+/**
+ *Function to parse one line of an image with SSE2, in two halves of 16 characters
+ *Bits of movemask are in order of characters and are reversed at the end
+ *@param 	const char* line				//First character of line, atleast WORD_SIZE characters readable
+ *@param 	unsigned int* word				//Parsed word
+ *@return false if line has a character other than '0' and '1'
+ */
+inline bool parseLineSse2(const char * line, unsigned int * word)
+{
+	__m128i low = _mm_loadu_si128((const __m128i *)line);
+	__m128i high = _mm_loadu_si128((const __m128i *)(line+16));
+	__m128i one = _mm_set1_epi8('1'),zero = _mm_set1_epi8('0');
+	unsigned int bits,valid;
+
+	bits = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(low,one)) | (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(high,one))<<16;
+	valid = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(low,one),_mm_cmpeq_epi8(low,zero)))
+		| (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(high,one),_mm_cmpeq_epi8(high,zero)))<<16;
+	bits = (bits>>1 & 0x55555555u) | (bits & 0x55555555u)<<1;
+	bits = (bits>>2 & 0x33333333u) | (bits & 0x33333333u)<<2;
+	bits = (bits>>4 & 0x0F0F0F0Fu) | (bits & 0x0F0F0F0Fu)<<4;
+	*word = __builtin_bswap32(bits);
+	return valid == 0xFFFFFFFFu;
+}
+#endif
+
+
+/**
+ *Function to parse an image in the '0'/'1' text format held in memory
+ *Every line is WORD_SIZE characters followed by "\n" or "\r\n", empty lines are skipped
+ *Lines are parsed with AVX2 or SSE2 when the processor has them
+ *@param 	const char* text				//Image
+ *@param 	size_t length					//Number of characters in "text"
+ *@param 	unsigned int* words				//Array to store words
+ *@param 	int maxWords					//Size of array "words"
+ *@return Number of words read, -1 if the image is malformed
+ */
+inline int parseImage(const char * text, size_t length, unsigned int * words, int maxWords)
+{
+	size_t position=0,rest;
+	int count=0;
+	bool isValid;
+#ifdef HAS_SIMD_LOADER
+	static const int simd = __builtin_cpu_supports("avx2") ? 2 : 1;
+#else
+	const int simd = 0;
+#endif
+
+	while(position < length)
+	{
+		if(text[position] == '\n' || (text[position] == '\r' && position+1 < length && text[position+1] == '\n'))
+		{
+			position += text[position] == '\r' ? 2 : 1;		//Empty line
+			continue;
+		}
+		rest = length - position;
+		if(rest < WORD_SIZE || count == maxWords)
+			return -1;
+#ifdef HAS_SIMD_LOADER
+		if(simd == 2)
+			isValid = parseLineAvx2(text+position,&words[count]);
+		else
+			isValid = parseLineSse2(text+position,&words[count]);
+#else
+		isValid = parseLineScalar(text+position,&words[count]);
+#endif
+		if(!isValid)
+			return -1;
+		position += WORD_SIZE;
+		if(position < length && text[position] == '\r')
+			position++;
+		if(position < length && text[position++] != '\n')
+			return -1;
+		count++;
+	}
+	(void)simd;
+	return count;
+}
+
+
+/**
+ *Function to read an image written in the '0'/'1' text format
+ *Whole stream is read in large blocks and then parsed by "parseImage"
+ *@param 	istream& fileIn					//Input stream
+ *@param 	unsigned int* words				//Array to store words
+ *@param 	int maxWords					//Size of array "words"
+ *@return Number of words read, -1 if the image is malformed
+ */
+inline int readImage(std::istream & fileIn, unsigned int * words, int maxWords)
+{
+	std::vector<char> text;
+	size_t length=0;
+
+	//An image can not be longer than maxWords lines of "\r\n" terminated words
+	while(fileIn)
+	{
+		text.resize(length + (1<<16));
+		fileIn.read(&text[length],1<<16);
+		length += fileIn.gcount();
+		if(length > (size_t)maxWords*(WORD_SIZE+2) + (1<<16))
+			return -1;
+	}
+	return parseImage(length ? &text[0] : NULL,length,words,maxWords);
+}
+
+#endif
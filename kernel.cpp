@@ -0,0 +1,1252 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-KC : Compiler of kernel language into source of cass								****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Compiles a small language of expressions and loops into instructions of isa.def on
+ *				virtual registers, gives them the 28 registers by linear scan, spills the rest
+ *				to memory through STR and LDR and writes source which cass assembles
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<cctype>
+#include<climits>
+#include<string>
+#include<vector>
+#include<map>
+#include<algorithm>
+#include "isa.h"
+
+using namespace std;
+
+
+/**
+ *Macros
+ */
+#define NUMBER_OF_REG 28				//Specifies total number of Registers
+#define GENERAL_REGS REG_ME				//Registers A to ZA, ME is kept for memory reached through a register
+#define SCRATCH_REGS 2					//Registers kept for loading spilled operands, taken only when some spill
+#define IR_LABEL (OP_INVALID+1)			//Position of a label in program of virtual registers
+#define IR_LOAD (OP_INVALID+2)			//reg1 = memory[reg2], written through ME
+#define NAME_SIZE 32					//Specifies Max length of a name of variable
+#define INPUT_WIDTH 48					//Specifies Max length of a line read by cass, without "\r\n"
+#define NO_REG -1
+
+
+/**
+ *Kinds of token read from kernel
+ */
+enum tokenKind {
+	T_END,		T_NUMBER,	T_NAME,		T_SYMBOL
+};
+
+/**
+ *Structure to hold a token of kernel
+ *@int Kind (T_XXX)
+ *@long long Value of number
+ *@string Name, or text of symbol
+ *@int Line number
+ */
+struct token {
+	int kind;
+	long long value;
+	string text;
+	int line;
+};
+
+typedef struct token token;
+
+
+/**
+ *Kinds of nodes of a parsed kernel, expressions first and then statements
+ */
+enum nodeKind {
+	N_NUMBER,	N_VARIABLE,	N_MEMORY,	N_INPUT,
+	N_NEGATE,	N_COMPLEMENT,	N_BINARY,	N_COMPARE,
+	N_ASSIGN,	N_STORE,	N_REPEAT,	N_WHILE,
+	N_IF,		N_OUTPUT,	N_HALT
+};
+
+/**
+ *Relations of a condition, REL_NONE tests for non zero
+ */
+enum relation {
+	REL_NONE,	REL_EQ,		REL_NE,		REL_LT,
+	REL_GT,		REL_LE,		REL_GE
+};
+
+/**
+ *Structure to hold a node of a parsed kernel
+ *@int Kind (N_XXX)
+ *@long long Number, operator of N_BINARY, relation of N_COMPARE or port
+ *@int Virtual register of variable
+ *@int Line number
+ *@node* Operands, address and value of N_STORE, count or condition of a loop
+ *@vector Statements of loop, if and else
+ */
+struct node {
+	int kind;
+	long long value;
+	int vreg;
+	int line;
+	struct node *left;
+	struct node *right;
+	vector<struct node *> body;
+	vector<struct node *> elseBody;
+};
+
+typedef struct node node;
+
+
+/**
+ *Structure to hold an instruction on virtual registers
+ *Fields are as of "instruction", "label" is target of jumps and the pair of LOP and ELP
+ *@int Operation (OP_XXX, IR_LABEL or IR_LOAD)
+ *@int First and second virtual register, NO_REG if not used
+ *@long long Address, data or port
+ *@int Label
+ */
+struct irOp {
+	int op;
+	int reg1;
+	int reg2;
+	long long imm;
+	int label;
+};
+
+typedef struct irOp irOp;
+
+
+/**
+ *Global Variables
+ */
+int verbosFlag=0;
+int registerLimit=GENERAL_REGS;			//Registers given to linear scan, with scratch registers
+int spillBase=0xF000;					//Address of first spill slot
+vector<token> tokens;
+size_t tokenIndex=0;
+map<string,int> variableIndex;			//Virtual register of every variable
+vector<string> vregName;				//Name of every virtual register, empty for temporaries
+vector<irOp> program;
+int labelCount=0;
+int endLabel;							//Label of HLT, "halt" jumps here
+vector<int> physical;					//Register of every virtual register, NO_REG if spilled
+vector<int> spillSlot;					//Address of spilled virtual registers
+int scratch[SCRATCH_REGS];
+int pinnedVreg=NO_REG;					//Virtual register living in ME
+
+
+/**
+ *Function declarations
+ */
+bool readTokens(const char * );
+void syntaxError(const char * );
+bool isSymbol(const char * );
+void expectSymbol(const char * );
+vector<node *> parseBlock(bool );
+node * parseStatement(void);
+node * parseCondition(void);
+node * parseExpression(void);
+node * parseTerm(void);
+node * parseUnary(void);
+node * parsePrimary(void);
+node * newNode(int , node * , node * );
+int variableOf(const string & );
+int newTemporary(void);
+int newLabel(void);
+void emit(int , int , int , long long , int );
+bool references(const node * , int );
+bool readsPort(const node * );
+void genStatements(const vector<node *> & );
+void genInto(node * , int );
+int genValue(node * );
+void genCondition(node * , int );
+int irUses(const irOp * , int * );
+int irDef(const irOp * );
+void pinMemoryRegister(void);
+int allocateRegisters(int );
+void writeProgram(FILE * , const char * );
+
+
+/**
+ *Accepting command line arguments for kernel and output file
+ */
+int main(int argc, char const *argv[])
+{
+	vector<node *> statements;
+	const char *inputFileName,*outputFileName;
+	FILE *fileOut,*fileReport;
+	int i,spills;
+
+	for(i=1;i<argc && argv[i][0] == '-' && argv[i][1] != '\0';i++)
+	{
+		if(!strcmp(argv[i],"--help"))
+		{
+			printf("\n\t\tcass-kc: Usage: %s [options] kernel_file out_file\n\t\t[options]\t-v \t Print register of every variable\n",argv[0]);
+			printf("\t\t\t\t--registers=N \t Registers given to allocator, 1 to %d (default %d)\n",GENERAL_REGS,GENERAL_REGS);
+			printf("\t\t\t\t--spill-base=ADDR \t Address of first spill slot (default F000H)\n\n");
+			printf("\t\tout_file is source of cass, kernel_file and out_file may be \"-\" for stdin and stdout\n");
+			printf("\t\tSample Usage:\n\t\tn = mem[2480H]\n\t\tf = 1\n\t\trepeat n {\n\t\t\tf = f * n\n\t\t\tn = n - 1\n\t\t}\n\t\tmem[5000H] = f\n\n");
+			return 0;
+		}
+		else if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(!strncmp(argv[i],"--registers=",12))
+		{
+			registerLimit = atoi(argv[i]+12);
+			if(registerLimit < 1 || registerLimit > GENERAL_REGS)
+			{
+				fprintf(stderr,"cass-kc: --registers must be from 1 to %d\n",GENERAL_REGS);
+				return 1;
+			}
+		}
+		else if(!strncmp(argv[i],"--spill-base=",13))
+			spillBase = (int)strtol(argv[i]+13,NULL,16) & 0xFFFF;
+		else
+		{
+			fprintf(stderr,"cass-kc: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+	if(argc-i != 2)
+	{
+		printf("cass-kc: Usage: %s [options] kernel_file out_file\nFor help use %s --help\n",argv[0],argv[0]);
+		return 0;
+	}
+	inputFileName = argv[i];
+	outputFileName = argv[i+1];
+
+	if(!readTokens(inputFileName))
+	{
+		fprintf(stderr,"cass-kc: Kernel file not found !!\n");
+		return 1;
+	}
+	statements = parseBlock(false);
+	endLabel = newLabel();
+	genStatements(statements);
+	emit(IR_LABEL,NO_REG,NO_REG,0,endLabel);
+	emit(OP_HLT,NO_REG,NO_REG,0,-1);
+
+	pinMemoryRegister();
+	spills = allocateRegisters(registerLimit);
+	if(spills)
+	{
+		//Operands of an instruction which are spilled are loaded into scratch registers
+		if(registerLimit <= SCRATCH_REGS)
+		{
+			fprintf(stderr,"cass-kc: Kernel needs spilling, which keeps %d scratch registers, --registers must be more than %d\n",SCRATCH_REGS,SCRATCH_REGS);
+			return 1;
+		}
+		spills = allocateRegisters(registerLimit-SCRATCH_REGS);
+		for(i=0;i<SCRATCH_REGS;i++)
+			scratch[i] = registerLimit-SCRATCH_REGS+i;
+		if(spillBase+spills-1 > 0xFFFF)
+		{
+			fprintf(stderr,"cass-kc: %d spill slots from %04XH go beyond 16 bit address space\n",spills,spillBase);
+			return 1;
+		}
+	}
+
+	fileOut = strcmp(outputFileName,"-") ? fopen(outputFileName,"wb") : stdout;
+	if(!fileOut)
+	{
+		fprintf(stderr,"cass-kc: Output file \"%s\" could not be written\n",outputFileName);
+		return 1;
+	}
+	writeProgram(fileOut,inputFileName);
+	fileReport = fileOut == stdout ? stderr : stdout;
+	if(fileOut != stdout)
+		fclose(fileOut);
+	if(verbosFlag)
+	{
+		for(i=0;i<(int)vregName.size();i++)
+		{
+			if(vregName[i].empty())
+				continue;
+			if(physical[i] != NO_REG)
+				fprintf(fileReport,"%s -> %s\n",vregName[i].c_str(),registerName[physical[i]]);
+			else if(spillSlot[i] != -1)
+				fprintf(fileReport,"%s -> spilled to %04XH\n",vregName[i].c_str(),spillSlot[i]);
+		}
+		fprintf(fileReport,"Spilled values: %d\n",spills);
+	}
+	if(fileOut != stdout)
+		printf("Output successfully written to file \"%s\" \n",outputFileName);
+	return 0;
+}
+
+
+/**
+ *Function to read all tokens of a kernel into "tokens"
+ *Numbers are decimal, or hexadecimal with H at the end like addresses of cass. ';' and '#' start a comment
+ *@param 	const char* fileName			//Name of kernel file, "-" for stdin
+ *@return false if file could not be read
+ */
+bool readTokens(const char * fileName)
+{
+	static const char * const pairs[] = {"==", "!=", "<=", ">="};
+	FILE *fileIn;
+	string text;
+	char buffer[4096];
+	size_t count,i=0,start;
+	int line=1,k;
+	token t;
+	char *end;
+
+	fileIn = strcmp(fileName,"-") ? fopen(fileName,"rb") : stdin;
+	if(!fileIn)
+		return false;
+	while((count = fread(buffer,1,sizeof(buffer),fileIn)) > 0)
+		text.append(buffer,count);
+	if(fileIn != stdin)
+		fclose(fileIn);
+
+	while(i < text.size())
+	{
+		if(text[i] == '\n')
+			line++;
+		if(isspace((unsigned char)text[i]))
+		{
+			i++;
+			continue;
+		}
+		if(text[i] == ';' || text[i] == '#')
+		{
+			while(i < text.size() && text[i] != '\n')
+				i++;
+			continue;
+		}
+		t.line = line;
+		t.value = 0;
+		start = i;
+		if(isalnum((unsigned char)text[i]) || text[i] == '_')
+		{
+			while(i < text.size() && (isalnum((unsigned char)text[i]) || text[i] == '_'))
+				i++;
+			t.text = text.substr(start,i-start);
+			t.kind = isdigit((unsigned char)text[start]) ? T_NUMBER : T_NAME;
+			if(t.kind == T_NUMBER)
+			{
+				if(toupper(t.text[t.text.size()-1]) == 'H')
+					t.value = strtoll(t.text.substr(0,t.text.size()-1).c_str(),&end,16);
+				else
+					t.value = strtoll(t.text.c_str(),&end,10);
+				if(*end != '\0' || t.value > 0xFFFFFFFFLL)
+				{
+					fprintf(stderr,"cass-kc: Error at line number : %d\n Invalid number \"%s\"\n",line,t.text.c_str());
+					exit(1);
+				}
+			}
+		}
+		else
+		{
+			t.kind = T_SYMBOL;
+			t.text = text.substr(i,1);
+			for(k=0;k<4;k++)
+				if(!text.compare(i,2,pairs[k]))
+					t.text = pairs[k];
+			if(!strchr("=+-*/%~()[]{},<>",text[i]) && t.text.size() == 1)
+			{
+				fprintf(stderr,"cass-kc: Error at line number : %d\n Invalid character '%c'\n",line,text[i]);
+				exit(1);
+			}
+			i += t.text.size();
+		}
+		tokens.push_back(t);
+	}
+	t.kind = T_END;
+	t.text = "end of file";
+	t.line = line;
+	tokens.push_back(t);
+	return true;
+}
+
+
+/**
+ *Function to report an error at current token and stop
+ *@param 	const char* message 			//What was expected
+ *@return void
+ */
+void syntaxError(const char * message)
+{
+	fprintf(stderr,"cass-kc: Error at line number : %d\n %s, found \"%s\"\n",tokens[tokenIndex].line,message,tokens[tokenIndex].text.c_str());
+	exit(1);
+}
+
+
+/**
+ *Function to check if current token is a symbol or keyword
+ *@param 	const char* text 				//Symbol or keyword
+ *@return true if it is
+ */
+bool isSymbol(const char * text)
+{
+	return tokens[tokenIndex].kind != T_END && tokens[tokenIndex].kind != T_NUMBER && tokens[tokenIndex].text == text;
+}
+
+
+/**
+ *Function to read a symbol or keyword which must be present
+ *@param 	const char* text 				//Symbol or keyword
+ *@return void
+ */
+void expectSymbol(const char * text)
+{
+	char message[64];
+	if(!isSymbol(text))
+	{
+		snprintf(message,sizeof(message),"Expected \"%s\"",text);
+		syntaxError(message);
+	}
+	tokenIndex++;
+}
+
+
+/**
+ *Function to parse statements upto "}" or end of kernel
+ *@param 	bool isInner 					//Block is inside "{", closing "}" is read
+ *@return Statements
+ */
+vector<node *> parseBlock(bool isInner)
+{
+	vector<node *> statements;
+	if(isInner)
+		expectSymbol("{");
+	while(!isSymbol("}") && tokens[tokenIndex].kind != T_END)
+		statements.push_back(parseStatement());
+	if(isInner)
+		expectSymbol("}");
+	else if(tokens[tokenIndex].kind != T_END)
+		syntaxError("Unexpected \"}\"");
+	return statements;
+}
+
+
+/**
+ *Function to parse a statement
+ *name = expression, mem[expression] = expression, repeat expression {...}, while condition {...},
+ *if condition {...} else {...}, out port, expression and halt
+ *@return Parsed statement
+ */
+node * parseStatement(void)
+{
+	node *statement;
+	int line = tokens[tokenIndex].line;
+
+	if(isSymbol("repeat"))
+	{
+		tokenIndex++;
+		statement = newNode(N_REPEAT,parseExpression(),NULL);
+		statement->body = parseBlock(true);
+	}
+	else if(isSymbol("while"))
+	{
+		tokenIndex++;
+		statement = newNode(N_WHILE,parseCondition(),NULL);
+		statement->body = parseBlock(true);
+	}
+	else if(isSymbol("if"))
+	{
+		tokenIndex++;
+		statement = newNode(N_IF,parseCondition(),NULL);
+		statement->body = parseBlock(true);
+		if(isSymbol("else"))
+		{
+			tokenIndex++;
+			if(isSymbol("if"))
+				statement->elseBody.push_back(parseStatement());
+			else
+				statement->elseBody = parseBlock(true);
+		}
+	}
+	else if(isSymbol("out"))
+	{
+		tokenIndex++;
+		if(tokens[tokenIndex].kind != T_NUMBER)
+			syntaxError("Expected port number");
+		statement = newNode(N_OUTPUT,NULL,NULL);
+		statement->value = tokens[tokenIndex++].value;
+		expectSymbol(",");
+		statement->left = parseExpression();
+	}
+	else if(isSymbol("halt"))
+	{
+		tokenIndex++;
+		statement = newNode(N_HALT,NULL,NULL);
+	}
+	else if(isSymbol("mem"))
+	{
+		tokenIndex++;
+		expectSymbol("[");
+		statement = newNode(N_STORE,parseExpression(),NULL);
+		expectSymbol("]");
+		expectSymbol("=");
+		statement->right = parseExpression();
+	}
+	else if(tokens[tokenIndex].kind == T_NAME)
+	{
+		statement = newNode(N_ASSIGN,NULL,NULL);
+		statement->vreg = variableOf(tokens[tokenIndex++].text);
+		expectSymbol("=");
+		statement->left = parseExpression();
+	}
+	else
+		syntaxError("Expected a statement");
+	statement->line = line;
+	return statement;
+}
+
+
+/**
+ *Function to parse condition of while and if, an expression or two compared by a relation
+ *Relations < > <= >= compare unsigned values
+ *@return Parsed condition
+ */
+node * parseCondition(void)
+{
+	static const char * const relationName[] = {"", "==", "!=", "<", ">", "<=", ">="};
+	node *condition = newNode(N_COMPARE,parseExpression(),NULL);
+	int r;
+
+	condition->value = REL_NONE;
+	for(r=REL_EQ;r<=REL_GE;r++)
+		if(isSymbol(relationName[r]))
+		{
+			tokenIndex++;
+			condition->value = r;
+			condition->right = parseExpression();
+			break;
+		}
+	return condition;
+}
+
+
+/**
+ *Functions to parse expressions, + - below * / %, below unary - ~, below operands
+ *Operations on two numbers are folded, / and % are signed like DIV and MOD
+ */
+node * parseExpression(void)
+{
+	node *left = parseTerm();
+	while(isSymbol("+") || isSymbol("-"))
+	{
+		left = newNode(N_BINARY,left,NULL);
+		left->value = tokens[tokenIndex++].text[0];
+		left->right = parseTerm();
+	}
+	return left;
+}
+
+node * parseTerm(void)
+{
+	node *left = parseUnary();
+	while(isSymbol("*") || isSymbol("/") || isSymbol("%"))
+	{
+		left = newNode(N_BINARY,left,NULL);
+		left->value = tokens[tokenIndex++].text[0];
+		left->right = parseUnary();
+	}
+	return left;
+}
+
+node * parseUnary(void)
+{
+	if(isSymbol("-"))
+	{
+		tokenIndex++;
+		return newNode(N_NEGATE,parseUnary(),NULL);
+	}
+	if(isSymbol("~"))
+	{
+		tokenIndex++;
+		return newNode(N_COMPLEMENT,parseUnary(),NULL);
+	}
+	return parsePrimary();
+}
+
+node * parsePrimary(void)
+{
+	node *operand;
+	if(tokens[tokenIndex].kind == T_NUMBER)
+	{
+		operand = newNode(N_NUMBER,NULL,NULL);
+		operand->value = tokens[tokenIndex++].value;
+	}
+	else if(isSymbol("("))
+	{
+		tokenIndex++;
+		operand = parseExpression();
+		expectSymbol(")");
+	}
+	else if(isSymbol("mem"))
+	{
+		tokenIndex++;
+		expectSymbol("[");
+		operand = newNode(N_MEMORY,parseExpression(),NULL);
+		expectSymbol("]");
+	}
+	else if(isSymbol("in"))
+	{
+		tokenIndex++;
+		expectSymbol("(");
+		if(tokens[tokenIndex].kind != T_NUMBER)
+			syntaxError("Expected port number");
+		operand = newNode(N_INPUT,NULL,NULL);
+		operand->value = tokens[tokenIndex++].value;
+		expectSymbol(")");
+	}
+	else if(tokens[tokenIndex].kind == T_NAME)
+	{
+		operand = newNode(N_VARIABLE,NULL,NULL);
+		operand->vreg = variableOf(tokens[tokenIndex++].text);
+	}
+	else
+		syntaxError("Expected an operand");
+	return operand;
+}
+
+
+/**
+ *Function to make a node, operations on numbers are folded into a number
+ *@param 	int kind 						//Kind of node (N_XXX)
+ *@param 	node* left 						//First operand
+ *@param 	node* right 					//Second operand
+ *@return New node
+ */
+node * newNode(int kind, node * left, node * right)
+{
+	node *n = new node();
+	unsigned int a;
+
+	n->kind = kind;
+	n->value = 0;
+	n->vreg = NO_REG;
+	n->line = tokens[tokenIndex].line;
+	n->left = left;
+	n->right = right;
+	if((kind == N_NEGATE || kind == N_COMPLEMENT) && left->kind == N_NUMBER)
+	{
+		a = (unsigned int)left->value;
+		n->kind = N_NUMBER;
+		n->value = kind == N_NEGATE ? 0u - a : ~a;
+	}
+	return n;
+}
+
+
+/**
+ *Function to find virtual register of a variable, making it on first use
+ *Variables which are read before they are written start at 0
+ *@param 	string& name 					//Name of variable
+ *@return Virtual register
+ */
+int variableOf(const string & name)
+{
+	static const char * const keywords[] = {"mem", "repeat", "while", "if", "else", "out", "in", "halt"};
+	map<string,int>::iterator found = variableIndex.find(name);
+	int k;
+
+	if(found != variableIndex.end())
+		return found->second;
+	for(k=0;k<8;k++)
+		if(name == keywords[k])
+			syntaxError("Keyword used as a variable");
+	if(name.size() >= NAME_SIZE)
+		syntaxError("Name of variable is too long");
+	vregName.push_back(name);
+	variableIndex[name] = vregName.size()-1;
+	return vregName.size()-1;
+}
+
+
+/**
+ *Function to make a virtual register for a temporary value
+ *@return Virtual register
+ */
+int newTemporary(void)
+{
+	vregName.push_back(string());
+	return vregName.size()-1;
+}
+
+
+/**
+ *Function to make a new label
+ *@return Label
+ */
+int newLabel(void)
+{
+	return labelCount++;
+}
+
+
+/**
+ *Function to append an instruction on virtual registers to "program"
+ *@param 	int op 							//Operation (OP_XXX, IR_LABEL or IR_LOAD)
+ *@param 	int reg1 						//First virtual register
+ *@param 	int reg2 						//Second virtual register
+ *@param 	long long imm 					//Address, data or port
+ *@param 	int label 						//Label
+ *@return void
+ */
+void emit(int op, int reg1, int reg2, long long imm, int label)
+{
+	irOp ins;
+	ins.op = op;
+	ins.reg1 = reg1;
+	ins.reg2 = reg2;
+	ins.imm = imm;
+	ins.label = label;
+	program.push_back(ins);
+}
+
+
+/**
+ *Function to check if an expression reads a virtual register
+ *@param 	node* n 						//Expression
+ *@param 	int vreg 						//Virtual register
+ *@return true if it does
+ */
+bool references(const node * n, int vreg)
+{
+	if(!n)
+		return false;
+	if(n->kind == N_VARIABLE)
+		return n->vreg == vreg;
+	return references(n->left,vreg) || references(n->right,vreg);
+}
+
+
+/**
+ *Function to check if an expression reads a port, such operands are evaluated in order of source
+ *@param 	node* n 						//Expression
+ *@return true if it does
+ */
+bool readsPort(const node * n)
+{
+	if(!n)
+		return false;
+	if(n->kind == N_INPUT)
+		return true;
+	return readsPort(n->left) || readsPort(n->right);
+}
+
+
+/**
+ *Function to write instructions of statements
+ *@param 	vector<node*>& statements 		//Statements
+ *@return void
+ */
+void genStatements(const vector<node *> & statements)
+{
+	node *s;
+	int i,count,top,bottom,address,value;
+
+	for(i=0;i<(int)statements.size();i++)
+	{
+		s = statements[i];
+		switch(s->kind)
+		{
+			case N_ASSIGN :
+				genInto(s->left,s->vreg);
+				break;
+			case N_STORE :
+				if(s->left->kind == N_NUMBER && s->left->value <= 0xFFFF)
+					emit(OP_STR,genValue(s->right),NO_REG,s->left->value,-1);
+				else
+				{
+					address = genValue(s->left);
+					value = genValue(s->right);
+					emit(OP_STI,value,address,0,-1);
+				}
+				break;
+			case N_OUTPUT :
+				emit(OP_OUT,genValue(s->left),NO_REG,s->value,-1);
+				break;
+			case N_HALT :
+				emit(OP_JUM,NO_REG,NO_REG,0,endLabel);			//cass stops reading at first HLT
+				break;
+			case N_REPEAT :
+				//LOP keeps its own count, register of count is free inside the loop
+				count = genValue(s->left);
+				top = newLabel();
+				bottom = newLabel();
+				emit(OP_LOP,count,NO_REG,0,bottom);
+				emit(IR_LABEL,NO_REG,NO_REG,0,top);
+				genStatements(s->body);
+				emit(OP_ELP,NO_REG,NO_REG,0,top);
+				emit(IR_LABEL,NO_REG,NO_REG,0,bottom);
+				break;
+			case N_WHILE :
+				top = newLabel();
+				bottom = newLabel();
+				emit(IR_LABEL,NO_REG,NO_REG,0,top);
+				genCondition(s->left,bottom);
+				genStatements(s->body);
+				emit(OP_JUM,NO_REG,NO_REG,0,top);
+				emit(IR_LABEL,NO_REG,NO_REG,0,bottom);
+				break;
+			case N_IF :
+				top = newLabel();
+				genCondition(s->left,top);
+				genStatements(s->body);
+				if(s->elseBody.empty())
+				{
+					emit(IR_LABEL,NO_REG,NO_REG,0,top);
+					break;
+				}
+				bottom = newLabel();
+				emit(OP_JUM,NO_REG,NO_REG,0,bottom);
+				emit(IR_LABEL,NO_REG,NO_REG,0,top);
+				genStatements(s->elseBody);
+				emit(IR_LABEL,NO_REG,NO_REG,0,bottom);
+				break;
+		}
+	}
+}
+
+
+/**
+ *Function to write instructions which leave value of an expression in a virtual register
+ *Operations are two address, so the first operand is computed into destination itself
+ *@param 	node* n 						//Expression
+ *@param 	int dest 						//Virtual register of result
+ *@return void
+ */
+void genInto(node * n, int dest)
+{
+	static const int aluOp[] = {'+', OP_ADD, '-', OP_SUB, '*', OP_MUL, '/', OP_DIV, '%', OP_MOD};
+	node *left,*right,*swap;
+	int k,temporary;
+
+	switch(n->kind)
+	{
+		case N_NUMBER :
+			emit(OP_MOI,dest,NO_REG,n->value,-1);
+			break;
+		case N_VARIABLE :
+			if(n->vreg != dest)
+				emit(OP_MVR,dest,n->vreg,0,-1);
+			break;
+		case N_MEMORY :
+			if(n->left->kind == N_NUMBER && n->left->value <= 0xFFFF)
+				emit(OP_LDR,dest,NO_REG,n->left->value,-1);
+			else
+				emit(IR_LOAD,dest,genValue(n->left),0,-1);
+			break;
+		case N_INPUT :
+			emit(OP_INP,dest,NO_REG,n->value,-1);
+			break;
+		case N_NEGATE :
+			genInto(n->left,dest);
+			emit(OP_NOT,dest,NO_REG,0,-1);
+			emit(OP_INC,dest,NO_REG,0,-1);
+			break;
+		case N_COMPLEMENT :
+			genInto(n->left,dest);
+			emit(OP_NOT,dest,NO_REG,0,-1);
+			break;
+		case N_BINARY :
+			left = n->left;
+			right = n->right;
+			if((n->value == '+' || n->value == '*') && references(right,dest) && !references(left,dest)
+				&& !(readsPort(left) && readsPort(right)))
+			{
+				swap = left;
+				left = right;
+				right = swap;
+			}
+			if(references(right,dest))
+			{
+				//Computing first operand into destination would lose its old value
+				temporary = newTemporary();
+				genInto(n,temporary);
+				emit(OP_MVR,dest,temporary,0,-1);
+				break;
+			}
+			genInto(left,dest);
+			if(right->kind == N_NUMBER && right->value == 1 && (n->value == '+' || n->value == '-'))
+			{
+				emit(n->value == '+' ? OP_INC : OP_DEC,dest,NO_REG,0,-1);
+				break;
+			}
+			for(k=0;aluOp[k] != n->value;k+=2)
+				;
+			emit(aluOp[k+1],dest,genValue(right),0,-1);
+			break;
+	}
+}
+
+
+/**
+ *Function to find virtual register holding value of an expression
+ *@param 	node* n 						//Expression
+ *@return Virtual register of variable, or of a temporary holding the value
+ */
+int genValue(node * n)
+{
+	int temporary;
+	if(n->kind == N_VARIABLE)
+		return n->vreg;
+	temporary = newTemporary();
+	genInto(n,temporary);
+	return temporary;
+}
+
+
+/**
+ *Function to write instructions of a condition, which fall through when it holds
+ *== and != test difference with JZR, < and >= test borrow of SUB with JMC
+ *@param 	node* c 						//Condition
+ *@param 	int falseLabel 					//Label where control goes when condition does not hold
+ *@return void
+ */
+void genCondition(node * c, int falseLabel)
+{
+	node *left = c->left,*right = c->right,first;
+	int rel = c->value,difference,trueLabel;
+
+	if(rel == REL_GT || rel == REL_LE)
+	{
+		left = c->right;
+		right = c->left;
+		if(readsPort(left) && readsPort(right))
+		{
+			//Operands are swapped, the one first in source is read into a temporary before the other
+			first = *right;
+			first.kind = N_VARIABLE;
+			first.vreg = genValue(right);
+			first.left = first.right = NULL;
+			right = &first;
+		}
+		rel = rel == REL_GT ? REL_LT : REL_GE;
+	}
+	if(rel == REL_NONE || ((rel == REL_EQ || rel == REL_NE) && right->kind == N_NUMBER && right->value == 0))
+		difference = genValue(left);
+	else
+	{
+		difference = newTemporary();
+		genInto(left,difference);
+		if(right->kind == N_NUMBER && right->value == 1 && (rel == REL_EQ || rel == REL_NE))
+			emit(OP_DEC,difference,NO_REG,0,-1);
+		else
+			emit(OP_SUB,difference,genValue(right),0,-1);
+	}
+	if(rel == REL_NONE || rel == REL_NE)
+		emit(OP_JZR,difference,NO_REG,0,falseLabel);
+	else if(rel == REL_GE)
+		emit(OP_JMC,NO_REG,NO_REG,0,falseLabel);
+	else
+	{
+		trueLabel = newLabel();
+		emit(rel == REL_EQ ? OP_JZR : OP_JMC,rel == REL_EQ ? difference : NO_REG,NO_REG,0,trueLabel);
+		emit(OP_JUM,NO_REG,NO_REG,0,falseLabel);
+		emit(IR_LABEL,NO_REG,NO_REG,0,trueLabel);
+	}
+}
+
+
+/**
+ *Function to find virtual registers read by an instruction
+ *@param 	irOp* ins 						//Instruction
+ *@param 	int* uses 						//Virtual registers read, upto 2
+ *@return Number of virtual registers read
+ */
+int irUses(const irOp * ins, int * uses)
+{
+	int count=0;
+	switch(ins->op)
+	{
+		case OP_ADD : case OP_SUB : case OP_MUL : case OP_DIV : case OP_MOD : case OP_STI :
+			uses[count++] = ins->reg1;
+			uses[count++] = ins->reg2;
+			break;
+		case OP_STR : case OP_NOT : case OP_INC : case OP_DEC : case OP_LOP : case OP_JZR : case OP_OUT :
+			uses[count++] = ins->reg1;
+			break;
+		case OP_MVR : case IR_LOAD :
+			uses[count++] = ins->reg2;
+			break;
+	}
+	return count;
+}
+
+
+/**
+ *Function to find virtual register written by an instruction
+ *@param 	irOp* ins 						//Instruction
+ *@return Virtual register, NO_REG if none
+ */
+int irDef(const irOp * ins)
+{
+	switch(ins->op)
+	{
+		case OP_LDR : case OP_MOI : case OP_MVR : case OP_ADD : case OP_SUB : case OP_MUL :
+		case OP_DIV : case OP_MOD : case OP_NOT : case OP_INC : case OP_DEC : case OP_INP : case IR_LOAD :
+			return ins->reg1;
+	}
+	return NO_REG;
+}
+
+
+/**
+ *Function to choose a virtual register to live in ME, address of every load is then already in ME
+ *It is the only address of loads, or of stores when kernel has no load. As MVR with ME reads
+ *or writes memory, it must never be copied by MVR
+ *@return void
+ */
+void pinMemoryRegister(void)
+{
+	int loadAddress=NO_REG,storeAddress=NO_REG,candidate;
+	bool isLoadUnique=true,isStoreUnique=true;
+	size_t i;
+
+	for(i=0;i<program.size();i++)
+	{
+		if(program[i].op == IR_LOAD)
+		{
+			isLoadUnique = isLoadUnique && (loadAddress == NO_REG || loadAddress == program[i].reg2);
+			loadAddress = program[i].reg2;
+		}
+		else if(program[i].op == OP_STI)
+		{
+			isStoreUnique = isStoreUnique && (storeAddress == NO_REG || storeAddress == program[i].reg2);
+			storeAddress = program[i].reg2;
+		}
+	}
+	if(loadAddress != NO_REG)
+		candidate = isLoadUnique ? loadAddress : NO_REG;
+	else
+		candidate = isStoreUnique ? storeAddress : NO_REG;
+	if(candidate == NO_REG)
+		return;
+	for(i=0;i<program.size();i++)
+		if((program[i].op == OP_MVR && (program[i].reg1 == candidate || program[i].reg2 == candidate))
+			|| (program[i].op == IR_LOAD && program[i].reg1 == candidate))
+			return;
+	pinnedVreg = candidate;
+}
+
+
+/**
+ *Function to give registers to virtual registers by linear scan
+ *Live ranges come from liveness over jumps and loops; a range ending where another starts
+ *with a write can share its register. When registers run out the range ending last is spilled
+ *@param 	int available 					//Registers given, from A
+ *@return Number of spilled virtual registers
+ */
+int allocateRegisters(int available)
+{
+	int n = program.size(),vregs = vregName.size(),words = (vregs+63)/64;
+	vector<unsigned long long> liveIn((size_t)(n+1)*words,0);
+	vector<int> labelAt(labelCount,n),start(vregs,INT_MAX),end(vregs,-1),order,active;
+	vector<bool> isDefinedAtStart(vregs,false),isFree(available,true);
+	int i,j,k,v,uses[2],count,successor[2],successors,def,spills=0,reg;
+	unsigned long long word;
+	bool isChanged=true;
+
+	for(i=0;i<n;i++)
+		if(program[i].op == IR_LABEL)
+			labelAt[program[i].label] = i;
+
+	//Liveness, liveIn[n] stays empty
+	while(isChanged)
+	{
+		isChanged = false;
+		for(i=n-1;i>=0;i--)
+		{
+			const irOp *ins = &program[i];
+			successors = 0;
+			if(ins->op == OP_JUM)
+				successor[successors++] = labelAt[ins->label];
+			else if(ins->op != OP_HLT)
+			{
+				successor[successors++] = i+1;
+				if(ins->op == OP_JZR || ins->op == OP_JMC || ins->op == OP_LOP || ins->op == OP_ELP)
+					successor[successors++] = labelAt[ins->label];
+			}
+			def = irDef(ins);
+			count = irUses(ins,uses);
+			for(j=0;j<words;j++)
+			{
+				word = 0;
+				for(k=0;k<successors;k++)
+					word |= liveIn[(size_t)successor[k]*words+j];
+				if(def != NO_REG && def/64 == j)
+					word &= ~(1ULL<<(def%64));
+				for(k=0;k<count;k++)
+					if(uses[k]/64 == j)
+						word |= 1ULL<<(uses[k]%64);
+				if(word != liveIn[(size_t)i*words+j])
+				{
+					liveIn[(size_t)i*words+j] = word;
+					isChanged = true;
+				}
+			}
+		}
+	}
+
+	//Ranges cover every position where a virtual register is live or written
+	for(i=0;i<n;i++)
+	{
+		for(v=0;v<vregs;v++)
+			if(liveIn[(size_t)i*words+v/64]>>(v%64) & 1)
+			{
+				start[v] = min(start[v],i);
+				end[v] = max(end[v],i);
+			}
+		def = irDef(&program[i]);
+		if(def != NO_REG && i < start[def])
+		{
+			start[def] = i;
+			isDefinedAtStart[def] = true;
+		}
+		if(def != NO_REG)
+			end[def] = max(end[def],i);
+	}
+
+	physical.assign(vregs,NO_REG);
+	spillSlot.assign(vregs,-1);
+	for(v=0;v<vregs;v++)
+		if(end[v] >= 0 && v != pinnedVreg)
+			order.push_back(v);
+	stable_sort(order.begin(),order.end(),[&start](int a, int b) { return start[a] < start[b]; });
+	if(pinnedVreg != NO_REG)
+		physical[pinnedVreg] = REG_ME;
+
+	for(i=0;i<(int)order.size();i++)
+	{
+		v = order[i];
+		//Active ranges are kept in order of their end
+		for(j=0;j<(int)active.size() && (end[active[j]] < start[v] || (end[active[j]] == start[v] && isDefinedAtStart[v]));)
+		{
+			isFree[physical[active[j]]] = true;
+			active.erase(active.begin()+j);
+		}
+		for(reg=0;reg<available && !isFree[reg];reg++)
+			;
+		if(reg == available)
+		{
+			k = active.back();
+			if(end[k] <= end[v])
+			{
+				spillSlot[v] = spillBase + spills++;
+				continue;
+			}
+			reg = physical[k];
+			physical[k] = NO_REG;
+			spillSlot[k] = spillBase + spills++;
+			active.pop_back();
+		}
+		physical[v] = reg;
+		isFree[reg] = false;
+		for(j=active.size();j>0 && end[active[j-1]] > end[v];j--)
+			;
+		active.insert(active.begin()+j,v);
+	}
+	return spills;
+}
+
+
+/**
+ *Function to write source of cass for the allocated program
+ *Spilled operands are loaded into scratch registers before and stored after their instruction
+ *@param 	FILE* fileOut 					//Output file
+ *@param 	const char* kernelName 			//Name of kernel file
+ *@return void
+ */
+void writeProgram(FILE * fileOut, const char * kernelName)
+{
+	vector<bool> isTarget(labelCount,false);
+	int reg[2],slot[2],i,k,def;
+	const irOp *ins;
+	const char *r1,*r2;
+
+	for(i=0;i<(int)program.size();i++)
+		if(program[i].op == OP_JUM || program[i].op == OP_JZR || program[i].op == OP_JMC)
+			isTarget[program[i].label] = true;
+
+	//Lines of cass are short, only the name of kernel without its directory is written
+	if(strrchr(kernelName,'/'))
+		kernelName = strrchr(kernelName,'/')+1;
+	fprintf(fileOut,";cass-kc %.*s\r\nSTART\r\n",INPUT_WIDTH-10,kernelName);
+	for(i=0;i<(int)program.size();i++)
+	{
+		ins = &program[i];
+		if(ins->op == IR_LABEL)
+		{
+			if(isTarget[ins->label])
+				fprintf(fileOut,"L%d\r\n",ins->label);
+			continue;
+		}
+		for(k=0;k<2;k++)
+		{
+			int v = k ? ins->reg2 : ins->reg1;
+			reg[k] = v == NO_REG ? 0 : physical[v];
+			slot[k] = v == NO_REG || physical[v] != NO_REG ? -1 : spillSlot[v];
+			if(slot[k] != -1)
+				reg[k] = scratch[k];
+		}
+		//Spilled operands which are read are loaded first
+		int uses[2],count = irUses(ins,uses);
+		for(k=0;k<count;k++)
+		{
+			int which = uses[k] == ins->reg1 && (k == 0 || ins->reg1 != ins->reg2) ? 0 : 1;
+			if(slot[which] != -1)
+				fprintf(fileOut," LDR %s,%04XH\r\n",registerName[reg[which]],slot[which]);
+		}
+		r1 = registerName[reg[0]];
+		r2 = registerName[reg[1]];
+		switch(ins->op)
+		{
+			case OP_LDR : case OP_STR :
+				fprintf(fileOut," %s %s,%04XH\r\n",mneumonicName[ins->op],r1,(int)ins->imm);
+				break;
+			case OP_MOI :
+				if(ins->imm >= 0 && ins->imm <= 0xFFFF)
+					fprintf(fileOut," MAI %s,%04XH\r\n",r1,(int)ins->imm);		//One word instead of two
+				else
+					fprintf(fileOut," MOI %s,%d\r\n",r1,(int)(unsigned int)ins->imm);
+				break;
+			case OP_MVR :
+				if(reg[0] != reg[1])
+					fprintf(fileOut," MVR %s,%s\r\n",r1,r2);
+				break;
+			case OP_ADD : case OP_SUB : case OP_MUL : case OP_DIV : case OP_MOD : case OP_STI :
+				fprintf(fileOut," %s %s,%s\r\n",mneumonicName[ins->op],r1,r2);
+				break;
+			case OP_NOT : case OP_INC : case OP_DEC : case OP_LOP :
+				fprintf(fileOut," %s %s\r\n",mneumonicName[ins->op],r1);
+				break;
+			case OP_OUT : case OP_INP :
+				fprintf(fileOut," %s %s,%lld\r\n",mneumonicName[ins->op],r1,ins->imm);
+				break;
+			case OP_JZR :
+				fprintf(fileOut," JZR %s,L%d\r\n",r1,ins->label);
+				break;
+			case OP_JUM : case OP_JMC :
+				fprintf(fileOut," %s L%d\r\n",mneumonicName[ins->op],ins->label);
+				break;
+			case OP_ELP : case OP_HLT :
+				fprintf(fileOut," %s\r\n",mneumonicName[ins->op]);
+				break;
+			case IR_LOAD :
+				if(reg[1] != REG_ME)
+				{
+					fprintf(fileOut," MAI ME,0000H\r\n ADD ME,%s\r\n",r2);
+				}
+				fprintf(fileOut," MVR %s,ME\r\n",r1);
+				break;
+		}
+		def = irDef(ins);
+		if(def != NO_REG && slot[0] != -1)
+			fprintf(fileOut," STR %s,%04XH\r\n",r1,slot[0]);
+	}
+}
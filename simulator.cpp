@@ -0,0 +1,3788 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-SIM : Functional simulator for programs assembled by cass							****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Executes the '0'/'1' images written by cass. Every word is decoded once into
+ *				a compact op holding the address of its handler and the interpreter
+ *				dispatches with computed goto, so no bits are parsed while running
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<cctype>
+#include<climits>
+#include<fstream>
+#include<iostream>
+#include<chrono>
+#include<vector>
+#include<cstddef>
+#include<algorithm>
+#include<thread>
+#include<atomic>
+#include<mutex>
+#include<deque>
+#include<map>
+#include "isa.h"
+#include "symbols.h"
+#include "trace.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define HAS_JIT 1
+#include<sys/mman.h>
+#endif
+
+/**
+ *Macros
+ */
+#define NUMBER_OF_REG 28				//Specifies total number of Registers
+#define MAX_LOOP_DEPTH 256				//Specifies max number of nested LOP/ELP loops while running
+#define ADDRESS_MASK 0xFFFF				//Memory has 64K words, addressed by 16 bits
+#define UNLIMITED (~0ULL)				//Step limit of a run which is not limited
+#define PAGE_SHIFT 8					//Memory is tracked for checkpoints in pages of 256 words
+#define PAGE_WORDS (1<<PAGE_SHIFT)
+#define MEMORY_PAGES (MAX_IMAGE_WORDS/PAGE_WORDS)
+#define MAX_CHECKPOINTS 1024			//Every other checkpoint is dropped and interval doubled beyond this
+#define TRACE_RING_SIZE (1<<16)			//Specifies records buffered between simulator and trace writer
+#define LANES 8							//Specifies number of instances run in lockstep by one group
+#define FARM_SLICE 1000000				//Specifies instructions run by farm between checks of time limit
+#define MAX_PORTS 256					//Specifies number of ports of OUT and INP, each way
+#define PORT_BUFFER 4096				//Specifies words moved between a port and its file at a time
+#define PORT_TEXT 65536					//Specifies characters of text input read at a time
+#define COVERAGE_WORDS 1028			//Specifies 64 bit words of a coverage bitmap, whole 256 bit vectors
+#define COVERAGE_NONE (MAX_IMAGE_WORDS+1)	//Index of "previous instruction" before the first one
+#define TIMING_FLAGS NUMBER_OF_REG		//Slot of scoreboard for flags, after registers
+#define TIMING_NONE (NUMBER_OF_REG+1)	//Slot read by ops without a source, never written
+#define TIMING_SINK (NUMBER_OF_REG+2)	//Slot written by ops without a result, never read
+#define TIMING_SLOTS (NUMBER_OF_REG+3)
+#define PROFILE_TOP 20					//Specifies number of addresses in flat profile without -v
+#define JIT_BUFFER_SIZE (16<<20)		//Specifies bytes of executable memory for translated blocks
+#define JIT_MAX_BLOCK 256				//Specifies max number of instructions in a translated block
+#define JIT_BLOCK_RESERVE (64<<10)		//Buffer space which must be free before translating a block
+#define JIT_PINNED 8					//Specifies number of guest registers kept in host registers
+#define JIT_INTERPRET 0x80000000u		//Set in pc returned by translated code to run one instruction in interpreter
+
+using namespace std;
+
+
+/**
+ *Kinds of predecoded ops, operations of the ISA followed by those needed only by simulator
+ */
+enum simKind {
+	K_MVR_LOAD = OP_INVALID+1,			//MVR X,ME reads memory pointed by ME
+	K_MVR_STORE,						//MVR ME,X writes memory pointed by ME
+	K_UNMATCHED,						//LOP or ELP without its pair
+	K_OUTSIDE,							//Control left the program
+	K_COUNT
+};
+
+
+/**
+ *Reasons for which a run stops
+ */
+enum simStatus {
+	SIM_RUNNING,	SIM_HALTED,		SIM_STEP_LIMIT,		SIM_DIVIDE_ERROR,
+	SIM_INVALID,	SIM_OUTSIDE,	SIM_LOOP_ERROR,	SIM_BREAK,
+	SIM_CODE_WRITE,	SIM_TIMEOUT,	SIM_NO_PORT,	SIM_PORT_END
+};
+
+static const char * const statusMessage[] = {
+	"Running",	"Halted",	"Step limit reached",	"Division by zero or overflow",
+	"Invalid instruction",	"Control left the program",	"LOP/ELP not matched or nested too deep",	"Stopped at breakpoint",
+	"Program wrote into itself, not supported in lockstep",	"Time limit reached",	"Port not connected",	"Input port has no more data"
+};
+
+
+/**
+ *Structure to hold a predecoded word
+ *@void* Address of handler in interpreter, filled when run starts
+ *@int Kind of op (OP_XXX or K_XXX)
+ *@unsigned char Register fields
+ *@unsigned int 16 bit address or immediate data of MOI
+ *@int Index of word where a jump lands, after ELP of a LOP and after LOP of an ELP
+ *@bool Run stops before this word when breakpoints are enabled
+ */
+struct simOp {
+	void *handler;
+	int kind;
+	unsigned char r1;
+	unsigned char r2;
+	bool isBreak;
+	unsigned int imm;
+	int target;
+};
+
+typedef struct simOp simOp;
+
+
+/**
+ *Structure to hold execution counts of a machine
+ *@unsigned long long Times instruction at each word was executed
+ *@unsigned long long Times control went elsewhere than the next instruction after each word
+ *@int Word executed last, -1 at start
+ *@int Word following the one executed last
+ */
+struct profileData {
+	unsigned long long hits[MAX_IMAGE_WORDS+2];
+	unsigned long long taken[MAX_IMAGE_WORDS+2];
+	int last;
+	int expected;
+};
+
+typedef struct profileData profileData;
+
+
+/**
+ *Structure to hold a trace being written
+ *Simulator puts records in a ring and a thread takes them out, encodes and writes them,
+ *each side moves only its own counter so no lock is needed
+ */
+struct traceWriter {
+	traceEvent ring[TRACE_RING_SIZE];
+	alignas(64) atomic<unsigned long long> head;	//Records taken by writer thread
+	alignas(64) atomic<unsigned long long> tail;	//Records put by simulator, on its own cache line
+	atomic<bool> isDone;				//Simulator has put its last record
+	unsigned long long cachedHead;		//Value of head last read by simulator
+	traceEvent current;					//Record of instruction being executed, completed at next one
+	bool isPending;
+	FILE *file;
+	const char *fileName;
+	unsigned int regs[NUMBER_OF_REG];	//Registers when trace started
+	thread writer;
+};
+
+typedef struct traceWriter traceWriter;
+
+
+/**
+ *Structure to hold a device connected to a port, backed by a host file or pipe
+ *Words are moved between its buffer and the file PORT_BUFFER at a time, so INP and
+ *OUT make no system call of their own
+ */
+struct portDevice {
+	unsigned int words[PORT_BUFFER];
+	int head;							//Next word taken by INP
+	int count;							//Words in buffer
+	FILE *file;
+	bool isPipe;						//File was opened with popen
+	bool isEnd;							//Input has no more data
+	char text[PORT_TEXT+1];				//Characters of text input, "textStart" is first one not parsed
+	int textStart;
+	int textEnd;
+	unsigned long long transferred;		//Words read or written by program
+	string fileName;
+};
+
+typedef struct portDevice portDevice;
+
+
+/**
+ *Structure to hold devices of every port, NULL where none is connected
+ */
+struct portSet {
+	portDevice *input[MAX_PORTS];
+	portDevice *output[MAX_PORTS];
+};
+
+typedef struct portSet portSet;
+
+
+/**
+ *Structure to hold coverage of runs of one program, one bit for every word
+ *A bit of "taken" is set when control went elsewhere than the next instruction after
+ *that word and a bit of "fallen" when it went to the next instruction
+ */
+struct coverageMap {
+	alignas(32) unsigned long long executed[COVERAGE_WORDS];
+	alignas(32) unsigned long long taken[COVERAGE_WORDS];
+	alignas(32) unsigned long long fallen[COVERAGE_WORDS];
+	int last;							//Word executed last, COVERAGE_NONE at start of a run
+	int expected;						//Word following it
+};
+
+typedef struct coverageMap coverageMap;
+
+
+/**
+ *Classes in which cycles of timing model are counted, order must be same as of array "timingClassName"
+ */
+enum timingClass {
+	T_ISSUE,	T_FILL,		T_BRANCH,	T_JUMP,
+	T_DATA,		T_LOAD,		T_MULDIV,	T_MEMORY,
+	T_COUNT
+};
+
+static const char * const timingClassName[] = {
+	"Issue",	"Pipeline fill",	"Taken branches",	"Jumps",
+	"ALU dependencies",	"Load use",	"Multiply and divide",	"Memory busy"
+};
+
+/**
+ *Units which an op can keep busy for more than one cycle
+ */
+enum timingUnit {
+	UNIT_NONE,	UNIT_MEMORY,	UNIT_DIVIDER,	UNIT_COUNT
+};
+
+
+/**
+ *Structure to hold timing model of an in order pipeline, read from a timing file
+ *An op issues when its sources and its unit are ready, its result is ready "latency"
+ *cycles later and the op after a taken branch or jump issues "penalty" cycles late
+ */
+struct timingModel {
+	int stages;							//Pipeline stages, cycles to fill it at start of run
+	int latency[K_COUNT];				//Cycles from issue of op till its result can be used
+	int busy[K_COUNT];					//Cycles for which op keeps its unit
+	int penalty[K_COUNT];				//Cycles lost when control does not go to the next word after op
+	unsigned char unit[K_COUNT];		//Unit of op (UNIT_XXX)
+	unsigned char producer[K_COUNT];	//Class of stalls waiting for result of op
+	unsigned char redirect[K_COUNT];	//Class of cycles lost by control going elsewhere after op
+};
+
+typedef struct timingModel timingModel;
+
+
+/**
+ *Structure to hold progress of a machine through the timing model
+ *Scoreboard has the cycle in which every register and flags can be read next
+ */
+struct timingState {
+	unsigned long long cycle;			//Cycle in which next op can issue, total cycles at end of run
+	unsigned long long ready[TIMING_SLOTS];
+	unsigned char producer[TIMING_SLOTS];	//Class of op which wrote the slot last
+	unsigned long long unitFree[UNIT_COUNT];
+	unsigned long long cycles[T_COUNT];	//Cycles of every class, their sum is "cycle"
+	int last;							//Kind of op executed last
+	int expected;						//Word following it
+};
+
+typedef struct timingState timingState;
+
+
+/**
+ *Scoreboard slots read and written by every kind of op : two sources, result and flags
+ *FIELD_R1 and FIELD_R2 stand for register fields of op. Every line of isa.def needs its SLOTS_XXX
+ */
+#define FIELD_R1 (-1)
+#define FIELD_R2 (-2)
+#define NO_SRC TIMING_NONE
+#define NO_DST TIMING_SINK
+
+#define SLOTS_LDR		{NO_SRC,NO_SRC,FIELD_R1,NO_DST}
+#define SLOTS_STR		{FIELD_R1,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_MAI		{NO_SRC,NO_SRC,FIELD_R1,NO_DST}
+#define SLOTS_JZR		{FIELD_R1,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_JUM		{NO_SRC,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_JMC		{TIMING_FLAGS,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_JMZ		{TIMING_FLAGS,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_JMP		{TIMING_FLAGS,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_MVR		{FIELD_R2,NO_SRC,FIELD_R1,NO_DST}
+#define SLOTS_ADD		{FIELD_R1,FIELD_R2,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_SUB		{FIELD_R1,FIELD_R2,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_MUL		{FIELD_R1,FIELD_R2,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_DIV		{FIELD_R1,FIELD_R2,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_MOD		{FIELD_R1,FIELD_R2,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_STI		{FIELD_R1,FIELD_R2,NO_DST,NO_DST}
+#define SLOTS_NOT		{FIELD_R1,NO_SRC,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_MOI		{NO_SRC,NO_SRC,FIELD_R1,NO_DST}
+#define SLOTS_INC		{FIELD_R1,NO_SRC,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_DEC		{FIELD_R1,NO_SRC,FIELD_R1,TIMING_FLAGS}
+#define SLOTS_LOP		{FIELD_R1,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_ELP		{NO_SRC,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_HLT		{NO_SRC,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_NOP		{NO_SRC,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_OUT		{FIELD_R1,NO_SRC,NO_DST,NO_DST}
+#define SLOTS_INP		{NO_SRC,NO_SRC,FIELD_R1,NO_DST}
+
+static const signed char timingSlot[K_COUNT][4] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) SLOTS_##name,
+#include "isa.def"
+#undef ISA_OP
+	{NO_SRC,NO_SRC,NO_DST,NO_DST},			//INVALID
+	{REG_ME,NO_SRC,FIELD_R1,NO_DST},		{FIELD_R2,REG_ME,NO_DST,NO_DST},		//MVR_LOAD, MVR_STORE
+	{NO_SRC,NO_SRC,NO_DST,NO_DST},			{NO_SRC,NO_SRC,NO_DST,NO_DST}			//UNMATCHED, OUTSIDE
+};
+
+#undef NO_SRC
+#undef NO_DST
+
+/**
+ *Group of every kind of op in timing model, from isa.def and then of kinds of "simKind"
+ */
+static const char timingGroup[K_COUNT] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) group,
+#include "isa.def"
+#undef ISA_OP
+	'A',	'L',	'S',	'A',	'A'
+};
+
+
+/**
+ *Structure to hold state of a simulated machine
+ *Program is loaded at word 0 of memory, "pc" is index of word being executed
+ *Flags are kept as last arithmetic operation and computed only when read
+ */
+struct machine {
+	unsigned int regs[NUMBER_OF_REG];
+	unsigned int memory[MAX_IMAGE_WORDS];
+	simOp ops[MAX_IMAGE_WORDS+2];
+	int codeWords;
+	int pc;
+	unsigned int loopStack[MAX_LOOP_DEPTH];
+	int loopDepth;
+	int flagOp;
+	unsigned int flagA,flagB,flagResult;
+	unsigned long long steps;
+	unsigned long long codeVersion;		//Incremented whenever program writes into itself
+	bool isLinked;
+	int status;
+	struct jitCache *jit;				//Translated blocks, NULL till JIT is used
+	profileData *profile;				//Execution counts, NULL if not profiling
+	struct traceWriter *trace;			//Trace being written, NULL if not tracing
+	coverageMap *coverage;				//Coverage bitmaps, NULL if not needed
+	timingState *timing;				//Cycles counted by timing model, NULL if not needed
+	portSet *ports;						//Devices of OUT and INP, NULL if none is connected
+	bool isBreaking;					//Stop at words marked as breakpoints
+	bool isResuming;					//Next run goes past the breakpoint machine stands at
+	unsigned char dirtyPages[MEMORY_PAGES];	//Pages written by interpreter since last checkpoint
+};
+
+typedef struct machine machine;
+
+
+/**
+ *Vector of one 32 bit value of every lane, compiled to AVX2 where the host has it
+ */
+typedef unsigned int laneVector __attribute__((vector_size(4*LANES), aligned(4*LANES)));
+
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__unix__)
+#define LANE_CLONES __attribute__((target_clones("avx2","default")))
+#else
+#define LANE_CLONES
+#endif
+
+
+/**
+ *Structure to hold instances of one program run in lockstep
+ *Every register and word of memory holds the value of all lanes side by side, so one
+ *decoded instruction updates all lanes with vector operations. Lanes at different
+ *addresses are masked off and run when the lowest address reaches theirs
+ */
+struct laneGroup {
+	laneVector regs[NUMBER_OF_REG];
+	laneVector memory[MAX_IMAGE_WORDS];
+	laneVector pc;
+	laneVector flagOp;					//Last arithmetic operation of every lane, ~0 for none
+	laneVector flagA,flagB,flagResult;
+	unsigned int loopStack[MAX_LOOP_DEPTH][LANES];
+	int loopDepth[LANES];
+	unsigned long long steps[LANES];
+	int status[LANES];
+	unsigned long long issued;			//Instructions decoded for the group
+	coverageMap *coverage;				//Coverage of group, NULL if not needed
+};
+
+typedef struct laneGroup laneGroup;
+
+
+/**
+ *Structure to hold a program run by the farm and its result
+ *@string Image and memory file, memory is empty if none
+ *@vector Address and expected value of every word checked after run
+ *@unsigned long long Instructions after which program is stopped, 0 for no limit
+ *@double Seconds after which program is stopped, 0 for no limit
+ */
+struct farmJob {
+	string image;
+	string memory;
+	vector<int> checkAddress;
+	vector<unsigned int> checkValue;
+	unsigned long long budget;
+	double timeout;
+	int line;							//Line of farm file
+	int status;							//Result, SIM_RUNNING if image or memory could not be read
+	unsigned long long steps;
+	double seconds;
+	unsigned long long cycles[T_COUNT];	//Cycles of every class counted by timing model
+	string failure;						//Why job failed, empty if it passed
+};
+
+typedef struct farmJob farmJob;
+
+
+/**
+ *Structure to hold a worker of the farm
+ *Owner takes jobs from back of its queue, idle workers steal from front
+ */
+struct farmWorker {
+	deque<int> queue;
+	mutex lock;
+	machine *arena;						//Machine reused for every job of this worker
+	map<string, coverageMap *> coverage;	//Coverage of every image run by this worker
+	int done;
+	int stolen;
+};
+
+typedef struct farmWorker farmWorker;
+
+
+/**
+ *Structure to hold a page of memory shared by checkpoints
+ *@int Number of checkpoints holding the page
+ *@unsigned int Words of page
+ */
+struct memoryPage {
+	int references;
+	unsigned int words[PAGE_WORDS];
+};
+
+typedef struct memoryPage memoryPage;
+
+
+/**
+ *Structure to hold state of a machine at some step
+ *Pages not written since previous checkpoint are shared with it
+ */
+struct checkpoint {
+	unsigned long long steps;
+	unsigned int regs[NUMBER_OF_REG];
+	int pc;
+	unsigned int loopStack[MAX_LOOP_DEPTH];
+	int loopDepth;
+	int flagOp;
+	unsigned int flagA,flagB,flagResult;
+	int status;
+	memoryPage *pages[MEMORY_PAGES];
+};
+
+typedef struct checkpoint checkpoint;
+
+
+/**
+ *Global Variables
+ */
+int verbosFlag=0;
+int jitFlag=0;							//Run translated native code instead of interpreter
+int diffTestFlag=0;						//Run JIT and interpreter side by side and compare them
+unsigned long long maxSteps=0;			//Instructions after which run stops, 0 for no limit
+const char *profileFileName=NULL;		//Execution counts are written here in format read by cass --profile
+const char *traceFileName=NULL;			//Binary trace of every instruction is written here
+const char *farmFileName=NULL;			//File listing programs run by the farm, with their inputs and expected results
+int farmThreads=0;						//Workers of farm, 0 for one per core
+double farmTimeout=0;					//Default seconds after which a farm job is stopped
+const char *coverageFileName=NULL;		//Coverage of runs is written here in lcov format
+int timingFlag=0;						//Count cycles with timing model
+portSet devices;						//Devices connected to ports by --in and --out
+int rawPortsFlag=0;						//Port files hold 32 bit little endian words instead of decimal text
+timingModel timing;						//Timing model, defaults or read from timing file
+const char *lockstepFileName=NULL;		//File naming a memory file on every line, one lockstep instance each
+int debugFlag=0;						//Read debugger commands from stdin
+unsigned long long checkpointInterval=1000000;		//Steps between checkpoints taken while debugging
+vector<checkpoint *> checkpoints;		//Checkpoints in order of steps, first one is at step 0
+
+
+/**
+ *Function declarations
+ */
+machine * createMachine(void);
+bool loadImage(machine * , const char * );
+bool loadMemory(machine * , const char * );
+void decodeSlot(machine * , int );
+void matchLoops(machine * );
+unsigned int currentFlags(const machine * );
+int run(machine * , unsigned long long );
+void startTrace(machine * , const char * );
+void runGroup(laneGroup * , const machine * , unsigned long long );
+int runLockstep(const machine * , const char * , const char * , int , int );
+void resetMachine(machine * );
+coverageMap * createCoverage(void);
+void mergeCoverage(coverageMap * , const coverageMap * );
+void writeCoverage(const char * , const vector<string> & , const vector<coverageMap *> & );
+bool readTiming(const char * , timingModel * );
+timingState * createTiming(void);
+void resetTiming(timingState * );
+void printTiming(const unsigned long long * , unsigned long long );
+bool openPort(const char * , bool );
+bool fillPort(portDevice * );
+void flushPort(portDevice * );
+void closePorts(portSet * );
+bool readFarm(const char * , vector<farmJob> & );
+void runFarmJob(machine * , farmJob * );
+int runFarm(const char * );
+void stopTrace(machine * );
+void printState(const machine * , bool );
+int runJit(machine * , bool );
+void writeProfile(const machine * , const char * );
+void printProfile(const machine * , const debugInfo * );
+void takeCheckpoint(machine * );
+void restoreCheckpoint(machine * , int );
+int advance(machine * , unsigned long long , bool );
+void reverseStep(machine * , unsigned long long );
+bool reverseContinue(machine * );
+void debugMachine(machine * , const debugInfo * );
+bool compareMachines(const machine * , const machine * , int );
+int diffTest(const char * , const char * );
+
+
+/**
+ *Accepting command line arguments for image and memory files
+ */
+int main(int argc, char const *argv[])
+{
+	int i,j,dumpAddress=-1,dumpCount=1;
+	const char *memoryFileName=NULL,*symbolFileName=NULL;
+	string defaultSymbols;
+	debugInfo symbols;
+	machine *m;
+	double seconds;
+
+	if(argc < 2)
+	{
+		printf("cass-sim: Usage: %s [options] image_file\nFor help use %s --help\n",argv[0],argv[0]);
+		return 0;
+	}
+	if(!strcmp(argv[1],"--help"))
+	{
+		printf("\n\t\tcass-sim: Usage: %s [options] image_file\n\t\t[options]\t-v \t Print all registers at the end\n",argv[0]);
+		printf("\t\t\t\t--max-steps=N \t Stop after N instructions\n\t\t\t\t--memory=FILE \t Initial memory, \"address value\" on every line\n");
+		printf("\t\t\t\t--dump=ADDR[:COUNT] \t Print COUNT words of memory from ADDR at the end\n");
+		printf("\t\t\t\t--jit \t Translate blocks into x86-64 code, interpreter is used with --max-steps\n\t\t\t\t--diff-test \t Run JIT and interpreter block by block and compare their state\n\t\t\t\t--profile=FILE \t Count executions of every address, report them and write them to FILE\n\t\t\t\t--trace=FILE \t Write compressed binary trace of every instruction, read it with cass-trace\n\t\t\t\t--lockstep=LIST \t Run one instance for every memory file named in LIST, %d at a time with SIMD\n\t\t\t\t--farm=FILE \t Run every program listed in FILE on a pool of threads and check results\n\t\t\t\t--threads=N \t Workers of --farm (default one per core)\n\t\t\t\t--timeout=SECONDS \t Time limit of every --farm program\n\t\t\t\t--coverage=FILE \t Write instruction and branch coverage of run, --lockstep or --farm in lcov format\n\t\t\t\t--timing[=FILE] \t Count cycles and stalls with pipeline model read from FILE (default 5 stages)\n\t\t\t\t--in=PORT:FILE \t INP from PORT reads FILE, \"-\" for stdin, \"|command\" for a pipe\n\t\t\t\t--out=PORT:FILE \t OUT to PORT writes FILE, \"-\" for stdout, \"|command\" for a pipe\n\t\t\t\t--raw-ports \t Port files hold 32 bit little endian words instead of decimal text\n\t\t\t\t--symbols=FILE \t Symbol file written by cass -g (default image_file.sym)\n\t\t\t\t--debug \t Read debugger commands from stdin, with reverse-step and reverse-continue\n\t\t\t\t--checkpoint-interval=N \t Steps between checkpoints while debugging (default 1000000)\n\t\t\t\t--help \t For help and sample usage\n\n",LANES);
+		printf("\t\tAddresses are in hexadecimal (2048H), values in decimal\n\t\tSample Usage:\n\t\t%s --memory=input.mem --dump=5000H factorial.out\n\n",argv[0]);
+		return 0;
+	}
+
+	for(i=1;i<argc && argv[i][0] == '-' && argv[i][1] != '\0';i++)		//Reading options, "-" is image from stdin
+	{
+		if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(!strncmp(argv[i],"--max-steps=",12))
+			maxSteps = strtoull(argv[i]+12,NULL,10);
+		else if(!strcmp(argv[i],"--jit"))
+			jitFlag=1;
+		else if(!strcmp(argv[i],"--diff-test"))
+			diffTestFlag=1;
+		else if(!strncmp(argv[i],"--profile=",10))
+			profileFileName = argv[i]+10;
+		else if(!strncmp(argv[i],"--coverage=",11))
+			coverageFileName = argv[i]+11;
+		else if(!strcmp(argv[i],"--timing") || !strncmp(argv[i],"--timing=",9))
+		{
+			timingFlag=1;
+			if(!readTiming(argv[i][8] ? argv[i]+9 : NULL,&timing))
+				return 1;
+		}
+		else if(!strncmp(argv[i],"--in=",5) || !strncmp(argv[i],"--out=",6))
+		{
+			if(!openPort(strchr(argv[i],'=')+1,argv[i][2] == 'o'))
+				return 1;
+		}
+		else if(!strcmp(argv[i],"--raw-ports"))
+			rawPortsFlag=1;
+		else if(!strncmp(argv[i],"--farm=",7))
+			farmFileName = argv[i]+7;
+		else if(!strncmp(argv[i],"--threads=",10))
+			farmThreads = atoi(argv[i]+10);
+		else if(!strncmp(argv[i],"--timeout=",10))
+			farmTimeout = atof(argv[i]+10);
+		else if(!strncmp(argv[i],"--lockstep=",11))
+			lockstepFileName = argv[i]+11;
+		else if(!strncmp(argv[i],"--trace=",8))
+			traceFileName = argv[i]+8;
+		else if(!strncmp(argv[i],"--symbols=",10))
+			symbolFileName = argv[i]+10;
+		else if(!strcmp(argv[i],"--debug"))
+			debugFlag=1;
+		else if(!strncmp(argv[i],"--checkpoint-interval=",22))
+		{
+			checkpointInterval = strtoull(argv[i]+22,NULL,10);
+			if(!checkpointInterval)
+				checkpointInterval = 1;
+		}
+		else if(!strncmp(argv[i],"--memory=",9))
+			memoryFileName = argv[i]+9;
+		else if(!strncmp(argv[i],"--dump=",7))
+		{
+			dumpAddress = strtol(argv[i]+7,NULL,16) & ADDRESS_MASK;
+			if(strchr(argv[i],':'))
+				dumpCount = atoi(strchr(argv[i],':')+1);
+		}
+		else
+		{
+			fprintf(stderr,"cass-sim: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+	if(farmFileName && i == argc)
+		return runFarm(farmFileName);
+	if(i != argc-1)
+	{
+		printf("cass-sim: Usage: %s [options] image_file\nFor help use %s --help\n",argv[0],argv[0]);
+		return 0;
+	}
+
+	if(!strcmp(argv[i],"-"))
+	{
+		for(j=0;j<MAX_PORTS && !(devices.input[j] && devices.input[j]->file == stdin);j++)
+			;
+		if(diffTestFlag || j < MAX_PORTS)
+		{
+			fprintf(stderr,"cass-sim: Image \"-\" can not be used with --diff-test or an input port reading stdin\n");
+			return 1;
+		}
+	}
+	if(diffTestFlag)
+		return diffTest(argv[i],memoryFileName);
+	m = createMachine();
+	if(!loadImage(m,argv[i]) || (memoryFileName && !loadMemory(m,memoryFileName)))
+		return 1;
+	if((profileFileName || traceFileName || coverageFileName || timingFlag) && debugFlag)
+	{
+		fprintf(stderr,"cass-sim: --profile, --trace, --coverage and --timing can not be used with --debug, replays would be counted\n");
+		return 1;
+	}
+	m->ports = &devices;
+	if(debugFlag || lockstepFileName)
+		m->ports = NULL;					//Replays and lanes would share the ports
+	if(timingFlag && lockstepFileName)
+	{
+		fprintf(stderr,"cass-sim: --timing can not be used with --lockstep\n");
+		return 1;
+	}
+	if(profileFileName)
+	{
+		m->profile = (profileData *)calloc(1,sizeof(profileData));
+		if(!m->profile)
+		{
+			fprintf(stderr,"cass-sim: Out of memory\n");
+			return 1;
+		}
+		m->profile->last = -1;
+	}
+	if(profileFileName || debugFlag)
+	{
+		if(!symbolFileName)
+		{
+			defaultSymbols = string(argv[i]) + ".sym";
+			symbolFileName = defaultSymbols.c_str();
+		}
+		if(!readSymbols(symbolFileName,&symbols,m->codeWords) && symbolFileName != defaultSymbols.c_str())
+		{
+			fprintf(stderr,"cass-sim: Symbol file \"%s\" not found !!\n",symbolFileName);
+			return 1;
+		}
+	}
+	if(debugFlag)
+	{
+		debugMachine(m,&symbols);
+		return 0;
+	}
+	if(lockstepFileName)
+		return runLockstep(m,argv[i],lockstepFileName,dumpAddress,dumpCount);
+	if(traceFileName)
+		startTrace(m,traceFileName);
+	if(coverageFileName)
+		m->coverage = createCoverage();
+	if(timingFlag)
+		m->timing = createTiming();
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(jitFlag && !maxSteps && !profileFileName && !traceFileName && !coverageFileName && !timingFlag)		//Translated blocks can not stop in between
+		runJit(m,false);
+	else
+		run(m,maxSteps);
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if(traceFileName)
+		stopTrace(m);
+	closePorts(&devices);
+
+	if(m->status != SIM_HALTED && m->status != SIM_STEP_LIMIT && m->status != SIM_PORT_END)
+		fprintf(stderr,"cass-sim: %s at address %d\n",statusMessage[m->status],m->pc*4);
+	printf("%s after %llu instructions in %.3f seconds (%.1f MIPS)\n",statusMessage[m->status],m->steps,seconds,
+		seconds > 0 ? m->steps/seconds/1e6 : 0.0);
+	printState(m,verbosFlag);
+	if(timingFlag)
+		printTiming(m->timing->cycles,m->steps);
+	if(profileFileName)
+	{
+		writeProfile(m,profileFileName);
+		printProfile(m,&symbols);
+	}
+	if(coverageFileName)
+		writeCoverage(coverageFileName,vector<string>(1,argv[i]),vector<coverageMap *>(1,m->coverage));
+	for(i=0;i<dumpCount && dumpAddress >= 0;i++)
+		printf("%04XH : %d\n",(dumpAddress+i) & ADDRESS_MASK,(int)m->memory[(dumpAddress+i) & ADDRESS_MASK]);
+	return m->status == SIM_HALTED || m->status == SIM_STEP_LIMIT || m->status == SIM_PORT_END ? 0 : 1;
+}
+
+
+/**
+ *Function to create a machine with all registers and memory cleared
+ *@return Pointer to machine
+ */
+machine * createMachine(void)
+{
+	machine *m = (machine *)calloc(1,sizeof(machine));
+	if(!m)
+	{
+		fprintf(stderr,"cass-sim: Out of memory\n");
+		exit(1);
+	}
+	m->flagOp = -1;
+	return m;
+}
+
+
+/**
+ *Function to load an image written by cass at word 0 of memory and predecode it
+ *@param 	machine* m 						//Machine
+ *@param 	const char* fileName			//Name of image file, "-" for stdin
+ *@return false if image could not be read
+ */
+bool loadImage(machine * m, const char * fileName)
+{
+	ifstream fileIn;
+	int i;
+
+	if(!strcmp(fileName,"-"))
+		m->codeWords = readImage(cin,m->memory,MAX_IMAGE_WORDS);		//Image ends at end of stdin
+	else
+	{
+		fileIn.open(fileName,ios::in);
+		if(!fileIn)
+		{
+			fprintf(stderr,"cass-sim: Image file \"%s\" not found !!\n",fileName);
+			return false;
+		}
+		m->codeWords = readImage(fileIn,m->memory,MAX_IMAGE_WORDS);
+	}
+	if(m->codeWords < 0)
+	{
+		fprintf(stderr,"cass-sim: \"%s\" is not an image written by cass\n",fileName);
+		return false;
+	}
+	for(i=0;i<m->codeWords;i++)
+		decodeSlot(m,i);
+	m->ops[m->codeWords].kind = m->ops[m->codeWords+1].kind = K_OUTSIDE;
+	matchLoops(m);
+	m->pc = 0;
+	m->isLinked = false;
+	return true;
+}
+
+
+/**
+ *Function to fill memory from a file
+ *Every line contains an address in hexadecimal and a value in decimal
+ *Content after ';' is treated as comment
+ *@param 	machine* m 						//Machine
+ *@param 	const char* fileName			//Name of memory file
+ *@return false if file could not be read
+ */
+bool loadMemory(machine * m, const char * fileName)
+{
+	FILE *fileMemory;
+	char line[100];
+	unsigned int address;
+	long long value;
+	int lineNumber=0;
+
+	fileMemory = fopen(fileName,"r");
+	if(!fileMemory)
+	{
+		fprintf(stderr,"cass-sim: Memory file \"%s\" not found !!\n",fileName);
+		return false;
+	}
+	while(fgets(line,sizeof(line),fileMemory))
+	{
+		lineNumber++;
+		line[strcspn(line,";\r\n")] = '\0';
+		if(strspn(line," \t") == strlen(line))
+			continue;
+		if(sscanf(line,"%x%*[hH] %lld",&address,&value) != 2 && sscanf(line,"%x %lld",&address,&value) != 2)
+		{
+			fprintf(stderr,"cass-sim: Error at line number %d of memory file\n",lineNumber);
+			fclose(fileMemory);
+			return false;
+		}
+		m->memory[address & ADDRESS_MASK] = (unsigned int)value;
+		if((int)(address & ADDRESS_MASK) < m->codeWords)
+		{
+			decodeSlot(m,address & ADDRESS_MASK);
+			matchLoops(m);
+		}
+	}
+	fclose(fileMemory);
+	return true;
+}
+
+
+/**
+ *Function to predecode a word of the program
+ *Every word is decoded on its own, so a word following MOI is decoded as well but is
+ *only executed if a jump lands on it
+ *@param 	machine* m 						//Machine
+ *@param 	int index 						//Index of word
+ *@return void
+ */
+void decodeSlot(machine * m, int index)
+{
+	instruction ins;
+	simOp *op = &m->ops[index];
+
+	op->kind = decodeWord(m->memory[index],&ins);
+	op->r1 = ins.reg1 == -1 ? 0 : ins.reg1;
+	op->r2 = ins.reg2 == -1 ? 0 : ins.reg2;
+	op->imm = ins.addr == -1 ? 0 : ins.addr;
+	op->target = m->codeWords;
+	if(instructionSize(ins.op) == 8)			//Data of MOI, port of OUT and INP
+		op->imm = index+1 < m->codeWords ? m->memory[index+1] : 0;
+	else if(ins.op == OP_MVR && ins.reg1 == REG_ME)
+		op->kind = ins.reg2 == REG_ME ? (int)OP_NOP : (int)K_MVR_STORE;		//MVR ME,ME copies a word onto itself
+	else if(ins.op == OP_MVR && ins.reg2 == REG_ME)
+		op->kind = K_MVR_LOAD;
+	else if(isJump(ins.op) && ins.addr % 4 == 0 && ins.addr/4 < m->codeWords)
+		op->target = ins.addr/4;
+	if(index > 0 && instructionSize(m->ops[index-1].kind) == 8)
+		m->ops[index-1].imm = m->memory[index];
+	m->isLinked = false;
+}
+
+
+/**
+ *Function to pair every LOP with its ELP, words following MOI are skipped
+ *LOP jumps after its ELP when count is zero, ELP jumps after its LOP to repeat
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+void matchLoops(machine * m)
+{
+	static thread_local int stack[MAX_IMAGE_WORDS];
+	int i,top=0;
+	simOp *ops = m->ops;
+
+	for(i=0;i<m->codeWords;i++)
+		if(ops[i].kind == K_UNMATCHED)
+			decodeSlot(m,i);
+	for(i=0;i<m->codeWords;i += instructionSize(ops[i].kind)/4)
+	{
+		if(ops[i].kind == OP_LOP)
+			stack[top++] = i;
+		else if(ops[i].kind == OP_ELP)
+		{
+			if(top == 0)
+			{
+				ops[i].kind = K_UNMATCHED;
+				continue;
+			}
+			top--;
+			ops[i].target = stack[top]+1;
+			ops[stack[top]].target = i+1;
+		}
+	}
+	while(top)
+		ops[stack[--top]].kind = K_UNMATCHED;
+	m->isLinked = false;
+}
+
+
+/**
+ *Function to compute flag register from last arithmetic operation
+ *@param 	machine* m 						//Machine
+ *@return Flag register value
+ */
+unsigned int currentFlags(const machine * m)
+{
+	if(m->flagOp == -1)
+		return 0;
+	return aluFlags(m->flagOp,m->flagA,m->flagB,m->flagResult);
+}
+
+
+/**
+ *Function to start record of an instruction about to be executed
+ *Register written and memory accessed are found from the op, their values are read
+ *when the record is completed
+ *@param 	traceWriter* trace 				//Trace
+ *@param 	simOp* op 						//Op about to be executed
+ *@param 	int index 						//Index of its word
+ *@param 	unsigned int* regs 				//Registers
+ *@param 	unsigned int* memory 			//Memory
+ *@return void
+ */
+static inline void beginTraceEvent(traceWriter * trace, const simOp * op, int index, const unsigned int * regs, const unsigned int * memory)
+{
+	traceEvent *event = &trace->current;
+
+	event->pc = index;
+	event->word = memory[index & ADDRESS_MASK];
+	event->reg = TRACE_NO_REG;
+	event->memory = 0;
+	switch(op->kind)
+	{
+		case OP_LDR:
+			event->memory = TRACE_READ;
+			event->address = op->imm;
+			break;
+		case OP_STR:
+			event->memory = TRACE_WRITE;
+			event->address = op->imm;
+			break;
+		case OP_STI:
+			event->memory = TRACE_WRITE;
+			event->address = regs[op->r2] & ADDRESS_MASK;
+			break;
+		case K_MVR_LOAD:
+			event->memory = TRACE_READ;
+			event->address = regs[REG_ME] & ADDRESS_MASK;
+			break;
+		case K_MVR_STORE:
+			event->memory = TRACE_WRITE;
+			event->address = regs[REG_ME] & ADDRESS_MASK;
+			break;
+	}
+	if(op->kind == OP_LDR || op->kind == OP_MAI || op->kind == OP_MVR || op->kind == OP_MOI || op->kind == OP_INP || op->kind == K_MVR_LOAD || isAlu(op->kind))
+		event->reg = op->r1;
+	trace->isPending = true;
+}
+
+
+/**
+ *Function to complete record of instruction executed last and put it in the ring
+ *Waits while the ring is full
+ *@param 	traceWriter* trace 				//Trace
+ *@param 	unsigned int* regs 				//Registers
+ *@param 	unsigned int* memory 			//Memory
+ *@return void
+ */
+static inline void finishTraceEvent(traceWriter * trace, const unsigned int * regs, const unsigned int * memory)
+{
+	unsigned long long tail = trace->tail.load(memory_order_relaxed);
+
+	if(trace->current.reg != TRACE_NO_REG)
+		trace->current.regValue = regs[trace->current.reg];
+	if(trace->current.memory)
+		trace->current.value = memory[trace->current.address];
+	while(tail - trace->cachedHead == TRACE_RING_SIZE)
+	{
+		trace->cachedHead = trace->head.load(memory_order_acquire);
+		if(tail - trace->cachedHead == TRACE_RING_SIZE)
+			this_thread::yield();
+	}
+	trace->ring[tail & (TRACE_RING_SIZE-1)] = trace->current;
+	trace->tail.store(tail+1,memory_order_release);
+	trace->isPending = false;
+}
+
+
+/**
+ *Function to count cycles of an op in timing model, before it is executed
+ *Op issues in the cycle when its sources and its unit are free, stalls are counted in the
+ *class of what it waited for. Cycles lost by a taken branch are counted at the op after it
+ *@param 	timingState* clock 				//Timing state
+ *@param 	simOp* op 						//Op
+ *@param 	int index 						//Word of op
+ *@param 	int kind 						//Kind of op, a constant where it is inlined
+ *@return void
+ */
+static inline __attribute__((always_inline)) void timeOp(timingState * clock, const simOp * op, int index, int kind)
+{
+	const signed char *slot = timingSlot[kind];
+	int source1 = slot[0] == FIELD_R1 ? op->r1 : slot[0] == FIELD_R2 ? op->r2 : slot[0];
+	int source2 = slot[1] == FIELD_R1 ? op->r1 : slot[1] == FIELD_R2 ? op->r2 : slot[1];
+	int result = slot[2] == FIELD_R1 ? op->r1 : slot[2];
+	int unit = timing.unit[kind];
+	unsigned long long issue,cycle = clock->cycle;
+
+	if(index != clock->expected)
+	{
+		clock->cycles[timing.redirect[clock->last]] += timing.penalty[clock->last];
+		cycle += timing.penalty[clock->last];
+	}
+	issue = max(max(cycle,clock->unitFree[unit]),max(clock->ready[source1],clock->ready[source2]));
+	if(issue != cycle)
+	{
+		if(clock->ready[source1] == issue)
+			clock->cycles[clock->producer[source1]] += issue - cycle;
+		else if(clock->ready[source2] == issue)
+			clock->cycles[clock->producer[source2]] += issue - cycle;
+		else
+			clock->cycles[unit == UNIT_MEMORY ? T_MEMORY : T_MULDIV] += issue - cycle;
+	}
+	if(unit != UNIT_NONE)
+		clock->unitFree[unit] = issue + timing.busy[kind];
+	clock->ready[result] = issue + timing.latency[kind];
+	clock->producer[result] = timing.producer[kind];
+	if(slot[3] != TIMING_SINK)
+	{
+		clock->ready[TIMING_FLAGS] = issue + timing.latency[kind];
+		clock->producer[TIMING_FLAGS] = timing.producer[kind];
+	}
+	clock->cycles[T_ISSUE]++;
+	clock->cycle = issue + 1;
+	clock->last = kind;
+	clock->expected = index + instructionSize(kind)/4;
+}
+
+
+/**
+ *Function to run a machine till it halts, fails or executes given number of instructions
+ *Handlers are reached by computed goto through the address stored in every op
+ *@param 	machine* m 						//Machine
+ *@param 	unsigned long long limit 		//Max number of instructions to execute, 0 for no limit
+ *@return Status of machine (SIM_XXX)
+ */
+int run(machine * m, unsigned long long limit)
+{
+	//Handler do<mneumonic> of every line of isa.def, then of kinds of "simKind"
+	static void * const handlers[K_COUNT] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) &&do##name,
+#include "isa.def"
+#undef ISA_OP
+		&&doINVALID,
+		&&doMVR_LOAD,	&&doMVR_STORE,	&&doUNMATCHED,	&&doOUTSIDE
+	};
+	//With timing model every op first goes through the one of these for its kind
+	static void * const timedHandlers[K_COUNT] = {
+#define ISA_OP(name,operands,opcode,size,latency,group) &&time##name,
+#include "isa.def"
+#undef ISA_OP
+		&&timeINVALID,
+		&&timeMVR_LOAD,	&&timeMVR_STORE,	&&timeUNMATCHED,	&&timeOUTSIDE
+	};
+	profileData *profile = m->profile;
+	traceWriter *trace = m->trace;
+	coverageMap *coverage = m->coverage;
+	timingState *clock = m->timing;
+	portSet *ports = m->ports;
+	portDevice *device;
+	simOp *ops = m->ops;
+	const simOp *ip;
+	unsigned int *regs = m->regs,*memory = m->memory;
+	unsigned int a,b,address,flagA = m->flagA,flagB = m->flagB,flagResult = m->flagResult;
+	unsigned char *dirtyPages = m->dirtyPages;
+	unsigned long long steps = m->steps,end,startSteps = m->steps;
+	int i,flagOp = m->flagOp,oldKind,index,last;
+	unsigned long long isNext;
+	bool isResuming = m->isResuming;
+
+	m->isResuming = false;				//Only first slice of a continue starts at the breakpoint
+
+//When profiling every op goes through "doProfile" which then jumps to its handler
+#define LINK(i) (ops[i].handler = ops[i].isBreak && m->isBreaking ? &&doBreak : profile ? &&doProfile : trace ? &&doTrace \
+	: coverage ? &&doCover : clock ? timedHandlers[ops[i].kind] : handlers[ops[i].kind])
+
+	if(!m->isLinked)
+	{
+		for(i=0;i<m->codeWords+2;i++)
+			LINK(i);
+		m->isLinked = true;
+	}
+	end = limit ? steps + limit : UNLIMITED;
+	m->status = SIM_RUNNING;
+	ip = &ops[m->pc];
+
+//Every handler ends by moving "ip" and jumping to handler of the next op
+#define DISPATCH() do { if(steps == end) { m->status = SIM_STEP_LIMIT; goto stop; } steps++; goto *ip->handler; } while(0)
+#define NEXT(size) do { ip += size; DISPATCH(); } while(0)
+#define JUMP(index) do { ip = &ops[index]; DISPATCH(); } while(0)
+#define SET_FLAGS(op,x,y,result) do { flagOp = op; flagA = x; flagB = y; flagResult = result; } while(0)
+#define FLAGS() aluFlags(flagOp,flagA,flagB,flagResult)
+#define CHECK_CODE(address) do { if((int)(address) < m->codeWords) goto modifyCode; } while(0)
+
+	DISPATCH();
+
+doBreak:
+	if(!isResuming || steps-1 != startSteps)	//Run resumed from a breakpoint goes past it
+	{
+		steps--;
+		m->status = SIM_BREAK;
+		goto stop;
+	}
+	if(profile)
+		goto doProfile;
+	if(trace)
+		goto doTrace;
+	if(coverage)
+		goto doCover;
+	if(clock)
+		goto *timedHandlers[ip->kind];
+	goto *handlers[ip->kind];
+doProfile:
+	index = ip - ops;
+	profile->hits[index]++;
+	if(index != profile->expected && profile->last >= 0)
+		profile->taken[profile->last]++;
+	profile->last = index;
+	profile->expected = index + instructionSize(ip->kind)/4;
+	if(trace)
+		goto doTrace;
+	if(coverage)
+		goto doCover;
+	if(clock)
+		goto *timedHandlers[ip->kind];
+	goto *handlers[ip->kind];
+doTrace:
+	if(trace->isPending)
+		finishTraceEvent(trace,regs,memory);
+	beginTraceEvent(trace,ip,ip - ops,regs,memory);
+	if(coverage)
+		goto doCover;
+	if(clock)
+		goto *timedHandlers[ip->kind];
+	goto *handlers[ip->kind];
+doCover:										//Bits are set without branching on their values
+	index = ip - ops;
+	last = coverage->last;
+	isNext = index == coverage->expected;
+	coverage->fallen[last >> 6] |= isNext << (last & 63);
+	coverage->taken[last >> 6] |= (isNext ^ 1) << (last & 63);
+	coverage->executed[index >> 6] |= 1ULL << (index & 63);
+	coverage->last = index;
+	coverage->expected = index + instructionSize(ip->kind)/4;
+	if(clock)
+		goto *timedHandlers[ip->kind];
+	goto *handlers[ip->kind];
+
+//Kind is a constant in every copy of timeOp, so its scoreboard slots are known when compiling
+#define TIMED(kind,name) time##name: timeOp(clock,ip,ip - ops,kind); goto do##name;
+#define ISA_OP(name,operands,opcode,size,latency,group) TIMED(OP_##name,name)
+#include "isa.def"
+#undef ISA_OP
+	TIMED(OP_INVALID,INVALID)
+	TIMED(K_MVR_LOAD,MVR_LOAD)	TIMED(K_MVR_STORE,MVR_STORE)	TIMED(K_UNMATCHED,UNMATCHED)	TIMED(K_OUTSIDE,OUTSIDE)
+#undef TIMED
+
+doLDR:
+	regs[ip->r1] = memory[ip->imm];
+	NEXT(1);
+doSTR:
+	address = ip->imm;
+	memory[address] = regs[ip->r1];
+	dirtyPages[address >> PAGE_SHIFT] = 1;
+	CHECK_CODE(address);
+	NEXT(1);
+doMAI:
+	regs[ip->r1] = ip->imm;
+	NEXT(1);
+doJZR:
+	if(regs[ip->r1] == 0)
+		JUMP(ip->target);
+	NEXT(1);
+doJUM:
+	JUMP(ip->target);
+doJMC:
+	if(flagOp != -1 && (FLAGS() & FLAG_C))
+		JUMP(ip->target);
+	NEXT(1);
+doJMZ:
+	if(flagOp != -1 && flagResult == 0)
+		JUMP(ip->target);
+	NEXT(1);
+doJMP:
+	if(flagOp != -1 && (FLAGS() & FLAG_P))
+		JUMP(ip->target);
+	NEXT(1);
+doMVR:
+	regs[ip->r1] = regs[ip->r2];
+	NEXT(1);
+doMVR_LOAD:
+	regs[ip->r1] = memory[regs[REG_ME] & ADDRESS_MASK];
+	NEXT(1);
+doMVR_STORE:
+	address = regs[REG_ME] & ADDRESS_MASK;
+	memory[address] = regs[ip->r2];
+	dirtyPages[address >> PAGE_SHIFT] = 1;
+	CHECK_CODE(address);
+	NEXT(1);
+doADD:
+	a = regs[ip->r1];
+	b = regs[ip->r2];
+	regs[ip->r1] = a + b;
+	SET_FLAGS(OP_ADD,a,b,a + b);
+	NEXT(1);
+doSUB:
+	a = regs[ip->r1];
+	b = regs[ip->r2];
+	regs[ip->r1] = a - b;
+	SET_FLAGS(OP_SUB,a,b,a - b);
+	NEXT(1);
+doMUL:
+	a = regs[ip->r1];
+	b = regs[ip->r2];
+	regs[ip->r1] = a * b;
+	SET_FLAGS(OP_MUL,a,b,a * b);
+	NEXT(1);
+doDIV:
+	a = regs[ip->r1];
+	b = regs[ip->r2];
+	if(b == 0 || (a == 0x80000000u && b == 0xFFFFFFFFu))
+	{
+		m->status = SIM_DIVIDE_ERROR;
+		goto stop;
+	}
+	regs[ip->r1] = (unsigned int)((int)a / (int)b);
+	SET_FLAGS(OP_DIV,a,b,regs[ip->r1]);
+	NEXT(1);
+doMOD:
+	a = regs[ip->r1];
+	b = regs[ip->r2];
+	if(b == 0 || (a == 0x80000000u && b == 0xFFFFFFFFu))
+	{
+		m->status = SIM_DIVIDE_ERROR;
+		goto stop;
+	}
+	regs[ip->r1] = (unsigned int)((int)a % (int)b);
+	SET_FLAGS(OP_MOD,a,b,regs[ip->r1]);
+	NEXT(1);
+doSTI:
+	address = regs[ip->r2] & ADDRESS_MASK;
+	memory[address] = regs[ip->r1];
+	dirtyPages[address >> PAGE_SHIFT] = 1;
+	CHECK_CODE(address);
+	NEXT(1);
+doNOT:
+	a = regs[ip->r1];
+	regs[ip->r1] = ~a;
+	SET_FLAGS(OP_NOT,a,0,~a);
+	NEXT(1);
+doMOI:
+	regs[ip->r1] = ip->imm;
+	NEXT(2);
+doINC:
+	a = regs[ip->r1];
+	regs[ip->r1] = a + 1;
+	SET_FLAGS(OP_INC,a,1,a + 1);
+	NEXT(1);
+doDEC:
+	a = regs[ip->r1];
+	regs[ip->r1] = a - 1;
+	SET_FLAGS(OP_DEC,a,1,a - 1);
+	NEXT(1);
+doLOP:
+	if(regs[ip->r1] == 0)						//Zero count skips the body
+		JUMP(ip->target);
+	if(m->loopDepth == MAX_LOOP_DEPTH)
+	{
+		m->status = SIM_LOOP_ERROR;
+		goto stop;
+	}
+	m->loopStack[m->loopDepth++] = regs[ip->r1];
+	NEXT(1);
+doELP:
+	if(m->loopDepth == 0)
+	{
+		m->status = SIM_LOOP_ERROR;
+		goto stop;
+	}
+	if(--m->loopStack[m->loopDepth-1])
+		JUMP(ip->target);
+	m->loopDepth--;
+	NEXT(1);
+doNOP:
+	NEXT(1);
+doOUT:
+	if(!ports || ip->imm >= MAX_PORTS || !(device = ports->output[ip->imm]))
+	{
+		m->status = SIM_NO_PORT;
+		goto stop;
+	}
+	device->words[device->count++] = regs[ip->r1];
+	if(device->count == PORT_BUFFER)
+		flushPort(device);
+	NEXT(2);
+doINP:
+	if(!ports || ip->imm >= MAX_PORTS || !(device = ports->input[ip->imm]))
+	{
+		m->status = SIM_NO_PORT;
+		goto stop;
+	}
+	if(device->head == device->count && !fillPort(device))
+	{
+		m->status = SIM_PORT_END;
+		goto stop;
+	}
+	regs[ip->r1] = device->words[device->head++];
+	NEXT(2);
+doHLT:
+	m->status = SIM_HALTED;
+	goto stop;
+doINVALID:
+	m->status = SIM_INVALID;
+	goto stop;
+doUNMATCHED:
+	m->status = SIM_LOOP_ERROR;
+	goto stop;
+doOUTSIDE:
+	m->status = SIM_OUTSIDE;
+	goto stop;
+
+//Program wrote into itself, word is decoded again before going on
+modifyCode:
+	m->codeVersion++;
+	oldKind = ops[address].kind;
+	decodeSlot(m,address);
+	if(oldKind == OP_LOP || oldKind == OP_ELP || oldKind == K_UNMATCHED
+		|| ops[address].kind == OP_LOP || ops[address].kind == OP_ELP)
+	{
+		matchLoops(m);
+		for(i=0;i<m->codeWords;i++)
+			LINK(i);
+	}
+	LINK(address);
+	m->isLinked = true;
+	NEXT(1);
+
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef SET_FLAGS
+#undef FLAGS
+#undef CHECK_CODE
+#undef LINK
+
+stop:
+	m->pc = ip - ops;
+	m->steps = steps;
+	m->flagOp = flagOp;
+	m->flagA = flagA;
+	m->flagB = flagB;
+	m->flagResult = flagResult;
+	return m->status;
+}
+
+
+/**
+ *Function to print registers and flags of a machine
+ *@param 	machine* m 						//Machine
+ *@param 	bool isAll 						//Print registers holding zero as well
+ *@return void
+ */
+void printState(const machine * m, bool isAll)
+{
+	const char flagName[] = "ZCPAS";
+	unsigned int flags = currentFlags(m);
+	int i;
+
+	for(i=0;i<NUMBER_OF_REG;i++)
+		if(isAll || m->regs[i])
+			printf("%s = %d\n",registerName[i],(int)m->regs[i]);
+	printf("Flags :");
+	for(i=0;i<5;i++)
+		if(flags>>i & 1)
+			printf(" %c",flagName[i]);
+	printf("\n");
+}
+
+
+/**
+ *Function to write execution counts in format read by cass --profile
+ *@param 	machine* m 						//Machine with profile
+ *@param 	const char* fileName 			//Name of profile file
+ *@return void
+ */
+void writeProfile(const machine * m, const char * fileName)
+{
+	FILE *fileProfile;
+	const profileData *profile = m->profile;
+	int i;
+
+	fileProfile = fopen(fileName,"w");
+	if(!fileProfile)
+	{
+		fprintf(stderr,"cass-sim: Unable to write profile \"%s\" !!\n",fileName);
+		exit(1);
+	}
+	fprintf(fileProfile,"; address hits taken\n");
+	for(i=0;i<m->codeWords;i++)
+		if(profile->hits[i])
+			fprintf(fileProfile,"%d %llu %llu\n",i*4,profile->hits[i],profile->taken[i]);
+	fclose(fileProfile);
+}
+
+
+/**
+ *Function to print flat, per label and loop reports of execution counts
+ *Source lines and labels are shown when symbol file was read
+ *@param 	machine* m 						//Machine with profile
+ *@param 	debugInfo* symbols 				//Contents of symbol file, may be empty
+ *@return void
+ */
+void printProfile(const machine * m, const debugInfo * symbols)
+{
+	const profileData *profile = m->profile;
+	const simOp *ops = m->ops;
+	vector<int> order;
+	vector<unsigned long long> labelHits(symbols->labelName.size()+1,0);
+	unsigned long long total=0,entries,iterations;
+	int i,end,shown;
+	bool isSource = !symbols->line.empty();
+
+	for(i=0;i<m->codeWords;i++)
+		if(profile->hits[i])
+		{
+			order.push_back(i);
+			total += profile->hits[i];
+			labelHits[labelOf(symbols,i*4)+1] += profile->hits[i];
+		}
+	if(!total)
+		return;
+	stable_sort(order.begin(),order.end(),[profile](int a, int b) { return profile->hits[a] > profile->hits[b]; });
+	shown = verbosFlag ? order.size() : min((int)order.size(),PROFILE_TOP);
+
+	printf("\nFlat profile, %d of %d executed addresses\n%8s %14s %7s %14s",shown,(int)order.size(),"address","hits","%","taken");
+	printf(isSource ? " %6s  source\n" : "\n","line");
+	for(i=0;i<shown;i++)
+	{
+		printf("%8d %14llu %6.2f%% %14llu",order[i]*4,profile->hits[order[i]],100.0*profile->hits[order[i]]/total,profile->taken[order[i]]);
+		if(isSource && symbols->line[order[i]])
+			printf(" %6d  %s",symbols->line[order[i]],symbols->source[order[i]].c_str());
+		printf("\n");
+	}
+
+	if(!symbols->labelName.empty())
+	{
+		printf("\nProfile by label\n%-20s %14s %7s\n","label","hits","%");
+		for(i=0;i<(int)labelHits.size();i++)
+			if(labelHits[i])
+				printf("%-20s %14llu %6.2f%%\n",i ? symbols->labelName[i-1].c_str() : "(start)",labelHits[i],100.0*labelHits[i]/total);
+	}
+
+	shown = 0;
+	for(i=0;i<m->codeWords;i += instructionSize(ops[i].kind)/4)
+	{
+		if(ops[i].kind != OP_LOP || !profile->hits[i])
+			continue;
+		if(!shown++)
+			printf("\nLoops\n%8s %12s %12s %16s %12s\n","address","entries","skipped","iterations","average");
+		end = ops[i].target-1;					//Matching ELP
+		entries = profile->hits[i]-profile->taken[i];
+		iterations = profile->hits[end];
+		printf("%8d %12llu %12llu %16llu %12.1f",i*4,entries,profile->taken[i],iterations,entries ? (double)iterations/entries : 0.0);
+		if(isSource && symbols->line[i])
+			printf("  line %d",symbols->line[i]);
+		printf("\n");
+	}
+}
+
+
+/**
+ *Function to take a checkpoint of a machine at its current step
+ *Only pages written since previous checkpoint are copied, rest are shared with it
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+void takeCheckpoint(machine * m)
+{
+	checkpoint *c = (checkpoint *)malloc(sizeof(checkpoint)),*previous = checkpoints.empty() ? NULL : checkpoints.back();
+	int i;
+
+	if(!c)
+	{
+		fprintf(stderr,"cass-sim: Out of memory\n");
+		exit(1);
+	}
+	c->steps = m->steps;
+	memcpy(c->regs,m->regs,sizeof(c->regs));
+	c->pc = m->pc;
+	memcpy(c->loopStack,m->loopStack,sizeof(c->loopStack));
+	c->loopDepth = m->loopDepth;
+	c->flagOp = m->flagOp;
+	c->flagA = m->flagA;
+	c->flagB = m->flagB;
+	c->flagResult = m->flagResult;
+	c->status = m->status;
+	for(i=0;i<MEMORY_PAGES;i++)
+	{
+		if(previous && !m->dirtyPages[i])
+			c->pages[i] = previous->pages[i];
+		else
+		{
+			c->pages[i] = (memoryPage *)malloc(sizeof(memoryPage));
+			if(!c->pages[i])
+			{
+				fprintf(stderr,"cass-sim: Out of memory\n");
+				exit(1);
+			}
+			c->pages[i]->references = 0;
+			memcpy(c->pages[i]->words,&m->memory[i*PAGE_WORDS],sizeof(c->pages[i]->words));
+		}
+		c->pages[i]->references++;
+	}
+	memset(m->dirtyPages,0,sizeof(m->dirtyPages));
+	checkpoints.push_back(c);
+}
+
+
+/**
+ *Function to free a checkpoint and pages held only by it
+ *@param 	checkpoint* c 					//Checkpoint
+ *@return void
+ */
+static void freeCheckpoint(checkpoint * c)
+{
+	int i;
+	for(i=0;i<MEMORY_PAGES;i++)
+		if(--c->pages[i]->references == 0)
+			free(c->pages[i]);
+	free(c);
+}
+
+
+/**
+ *Function to bring a machine back to a checkpoint, checkpoints after it are dropped
+ *Only pages which differ from checkpoint are copied, program is decoded again if it was written
+ *@param 	machine* m 						//Machine
+ *@param 	int index 						//Index of checkpoint
+ *@return void
+ */
+void restoreCheckpoint(machine * m, int index)
+{
+	checkpoint *c = checkpoints[index],*latest = checkpoints.back();
+	int i,j;
+	bool isCodeChanged = false;
+
+	for(i=0;i<MEMORY_PAGES;i++)
+		if(m->dirtyPages[i] || c->pages[i] != latest->pages[i])
+		{
+			memcpy(&m->memory[i*PAGE_WORDS],c->pages[i]->words,sizeof(c->pages[i]->words));
+			if(i*PAGE_WORDS < m->codeWords)
+				isCodeChanged = true;
+		}
+	memset(m->dirtyPages,0,sizeof(m->dirtyPages));
+	while((int)checkpoints.size() > index+1)
+	{
+		freeCheckpoint(checkpoints.back());
+		checkpoints.pop_back();
+	}
+
+	m->steps = c->steps;
+	memcpy(m->regs,c->regs,sizeof(c->regs));
+	m->pc = c->pc;
+	memcpy(m->loopStack,c->loopStack,sizeof(c->loopStack));
+	m->loopDepth = c->loopDepth;
+	m->flagOp = c->flagOp;
+	m->flagA = c->flagA;
+	m->flagB = c->flagB;
+	m->flagResult = c->flagResult;
+	m->status = c->status;
+	if(isCodeChanged)
+	{
+		for(j=0;j<m->codeWords;j++)
+			decodeSlot(m,j);
+		matchLoops(m);
+		m->codeVersion++;
+	}
+}
+
+
+/**
+ *Function to run a machine forward, taking a checkpoint every checkpointInterval steps
+ *@param 	machine* m 						//Machine
+ *@param 	unsigned long long target 		//Step at which to stop, UNLIMITED to run till program stops
+ *@param 	bool isBreaking 				//Stop at breakpoints
+ *@return Status of machine
+ */
+int advance(machine * m, unsigned long long target, bool isBreaking)
+{
+	unsigned long long next;
+	int i,j;
+
+	if(m->isBreaking != isBreaking)
+	{
+		m->isBreaking = isBreaking;
+		m->isLinked = false;
+	}
+	m->status = SIM_STEP_LIMIT;
+	while(m->status == SIM_STEP_LIMIT && m->steps < target)
+	{
+		next = checkpoints.back()->steps + checkpointInterval;
+		run(m,min(target,next) - m->steps);
+		if(m->status == SIM_STEP_LIMIT && m->steps == next)
+			takeCheckpoint(m);
+		if(checkpoints.size() > MAX_CHECKPOINTS)	//Long runs keep fewer checkpoints far apart
+		{
+			for(i=j=1;i<(int)checkpoints.size();i++)
+				if(i % 2 == 0 || i == (int)checkpoints.size()-1)
+					checkpoints[j++] = checkpoints[i];
+				else
+					freeCheckpoint(checkpoints[i]);
+			checkpoints.resize(j);
+			checkpointInterval *= 2;
+		}
+	}
+	return m->status;
+}
+
+
+/**
+ *Function to find index of last checkpoint at or before a step
+ *@param 	unsigned long long steps 		//Step
+ *@return Index of checkpoint
+ */
+static int checkpointBefore(unsigned long long steps)
+{
+	int i;
+	for(i=checkpoints.size()-1;i>0 && checkpoints[i]->steps > steps;i--)
+		;
+	return i;
+}
+
+
+/**
+ *Function to move a machine back by some steps
+ *Nearest checkpoint is restored and the rest is replayed forward
+ *@param 	machine* m 						//Machine
+ *@param 	unsigned long long count 		//Number of steps to undo
+ *@return void
+ */
+void reverseStep(machine * m, unsigned long long count)
+{
+	unsigned long long target = m->steps > count ? m->steps - count : 0;
+
+	restoreCheckpoint(m,checkpointBefore(target));
+	advance(m,target,false);
+}
+
+
+/**
+ *Function to move a machine back to the last step at which it stood at a breakpoint
+ *Checkpoints are searched from the latest, each interval is replayed to find breakpoints in it
+ *@param 	machine* m 						//Machine
+ *@return false if no breakpoint was reached before, machine is then at step 0
+ */
+bool reverseContinue(machine * m)
+{
+	unsigned long long upper = m->steps,found;
+	int k;
+
+	for(k=checkpointBefore(upper > 0 ? upper-1 : 0);k>=0;k--)
+	{
+		restoreCheckpoint(m,k);
+		found = m->ops[m->pc].isBreak && m->steps < upper ? m->steps : UNLIMITED;
+		m->isBreaking = true;
+		m->isLinked = false;
+		m->isResuming = true;				//Breakpoint at the checkpoint is already in "found"
+		while(m->steps < upper && run(m,upper - m->steps) == SIM_BREAK)
+		{
+			found = m->steps;
+			m->isResuming = true;
+		}
+		if(found != UNLIMITED)
+		{
+			restoreCheckpoint(m,k);
+			advance(m,found,false);
+			return true;
+		}
+		upper = checkpoints[k]->steps;
+	}
+	restoreCheckpoint(m,0);
+	return false;
+}
+
+
+/**
+ *Function to print step, address and source of instruction a machine stands at
+ *@param 	machine* m 						//Machine
+ *@param 	debugInfo* symbols 				//Contents of symbol file, may be empty
+ *@return void
+ */
+static void printPosition(const machine * m, const debugInfo * symbols)
+{
+	instruction ins;
+	int label = labelOf(symbols,m->pc*4);
+
+	printf("Step %llu, address %d",m->steps,m->pc*4);
+	if(label >= 0)
+		printf(" (%s+%d)",symbols->labelName[label].c_str(),m->pc*4 - symbols->labelAddress[label]);
+	if(m->pc < (int)symbols->line.size() && symbols->line[m->pc])
+		printf(" line %d : %s\n",symbols->line[m->pc],symbols->source[m->pc].c_str());
+	else if(m->pc < m->codeWords)
+		printf(" : %s\n",mneumonicName[decodeWord(m->memory[m->pc],&ins)]);
+	else
+		printf(" : outside program\n");
+}
+
+
+/**
+ *Function to read an address of the program, a label or a decimal byte address
+ *@param 	machine* m 						//Machine
+ *@param 	debugInfo* symbols 				//Contents of symbol file, may be empty
+ *@param 	const char* text 				//Label or address
+ *@return Index of word, -1 if not in program
+ */
+static int parseLocation(const machine * m, const debugInfo * symbols, const char * text)
+{
+	char *end;
+	long address;
+	int i;
+
+	for(i=0;i<(int)symbols->labelName.size();i++)
+		if(symbols->labelName[i] == text)
+			return symbols->labelAddress[i]/4;
+	address = strtol(text,&end,10);
+	if(end == text || *end || address < 0 || address % 4 || address/4 >= m->codeWords)
+		return -1;
+	return address/4;
+}
+
+
+/**
+ *Function to run a machine under commands read from stdin
+ *A checkpoint is taken at step 0, every checkpointInterval steps and on the checkpoint command
+ *@param 	machine* m 						//Machine
+ *@param 	debugInfo* symbols 				//Contents of symbol file, may be empty
+ *@return void
+ */
+void debugMachine(machine * m, const debugInfo * symbols)
+{
+	char line[256],command[64],argument[128];
+	unsigned long long count;
+	int fields,index,i;
+
+	m->status = SIM_STEP_LIMIT;
+	takeCheckpoint(m);
+	printPosition(m,symbols);
+	while(printf("(cass-sim) "),fflush(stdout),fgets(line,sizeof(line),stdin))
+	{
+		fields = sscanf(line,"%63s %127s",command,argument);
+		if(fields < 1)
+			continue;
+		count = fields == 2 ? strtoull(argument,NULL,10) : 1;
+		if(!strcmp(command,"q") || !strcmp(command,"quit"))
+			break;
+		else if(!strcmp(command,"s") || !strcmp(command,"step") || !strcmp(command,"c") || !strcmp(command,"continue"))
+		{
+			if(m->status != SIM_STEP_LIMIT && m->status != SIM_BREAK)
+			{
+				printf("%s, use reverse-step to go back\n",statusMessage[m->status]);
+				continue;
+			}
+			if(command[0] == 's')
+				advance(m,m->steps + count,false);
+			else
+			{
+				m->isResuming = true;
+				advance(m,UNLIMITED,true);
+			}
+			if(m->status != SIM_STEP_LIMIT)
+				printf("%s\n",statusMessage[m->status]);
+			printPosition(m,symbols);
+		}
+		else if(!strcmp(command,"rs") || !strcmp(command,"reverse-step"))
+		{
+			reverseStep(m,count);
+			printPosition(m,symbols);
+		}
+		else if(!strcmp(command,"rc") || !strcmp(command,"reverse-continue"))
+		{
+			if(!reverseContinue(m))
+				printf("No breakpoint reached before, at start of program\n");
+			printPosition(m,symbols);
+		}
+		else if((!strcmp(command,"b") || !strcmp(command,"break") || !strcmp(command,"d") || !strcmp(command,"delete")) && fields == 2)
+		{
+			index = parseLocation(m,symbols,argument);
+			if(index < 0)
+			{
+				printf("\"%s\" is not a label or byte address of the program\n",argument);
+				continue;
+			}
+			m->ops[index].isBreak = command[0] == 'b';
+			m->isLinked = false;
+			printf("Breakpoint %s at address %d\n",command[0] == 'b' ? "set" : "deleted",index*4);
+		}
+		else if(!strcmp(command,"cp") || !strcmp(command,"checkpoint"))
+		{
+			if(checkpoints.back()->steps != m->steps)
+				takeCheckpoint(m);
+			printf("%d checkpoints, last at step %llu\n",(int)checkpoints.size(),checkpoints.back()->steps);
+		}
+		else if(!strcmp(command,"r") || !strcmp(command,"regs"))
+			printState(m,true);
+		else if((!strcmp(command,"x") || !strcmp(command,"memory")) && fields == 2)
+		{
+			index = strtol(argument,NULL,16) & ADDRESS_MASK;
+			count = strchr(argument,':') ? strtoull(strchr(argument,':')+1,NULL,10) : 1;
+			for(i=0;i<(int)count;i++)
+				printf("%04XH : %d\n",(index+i) & ADDRESS_MASK,(int)m->memory[(index+i) & ADDRESS_MASK]);
+		}
+		else
+			printf("Commands : step [N], continue, reverse-step [N], reverse-continue, break LOCATION,\n"
+				"\t delete LOCATION, checkpoint, regs, memory ADDR[:COUNT], quit\n");
+	}
+}
+
+
+/**
+ *Function to compress a block of records and write it, block is stored as it is if it does not compress
+ *@param 	FILE* file 						//Trace file
+ *@param 	vector<unsigned char>& block 	//Encoded records
+ *@param 	unsigned long long firstStep 	//Step of first record
+ *@param 	unsigned long long count 		//Number of records
+ *@return Bytes written
+ */
+static size_t writeTraceBlock(FILE * file, const vector<unsigned char> & block, unsigned long long firstStep, unsigned long long count)
+{
+	vector<unsigned char> packed(block.size() + block.size()/255 + 16);
+	unsigned char header[TRACE_BLOCK_HEADER];
+	size_t stored;
+
+	stored = compressLz(block.data(),block.size(),packed.data());
+	if(stored >= block.size())
+	{
+		stored = block.size();
+		memcpy(packed.data(),block.data(),stored);
+	}
+	putLittle(header,block.size(),4);
+	putLittle(header+4,stored,4);
+	putLittle(header+8,firstStep,8);
+	putLittle(header+16,count,4);
+	fwrite(header,1,sizeof(header),file);
+	fwrite(packed.data(),1,stored,file);
+	return sizeof(header) + stored;
+}
+
+
+/**
+ *Function run by writer thread, takes records from ring, encodes them in blocks and writes them
+ *An index of blocks is written at the end for seeking
+ *@param 	traceWriter* trace 				//Trace
+ *@return void
+ */
+static void writeTrace(traceWriter * trace)
+{
+	traceState *state = new traceState();
+	vector<unsigned char> block;
+	vector<unsigned long long> indexSteps,indexOffsets;
+	unsigned char footer[16];
+	unsigned long long head = 0,tail,offset = strlen(TRACE_MAGIC),blockStart = 0;
+	int i;
+	bool isDone;
+
+	memcpy(state->regs,trace->regs,sizeof(state->regs));
+	beginTraceBlock(state,&block);
+	for(;;)
+	{
+		isDone = trace->isDone.load(memory_order_acquire);		//Read before tail, so no record comes after it
+		tail = trace->tail.load(memory_order_acquire);
+		if(head == tail && !isDone)
+		{
+			this_thread::yield();
+			continue;
+		}
+		for(;head < tail;head++)
+		{
+			encodeTraceEvent(state,&trace->ring[head & (TRACE_RING_SIZE-1)],block);
+			if(head+1 - blockStart == TRACE_BLOCK_EVENTS)
+			{
+				indexSteps.push_back(blockStart);
+				indexOffsets.push_back(offset);
+				offset += writeTraceBlock(trace->file,block,blockStart,head+1 - blockStart);
+				blockStart = head+1;
+				beginTraceBlock(state,&block);
+			}
+		}
+		trace->head.store(head,memory_order_release);
+		if(isDone)
+			break;
+	}
+	if(head > blockStart)				//Last block, written whether or not ring was empty when isDone was seen
+	{
+		indexSteps.push_back(blockStart);
+		indexOffsets.push_back(offset);
+		offset += writeTraceBlock(trace->file,block,blockStart,head - blockStart);
+	}
+
+	for(i=0;i<(int)indexSteps.size();i++)
+	{
+		putLittle(footer,indexSteps[i],8);
+		putLittle(footer+8,indexOffsets[i],8);
+		fwrite(footer,1,16,trace->file);
+	}
+	putLittle(footer,offset,8);
+	putLittle(footer+8,indexSteps.size(),4);
+	fwrite(footer,1,12,trace->file);
+	fwrite(TRACE_INDEX_MAGIC,1,strlen(TRACE_INDEX_MAGIC),trace->file);
+	delete state;
+}
+
+
+/**
+ *Function to open a trace file and start its writer thread
+ *@param 	machine* m 						//Machine, trace starts at its current step
+ *@param 	const char* fileName 			//Name of trace file
+ *@return void
+ */
+void startTrace(machine * m, const char * fileName)
+{
+	traceWriter *trace = new traceWriter();
+
+	trace->file = fopen(fileName,"wb");
+	if(!trace->file)
+	{
+		fprintf(stderr,"cass-sim: Unable to write trace \"%s\" !!\n",fileName);
+		exit(1);
+	}
+	fwrite(TRACE_MAGIC,1,strlen(TRACE_MAGIC),trace->file);
+	trace->fileName = fileName;
+	memcpy(trace->regs,m->regs,sizeof(trace->regs));
+	trace->writer = thread(writeTrace,trace);
+	m->trace = trace;
+	m->isLinked = false;
+}
+
+
+/**
+ *Function to complete last record of a trace, wait for writer thread and close the file
+ *A failed instruction is recorded without the register it would have written
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+void stopTrace(machine * m)
+{
+	traceWriter *trace = m->trace;
+	unsigned long long events;
+	long bytes;
+
+	if(trace->isPending)
+	{
+		if(m->status != SIM_HALTED && m->status != SIM_STEP_LIMIT)
+			trace->current.reg = TRACE_NO_REG;
+		finishTraceEvent(trace,m->regs,m->memory);
+	}
+	events = trace->tail.load(memory_order_relaxed);
+	trace->isDone.store(true,memory_order_release);
+	trace->writer.join();
+	bytes = ftell(trace->file);
+	if(ferror(trace->file) | fclose(trace->file))
+	{
+		fprintf(stderr,"cass-sim: Unable to write trace \"%s\" !!\n",trace->fileName);
+		exit(1);
+	}
+	printf("Trace of %llu instructions written to \"%s\" (%ld bytes, %.2f bytes per instruction)\n",
+		events,trace->fileName,bytes,events ? (double)bytes/events : 0.0);
+	delete trace;
+	m->trace = NULL;
+	m->isLinked = false;
+}
+
+
+/**
+ *Function to run a group of lanes till every lane halts, fails or executes given number of instructions
+ *Instruction at lowest address of running lanes is executed by all lanes standing there, so
+ *lanes which took different ways at a jump join again where their paths meet
+ *@param 	laneGroup* g 					//Group, lanes not used must not be running
+ *@param 	machine* program 				//Machine holding decoded program
+ *@param 	unsigned long long limit 		//Instructions after which a lane stops, 0 for no limit
+ *@return void
+ */
+LANE_CLONES void runGroup(laneGroup * g, const machine * program, unsigned long long limit)
+{
+	const simOp *op;
+	laneVector mask,running,next,a,b,result,zero = {0},counted = {0};
+	unsigned int pc=0,lane,firstLane=0;
+	unsigned long long uncounted=0;
+	int i,kind,codeWords = program->codeWords;
+	bool isConverged = false;
+
+//Lanes selected by mask take x, others keep y
+#define BLEND(mask,x,y) (((x) & (mask)) | ((y) & ~(mask)))
+#define SPLAT(x) (zero + (unsigned int)(x))
+#define FOR_LANES(mask) for(lane=0;lane<LANES;lane++) if(mask[lane])
+#define STOP_LANE(lane,why) do { g->status[lane] = why; mask[lane] = 0; isConverged = false; } while(0)
+//Steps are counted in 32 bit lanes and added to 64 bit counts before they can overflow
+#define ADD_COUNTED() do { for(lane=0;lane<LANES;lane++) g->steps[lane] += counted[lane]; counted = zero; uncounted = 0; } while(0)
+
+	for(;;)
+	{
+		//Lowest address of running lanes is found again only after lanes may have parted
+		if(!isConverged)
+		{
+			pc = ~0u;
+			for(lane=0;lane<LANES;lane++)
+			{
+				running[lane] = g->status[lane] == SIM_RUNNING ? ~0u : 0;
+				if(running[lane] && g->pc[lane] < pc)
+				{
+					pc = g->pc[lane];
+					firstLane = lane;
+				}
+			}
+			if(pc == ~0u)
+				break;
+			mask = (laneVector)(g->pc == SPLAT(pc)) & running;
+			isConverged = true;
+			for(lane=0;lane<LANES;lane++)
+				isConverged = isConverged && mask[lane] == running[lane];
+		}
+		else
+			mask = running;
+		if(limit)
+			FOR_LANES(mask)
+				if(g->steps[lane] + counted[lane] == limit)
+					STOP_LANE(lane,SIM_STEP_LIMIT);
+		counted -= mask;						//Mask is ~0 in lanes executing, that is -1
+		if(++uncounted == 1u<<31)
+			ADD_COUNTED();
+		g->issued++;
+		op = &program->ops[pc];
+		kind = op->kind;
+		next = SPLAT(pc + instructionSize(kind)/4);
+
+		switch(kind)
+		{
+			case OP_LDR:
+				g->regs[op->r1] = BLEND(mask,g->memory[op->imm],g->regs[op->r1]);
+				break;
+			case OP_STR:
+				if((int)op->imm < codeWords)
+					FOR_LANES(mask)
+						STOP_LANE(lane,SIM_CODE_WRITE);
+				g->memory[op->imm] = BLEND(mask,g->regs[op->r1],g->memory[op->imm]);
+				break;
+			case OP_MAI:
+			case OP_MOI:
+				g->regs[op->r1] = BLEND(mask,SPLAT(op->imm),g->regs[op->r1]);
+				break;
+			case OP_MVR:
+				g->regs[op->r1] = BLEND(mask,g->regs[op->r2],g->regs[op->r1]);
+				break;
+			case K_MVR_LOAD:						//Every lane reads its own address
+				FOR_LANES(mask)
+					g->regs[op->r1][lane] = g->memory[g->regs[REG_ME][lane] & ADDRESS_MASK][lane];
+				break;
+			case K_MVR_STORE:
+			case OP_STI:
+				FOR_LANES(mask)
+				{
+					i = g->regs[kind == OP_STI ? op->r2 : REG_ME][lane] & ADDRESS_MASK;
+					if(i < codeWords)
+						STOP_LANE(lane,SIM_CODE_WRITE);
+					else
+						g->memory[i][lane] = g->regs[kind == OP_STI ? op->r1 : op->r2][lane];
+				}
+				break;
+			case OP_ADD:
+			case OP_SUB:
+			case OP_MUL:
+			case OP_NOT:
+			case OP_INC:
+			case OP_DEC:
+				a = g->regs[op->r1];
+				b = kind == OP_INC || kind == OP_DEC ? SPLAT(1) : g->regs[op->r2];
+				if(kind == OP_ADD || kind == OP_INC)
+					result = a + b;
+				else if(kind == OP_SUB || kind == OP_DEC)
+					result = a - b;
+				else if(kind == OP_MUL)
+					result = a * b;
+				else
+					result = ~a;
+				g->regs[op->r1] = BLEND(mask,result,a);
+				g->flagOp = BLEND(mask,SPLAT(kind),g->flagOp);
+				g->flagA = BLEND(mask,a,g->flagA);
+				g->flagB = BLEND(mask,b,g->flagB);
+				g->flagResult = BLEND(mask,result,g->flagResult);
+				break;
+			case OP_DIV:
+			case OP_MOD:
+				FOR_LANES(mask)
+				{
+					a[lane] = g->regs[op->r1][lane];
+					b[lane] = g->regs[op->r2][lane];
+					if(!evaluateAlu(kind,a[lane],b[lane],&result[lane]))
+					{
+						STOP_LANE(lane,SIM_DIVIDE_ERROR);
+						continue;
+					}
+					g->regs[op->r1][lane] = result[lane];
+					g->flagOp[lane] = kind;
+					g->flagA[lane] = a[lane];
+					g->flagB[lane] = b[lane];
+					g->flagResult[lane] = result[lane];
+				}
+				break;
+			case OP_JZR:
+				next = BLEND((laneVector)(g->regs[op->r1] == zero),SPLAT(op->target),next);
+				isConverged = false;
+				break;
+			case OP_JUM:
+				next = SPLAT(op->target);
+				break;
+			case OP_JMZ:
+				next = BLEND((laneVector)(g->flagResult == zero) & (laneVector)(g->flagOp != SPLAT(~0u)),SPLAT(op->target),next);
+				isConverged = false;
+				break;
+			case OP_JMC:
+			case OP_JMP:
+				FOR_LANES(mask)
+					if(g->flagOp[lane] != ~0u && (aluFlags(g->flagOp[lane],g->flagA[lane],g->flagB[lane],g->flagResult[lane])
+						& (kind == OP_JMC ? FLAG_C : FLAG_P)))
+						next[lane] = op->target;
+				isConverged = false;
+				break;
+			case OP_LOP:
+				FOR_LANES(mask)
+				{
+					if(g->regs[op->r1][lane] == 0)			//Zero count skips the body
+						next[lane] = op->target;
+					else if(g->loopDepth[lane] == MAX_LOOP_DEPTH)
+						STOP_LANE(lane,SIM_LOOP_ERROR);
+					else
+						g->loopStack[g->loopDepth[lane]++][lane] = g->regs[op->r1][lane];
+				}
+				isConverged = false;
+				break;
+			case OP_ELP:
+				FOR_LANES(mask)
+				{
+					if(g->loopDepth[lane] == 0)
+						STOP_LANE(lane,SIM_LOOP_ERROR);
+					else if(--g->loopStack[g->loopDepth[lane]-1][lane])
+						next[lane] = op->target;
+					else
+						g->loopDepth[lane]--;
+				}
+				isConverged = false;
+				break;
+			case OP_NOP:
+				break;
+			case OP_HLT:
+				FOR_LANES(mask)
+					STOP_LANE(lane,SIM_HALTED);
+				break;
+			case K_UNMATCHED:
+				FOR_LANES(mask)
+					STOP_LANE(lane,SIM_LOOP_ERROR);
+				break;
+			case K_OUTSIDE:
+				FOR_LANES(mask)
+					STOP_LANE(lane,SIM_OUTSIDE);
+				break;
+			case OP_OUT:
+			case OP_INP:
+				FOR_LANES(mask)
+					STOP_LANE(lane,SIM_NO_PORT);
+				break;
+			default:
+				FOR_LANES(mask)
+					STOP_LANE(lane,SIM_INVALID);
+				break;
+		}
+		if(g->coverage)
+		{
+			a = mask & (laneVector)(next == SPLAT(pc + instructionSize(kind)/4));
+			b = mask & ~a;
+			for(lane=1;lane<LANES;lane++)		//Whether any lane went each way
+			{
+				a[0] |= a[lane];
+				b[0] |= b[lane];
+			}
+			g->coverage->executed[pc >> 6] |= 1ULL << (pc & 63);
+			g->coverage->fallen[pc >> 6] |= (unsigned long long)(a[0] & 1) << (pc & 63);
+			g->coverage->taken[pc >> 6] |= (unsigned long long)(b[0] & 1) << (pc & 63);
+		}
+		g->pc = BLEND(mask,next,g->pc);
+		pc = next[firstLane];
+	}
+	ADD_COUNTED();
+
+#undef BLEND
+#undef SPLAT
+#undef FOR_LANES
+#undef STOP_LANE
+#undef ADD_COUNTED
+}
+
+
+/**
+ *Function to run one instance of a program for every memory file named in a list
+ *Instances run in groups of LANES, a group stops when all its lanes have stopped
+ *@param 	machine* m 						//Machine with program and memory shared by all instances
+ *@param 	const char* imageFileName 		//Name of image of program, for coverage
+ *@param 	const char* listFileName 		//File naming a memory file on every line
+ *@param 	int dumpAddress 				//First word printed for every instance, -1 for none
+ *@param 	int dumpCount 					//Number of words printed
+ *@return 0 if every instance halted or reached step limit
+ */
+int runLockstep(const machine * m, const char * imageFileName, const char * listFileName, int dumpAddress, int dumpCount)
+{
+	FILE *fileList;
+	char line[512];
+	vector<string> names;
+	laneGroup *g;
+	machine *scratch;
+	coverageMap *total = coverageFileName ? createCoverage() : NULL;
+	unsigned long long steps=0,issued=0;
+	int i,j,lane,first,failed=0;
+	double seconds=0;
+
+	fileList = fopen(listFileName,"r");
+	if(!fileList)
+	{
+		fprintf(stderr,"cass-sim: List file \"%s\" not found !!\n",listFileName);
+		return 1;
+	}
+	while(fgets(line,sizeof(line),fileList))
+	{
+		line[strcspn(line,";\r\n")] = '\0';
+		if(strspn(line," \t") != strlen(line))
+			names.push_back(line + strspn(line," \t"));
+	}
+	fclose(fileList);
+
+	g = (laneGroup *)aligned_alloc(alignof(laneGroup),(sizeof(laneGroup) + alignof(laneGroup)-1) & ~(alignof(laneGroup)-1));
+	scratch = createMachine();
+	if(!g)
+	{
+		fprintf(stderr,"cass-sim: Out of memory\n");
+		return 1;
+	}
+	for(first=0;first<(int)names.size();first += LANES)
+	{
+		memset(g,0,sizeof(laneGroup));
+		g->flagOp -= 1;
+		if(total)
+			g->coverage = createCoverage();
+		for(lane=0;lane<LANES;lane++)
+		{
+			g->status[lane] = first+lane < (int)names.size() ? SIM_RUNNING : SIM_HALTED;
+			if(g->status[lane] != SIM_RUNNING)
+				continue;
+
+			//Memory of instance is built in a machine and copied into its lane
+			memcpy(scratch->memory,m->memory,sizeof(m->memory));
+			scratch->codeWords = 0;
+			if(!loadMemory(scratch,names[first+lane].c_str()))
+				return 1;
+			if(memcmp(scratch->memory,m->memory,m->codeWords*sizeof(unsigned int)))
+			{
+				fprintf(stderr,"cass-sim: Memory file \"%s\" writes into program, not supported in lockstep\n",names[first+lane].c_str());
+				return 1;
+			}
+			for(j=0;j<MAX_IMAGE_WORDS;j++)
+				g->memory[j][lane] = scratch->memory[j];
+			for(j=0;j<NUMBER_OF_REG;j++)
+				g->regs[j][lane] = m->regs[j];
+		}
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		runGroup(g,m,maxSteps);
+		seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		for(lane=0;lane<LANES && first+lane < (int)names.size();lane++)
+		{
+			i = g->status[lane];
+			if(i != SIM_HALTED && i != SIM_STEP_LIMIT)
+				failed++;
+			steps += g->steps[lane];
+			printf("%s : %s after %llu instructions",names[first+lane].c_str(),statusMessage[i],g->steps[lane]);
+			if(i != SIM_HALTED && i != SIM_STEP_LIMIT)
+				printf(" at address %u",g->pc[lane]*4);
+			printf("\n");
+			for(j=0;j<NUMBER_OF_REG && verbosFlag;j++)
+				if(g->regs[j][lane])
+					printf("\t%s = %d\n",registerName[j],(int)g->regs[j][lane]);
+			for(j=0;j<dumpCount && dumpAddress >= 0;j++)
+				printf("\t%04XH : %d\n",(dumpAddress+j) & ADDRESS_MASK,(int)g->memory[(dumpAddress+j) & ADDRESS_MASK][lane]);
+		}
+		issued += g->issued;
+		if(total)
+		{
+			mergeCoverage(total,g->coverage);
+			free(g->coverage);
+		}
+	}
+	printf("%d instances in %d groups of %d lanes, %llu instructions in %.3f seconds (%.1f MIPS), %.1f%% of lanes busy\n",
+		(int)names.size(),(int)(names.size()+LANES-1)/LANES,LANES,steps,seconds,seconds > 0 ? steps/seconds/1e6 : 0.0,
+		issued ? 100.0*steps/(issued*LANES) : 0.0);
+	if(total)
+	{
+		writeCoverage(coverageFileName,vector<string>(1,imageFileName),vector<coverageMap *>(1,total));
+		free(total);
+	}
+	free(g);
+	free(scratch);
+	return failed ? 1 : 0;
+}
+
+
+/**
+ *Function to clear a machine so that another program can be loaded in it
+ *Decoded ops are left, loadImage decodes every word a program can reach
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+void resetMachine(machine * m)
+{
+	memset(m->regs,0,sizeof(m->regs));
+	memset(m->memory,0,sizeof(m->memory));
+	memset(m->dirtyPages,0,sizeof(m->dirtyPages));
+	m->loopDepth = 0;
+	m->flagOp = -1;
+	m->flagA = m->flagB = m->flagResult = 0;
+	m->steps = 0;
+	m->status = SIM_RUNNING;
+}
+
+
+/**
+ *Function to read list of programs run by the farm
+ *Every line is "image [memory|-] [steps=N] [timeout=SECONDS] [ADDRH=VALUE ...]", ';' starts a comment
+ *@param 	const char* fileName 			//Name of farm file
+ *@param 	vector<farmJob>& jobs 			//Programs read
+ *@return false if file could not be read
+ */
+bool readFarm(const char * fileName, vector<farmJob> & jobs)
+{
+	FILE *fileFarm;
+	char line[1024],*token,*value;
+	farmJob job;
+	int lineNumber=0,field;
+
+	fileFarm = fopen(fileName,"r");
+	if(!fileFarm)
+	{
+		fprintf(stderr,"cass-sim: Farm file \"%s\" not found !!\n",fileName);
+		return false;
+	}
+	while(fgets(line,sizeof(line),fileFarm))
+	{
+		lineNumber++;
+		line[strcspn(line,";\r\n")] = '\0';
+		job = farmJob();
+		job.budget = maxSteps;
+		job.timeout = farmTimeout;
+		job.line = lineNumber;
+		for(field=0,token=strtok(line," \t");token;field++,token=strtok(NULL," \t"))
+		{
+			value = strchr(token,'=');
+			if(field == 0)
+				job.image = token;
+			else if(field == 1 && !value)
+				job.memory = strcmp(token,"-") ? token : "";
+			else if(value && !strncmp(token,"steps=",6))
+				job.budget = strtoull(value+1,NULL,10);
+			else if(value && !strncmp(token,"timeout=",8))
+				job.timeout = atof(value+1);
+			else if(value && value > token)
+			{
+				job.checkAddress.push_back(strtol(token,NULL,16) & ADDRESS_MASK);
+				job.checkValue.push_back((unsigned int)strtoll(value+1,NULL,10));
+			}
+			else
+			{
+				fprintf(stderr,"cass-sim: Error at line number %d of farm file, \"%s\" not understood\n",lineNumber,token);
+				fclose(fileFarm);
+				return false;
+			}
+		}
+		if(field)
+			jobs.push_back(job);
+	}
+	fclose(fileFarm);
+	return true;
+}
+
+
+/**
+ *Function to run a program of the farm and check its results
+ *Program runs in slices of FARM_SLICE instructions so that its time limit is checked
+ *@param 	machine* m 						//Machine of worker
+ *@param 	farmJob* job 					//Program, result is filled in
+ *@return void
+ */
+void runFarmJob(machine * m, farmJob * job)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	unsigned long long slice;
+	char text[128];
+	int i;
+
+	resetMachine(m);
+	if(m->timing)
+		resetTiming(m->timing);
+	job->status = SIM_RUNNING;
+	if(!loadImage(m,job->image.c_str()) || (!job->memory.empty() && !loadMemory(m,job->memory.c_str())))
+	{
+		job->failure = "image or memory file could not be read";
+		return;
+	}
+	do
+	{
+		slice = FARM_SLICE;
+		if(job->budget && job->budget - m->steps < slice)
+			slice = job->budget - m->steps;
+		run(m,slice);
+		job->seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if(m->status == SIM_STEP_LIMIT && job->timeout > 0 && job->seconds > job->timeout)
+			m->status = SIM_TIMEOUT;
+	}while(m->status == SIM_STEP_LIMIT && (!job->budget || m->steps < job->budget));
+	job->status = m->status;
+	job->steps = m->steps;
+	if(m->timing)
+		memcpy(job->cycles,m->timing->cycles,sizeof(job->cycles));
+
+	if(m->status != SIM_HALTED)
+	{
+		snprintf(text,sizeof(text),"%s at address %d after %llu instructions",statusMessage[m->status],m->pc*4,m->steps);
+		job->failure = text;
+		return;
+	}
+	for(i=0;i<(int)job->checkAddress.size();i++)
+		if(m->memory[job->checkAddress[i]] != job->checkValue[i])
+		{
+			snprintf(text,sizeof(text),"%04XH is %d, expected %d",job->checkAddress[i],(int)m->memory[job->checkAddress[i]],(int)job->checkValue[i]);
+			job->failure += job->failure.empty() ? text : string(", ") + text;
+		}
+}
+
+
+/**
+ *Function run by every worker of the farm
+ *Jobs are taken from back of own queue, when it is empty from front of another worker's queue
+ *No job is added once workers start, so worker stops when every queue is empty
+ *@param 	int id 							//Index of worker
+ *@param 	vector<farmWorker*>* workers 	//All workers
+ *@param 	vector<farmJob>* jobs 			//All jobs
+ *@return void
+ */
+static void farmWork(int id, vector<farmWorker *> * workers, vector<farmJob> * jobs)
+{
+	farmWorker *self = (*workers)[id],*victim;
+	int index,k,count = workers->size();
+
+	for(;;)
+	{
+		index = -1;
+		{
+			lock_guard<mutex> guard(self->lock);
+			if(!self->queue.empty())
+			{
+				index = self->queue.back();
+				self->queue.pop_back();
+			}
+		}
+		for(k=1;k<count && index < 0;k++)
+		{
+			victim = (*workers)[(id+k) % count];
+			lock_guard<mutex> guard(victim->lock);
+			if(!victim->queue.empty())
+			{
+				index = victim->queue.front();
+				victim->queue.pop_front();
+				self->stolen++;
+			}
+		}
+		if(index < 0)
+			break;
+		if(coverageFileName)
+		{
+			coverageMap *&coverage = self->coverage[(*jobs)[index].image];
+			if(!coverage)
+				coverage = createCoverage();
+			coverage->last = COVERAGE_NONE;
+			self->arena->coverage = coverage;
+		}
+		runFarmJob(self->arena,&(*jobs)[index]);
+		self->done++;
+	}
+}
+
+
+/**
+ *Function to run every program of a farm file on a pool of threads and print one report
+ *Jobs are dealt to workers in equal runs of the file, idle workers steal the rest
+ *@param 	const char* fileName 			//Name of farm file
+ *@return 0 if every program halted with expected results
+ */
+int runFarm(const char * fileName)
+{
+	vector<farmJob> jobs;
+	vector<farmWorker *> workers;
+	vector<thread> threads;
+	map<string, coverageMap *> coverage;
+	map<string, coverageMap *>::iterator it;
+	vector<string> images;
+	vector<coverageMap *> maps;
+	unsigned long long steps=0,cycles[T_COUNT]={0},total;
+	int i,k,count,passed=0,wrong=0,errors=0,limits=0;
+	double seconds;
+
+	if(!readFarm(fileName,jobs))
+		return 1;
+	count = farmThreads > 0 ? farmThreads : (thread::hardware_concurrency() ? thread::hardware_concurrency() : 1);
+	if(count > (int)jobs.size())
+		count = jobs.size() ? jobs.size() : 1;
+	for(i=0;i<count;i++)
+	{
+		workers.push_back(new farmWorker());
+		workers[i]->arena = createMachine();
+		if(timingFlag)
+			workers[i]->arena->timing = createTiming();
+	}
+	for(i=0;i<(int)jobs.size();i++)
+		workers[(long long)i*count/jobs.size()]->queue.push_back(i);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for(i=0;i<count;i++)
+		threads.push_back(thread(farmWork,i,&workers,&jobs));
+	for(i=0;i<count;i++)
+		threads[i].join();
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	for(i=0;i<(int)jobs.size();i++)
+	{
+		steps += jobs[i].steps;
+		for(k=total=0;k<T_COUNT;k++)
+		{
+			cycles[k] += jobs[i].cycles[k];
+			total += jobs[i].cycles[k];
+		}
+		if(jobs[i].failure.empty())
+			passed++;
+		else if(jobs[i].status == SIM_HALTED)
+			wrong++;
+		else if(jobs[i].status == SIM_STEP_LIMIT || jobs[i].status == SIM_TIMEOUT)
+			limits++;
+		else
+			errors++;
+		if(!jobs[i].failure.empty() || verbosFlag)
+			printf("%s line %d %s : %s",jobs[i].failure.empty() ? "PASS" : "FAIL",jobs[i].line,jobs[i].image.c_str(),
+				jobs[i].failure.empty() ? "halted with expected results" : jobs[i].failure.c_str());
+		if((!jobs[i].failure.empty() || verbosFlag) && timingFlag)
+			printf(", %llu cycles",total);
+		if(!jobs[i].failure.empty() || verbosFlag)
+			printf("\n");
+	}
+	printf("Farm ran %d programs on %d threads in %.3f seconds : %d passed, %d failed\n",(int)jobs.size(),count,seconds,passed,(int)jobs.size()-passed);
+	printf("\t%d wrong results, %d errors, %d out of instructions or time\n",wrong,errors,limits);
+	printf("\t%llu instructions (%.1f MIPS)\n",steps,seconds > 0 ? steps/seconds/1e6 : 0.0);
+	if(timingFlag)
+		printTiming(cycles,steps);
+	for(i=0;i<count;i++)
+	{
+		printf("\tWorker %d ran %d programs, %d stolen\n",i,workers[i]->done,workers[i]->stolen);
+		for(it=workers[i]->coverage.begin();it!=workers[i]->coverage.end();it++)
+		{
+			if(!coverage.count(it->first))
+				coverage[it->first] = it->second;
+			else
+			{
+				mergeCoverage(coverage[it->first],it->second);
+				free(it->second);
+			}
+		}
+		free(workers[i]->arena->timing);
+		free(workers[i]->arena);
+		delete workers[i];
+	}
+	if(coverageFileName)
+	{
+		for(it=coverage.begin();it!=coverage.end();it++)
+		{
+			images.push_back(it->first);
+			maps.push_back(it->second);
+		}
+		writeCoverage(coverageFileName,images,maps);
+		for(i=0;i<(int)maps.size();i++)
+			free(maps[i]);
+	}
+	return passed == (int)jobs.size() ? 0 : 1;
+}
+
+
+/**
+ *Function to create empty coverage bitmaps
+ *@return Pointer to coverage
+ */
+coverageMap * createCoverage(void)
+{
+	coverageMap *coverage = (coverageMap *)aligned_alloc(32,(sizeof(coverageMap) + 31) & ~(size_t)31);
+	if(!coverage)
+	{
+		fprintf(stderr,"cass-sim: Out of memory\n");
+		exit(1);
+	}
+	memset(coverage,0,sizeof(coverageMap));
+	coverage->last = COVERAGE_NONE;
+	return coverage;
+}
+
+
+/**
+ *Function to add coverage of other runs of same program, bitmaps are ORed 256 bits at a time
+ *@param 	coverageMap* into 				//Coverage added to
+ *@param 	coverageMap* from 				//Coverage added
+ *@return void
+ */
+LANE_CLONES void mergeCoverage(coverageMap * into, const coverageMap * from)
+{
+	typedef unsigned long long bitVector __attribute__((vector_size(32), aligned(32)));
+	bitVector *to[3] = {(bitVector *)into->executed,(bitVector *)into->taken,(bitVector *)into->fallen};
+	const bitVector *source[3] = {(const bitVector *)from->executed,(const bitVector *)from->taken,(const bitVector *)from->fallen};
+	int i,j;
+
+	for(i=0;i<3;i++)
+		for(j=0;j<COVERAGE_WORDS/4;j++)
+			to[i][j] |= source[i][j];
+}
+
+
+/**
+ *Function to write coverage of programs in lcov format and print a summary of each
+ *Words are mapped to source lines through image_file.sym, without it every word is a line
+ *of the image. Every conditional jump, LOP and ELP has a branch for each way it can go
+ *@param 	const char* fileName 			//Name of lcov file
+ *@param 	vector<string>& images 			//Name of image of every program
+ *@param 	vector<coverageMap*>& maps 		//Coverage of every program
+ *@return void
+ */
+void writeCoverage(const char * fileName, const vector<string> & images, const vector<coverageMap *> & maps)
+{
+	FILE *fileInfo;
+	ifstream fileIn;
+	debugInfo symbols;
+	instruction ins;
+	static unsigned int words[MAX_IMAGE_WORDS];
+	map<int,int> lineHits;
+	map<int,int>::iterator it;
+	int i,k,count,line,op,instructions,executed,branches,branchesHit;
+	bool isHit,isTaken,isFallen;
+
+	fileInfo = fopen(fileName,"w");
+	if(!fileInfo)
+	{
+		fprintf(stderr,"cass-sim: Unable to write coverage \"%s\" !!\n",fileName);
+		exit(1);
+	}
+	for(k=0;k<(int)images.size();k++)
+	{
+		fileIn.open(images[k].c_str(),ios::in);
+		count = fileIn ? readImage(fileIn,words,MAX_IMAGE_WORDS) : -1;
+		fileIn.close();
+		fileIn.clear();
+		if(count < 0)
+			continue;
+		if(!readSymbols((images[k] + ".sym").c_str(),&symbols,count))
+			symbols = debugInfo();
+		fprintf(fileInfo,"TN:\nSF:%s\n",symbols.sourceFile.empty() ? images[k].c_str() : symbols.sourceFile.c_str());
+
+		lineHits.clear();
+		instructions = executed = branches = branchesHit = 0;
+		for(i=0;i<count;i += instructionSize(op)/4)
+		{
+			op = decodeWord(words[i],&ins);
+			line = !symbols.line.empty() && symbols.line[i] ? symbols.line[i] : i+1;
+			isHit = maps[k]->executed[i >> 6] >> (i & 63) & 1;
+			instructions++;
+			executed += isHit;
+			lineHits[line] |= isHit;
+			if(op == OP_JZR || op == OP_JMC || op == OP_JMZ || op == OP_JMP || op == OP_LOP || op == OP_ELP)
+			{
+				isTaken = maps[k]->taken[i >> 6] >> (i & 63) & 1;
+				isFallen = maps[k]->fallen[i >> 6] >> (i & 63) & 1;
+				branches += 2;
+				branchesHit += isTaken + isFallen;
+				if(isHit)
+					fprintf(fileInfo,"BRDA:%d,%d,0,%d\nBRDA:%d,%d,1,%d\n",line,i*4,isTaken,line,i*4,isFallen);
+				else
+					fprintf(fileInfo,"BRDA:%d,%d,0,-\nBRDA:%d,%d,1,-\n",line,i*4,line,i*4);
+			}
+		}
+		for(it=lineHits.begin();it!=lineHits.end();it++)
+			fprintf(fileInfo,"DA:%d,%d\n",it->first,it->second);
+		fprintf(fileInfo,"BRF:%d\nBRH:%d\nLF:%d\nLH:%d\nend_of_record\n",branches,branchesHit,(int)lineHits.size(),
+			(int)count_if(lineHits.begin(),lineHits.end(),[](const pair<const int,int> & hit) { return hit.second != 0; }));
+		printf("Coverage of %s : %d of %d instructions (%.1f%%), %d of %d branch directions (%.1f%%)\n",images[k].c_str(),
+			executed,instructions,instructions ? 100.0*executed/instructions : 0.0,branchesHit,branches,branches ? 100.0*branchesHit/branches : 0.0);
+	}
+	fclose(fileInfo);
+}
+
+
+/**
+ *Function to set a parameter of timing model
+ *@param 	timingModel* model 				//Timing model
+ *@param 	const char* key 				//"stages", a group of ops or mneumonic of one op
+ *@param 	int value 						//Cycles
+ *@return false if key is not known
+ */
+static bool setTiming(timingModel * model, const char * key, int value)
+{
+	static const char * const groupKey[] = {"alu", "mul", "div", "load", "store", "branch", "jump"};
+	static const char groupOf[] = "AMDLSBJ";
+	int k,g=-1,op=-1;
+
+	if(!strcmp(key,"stages"))
+	{
+		model->stages = value > 0 ? value : 1;
+		return true;
+	}
+	for(k=0;k<7 && g < 0;k++)
+		if(!strcmp(key,groupKey[k]))
+			g = groupOf[k];
+	for(k=0;k<OP_INVALID && g < 0 && op < 0;k++)
+		if(!strcmp(key,mneumonicName[k]))
+			op = k;
+	if(g < 0 && op < 0)
+		return false;
+	for(k=0;k<K_COUNT;k++)
+	{
+		if(k != op && timingGroup[k] != g)
+			continue;
+		if(timingGroup[k] == 'B' || timingGroup[k] == 'J')
+			model->penalty[k] = value;
+		else if(timingGroup[k] == 'S')
+			model->busy[k] = value;
+		else
+			model->latency[k] = value;
+		if(timingGroup[k] == 'D')						//Divider is not pipelined
+			model->busy[k] = value;
+		model->unit[k] = timingGroup[k] == 'L' || timingGroup[k] == 'S' ? UNIT_MEMORY : timingGroup[k] == 'D' ? UNIT_DIVIDER : UNIT_NONE;
+		model->producer[k] = timingGroup[k] == 'L' ? T_LOAD : timingGroup[k] == 'M' || timingGroup[k] == 'D' ? T_MULDIV : T_DATA;
+		model->redirect[k] = timingGroup[k] == 'J' ? T_JUMP : T_BRANCH;
+	}
+	return true;
+}
+
+
+/**
+ *Function to read timing model from a file, parameters not in file keep their defaults
+ *Every line is "key cycles", ';' starts a comment. Keys are stages, alu, mul, div (DIV and MOD),
+ *load, store, branch (taken JZR, JMC, JMZ, JMP, LOP and ELP), jump (JUM) or mneumonic of an op
+ *@param 	const char* fileName 			//Name of timing file, NULL for defaults only
+ *@param 	timingModel* model 				//Timing model read
+ *@return false if file could not be read
+ */
+bool readTiming(const char * fileName, timingModel * model)
+{
+	static const char * const defaults[] = {"alu", "mul", "div", "load", "store", "branch", "jump"};
+	static const int defaultCycles[] = {1, 3, 6, 2, 1, 2, 1};
+	FILE *fileTiming;
+	char line[256],key[64];
+	int k,value,lineNumber=0;
+
+	memset(model,0,sizeof(timingModel));
+	model->stages = 5;
+	for(k=0;k<K_COUNT;k++)
+		model->latency[k] = model->busy[k] = 1;
+	for(k=0;k<7;k++)
+		setTiming(model,defaults[k],defaultCycles[k]);
+	for(k=0;k<OP_INVALID;k++)				//Result latencies of isa.def, as used by scheduler of cass
+		if(strchr("AMDL",timingGroup[k]))
+			setTiming(model,mneumonicName[k],isaLatency[k]);
+	if(!fileName)
+		return true;
+
+	fileTiming = fopen(fileName,"r");
+	if(!fileTiming)
+	{
+		fprintf(stderr,"cass-sim: Timing file \"%s\" not found !!\n",fileName);
+		return false;
+	}
+	while(fgets(line,sizeof(line),fileTiming))
+	{
+		lineNumber++;
+		line[strcspn(line,";\r\n")] = '\0';
+		if(sscanf(line," %63s",key) != 1)
+			continue;
+		if(sscanf(line," %*s %d",&value) != 1 || value < 0 || !setTiming(model,key,value))
+		{
+			fprintf(stderr,"cass-sim: Error at line number %d of timing file, \"%s\" not understood\n",lineNumber,line);
+			fclose(fileTiming);
+			return false;
+		}
+	}
+	fclose(fileTiming);
+	return true;
+}
+
+
+/**
+ *Function to create state of timing model for a run
+ *@return Pointer to timing state
+ */
+timingState * createTiming(void)
+{
+	timingState *clock = (timingState *)malloc(sizeof(timingState));
+	if(!clock)
+	{
+		fprintf(stderr,"cass-sim: Out of memory\n");
+		exit(1);
+	}
+	resetTiming(clock);
+	return clock;
+}
+
+
+/**
+ *Function to clear timing state before a run, pipeline starts empty
+ *@param 	timingState* clock 				//Timing state
+ *@return void
+ */
+void resetTiming(timingState * clock)
+{
+	memset(clock,0,sizeof(timingState));
+	clock->cycle = clock->cycles[T_FILL] = timing.stages - 1;
+	clock->last = OP_NOP;
+}
+
+
+/**
+ *Function to print cycles counted by timing model and what they were spent on
+ *@param 	unsigned long long* cycles 		//Cycles of every class
+ *@param 	unsigned long long steps 		//Instructions executed
+ *@return void
+ */
+void printTiming(const unsigned long long * cycles, unsigned long long steps)
+{
+	unsigned long long total=0;
+	int k;
+
+	for(k=0;k<T_COUNT;k++)
+		total += cycles[k];
+	printf("Timing : %llu cycles for %llu instructions (CPI %.3f) on %d stage pipeline\n",total,steps,
+		steps ? (double)total/steps : 0.0,timing.stages);
+	for(k=0;k<T_COUNT;k++)
+		if(cycles[k])
+			printf("\t%-20s %14llu %6.2f%%\n",timingClassName[k],cycles[k],100.0*cycles[k]/total);
+}
+
+/**
+ *Function to connect a host file or pipe to a port
+ *Argument is "PORT:FILE" where FILE is "-" for standard input or output, "|command"
+ *for a pipe to or from command and anything else for a file
+ *@param 	const char* argument 			//Port and file
+ *@param 	bool isOutput 					//true for OUT, false for INP
+ *@return false if port or file is not valid
+ */
+bool openPort(const char * argument, bool isOutput)
+{
+	portDevice **slot,*device;
+	const char *fileName;
+	char *end;
+	long port;
+
+	port = strtol(argument,&end,10);
+	if(end == argument || *end != ':' || port < 0 || port >= MAX_PORTS)
+	{
+		fprintf(stderr,"cass-sim: Port must be given as PORT:FILE with PORT from 0 to %d, not \"%s\"\n",MAX_PORTS-1,argument);
+		return false;
+	}
+	slot = isOutput ? &devices.output[port] : &devices.input[port];
+	if(*slot)
+	{
+		fprintf(stderr,"cass-sim: %s port %ld is already connected\n",isOutput ? "Output" : "Input",port);
+		return false;
+	}
+	fileName = end+1;
+	device = new portDevice();
+	device->fileName = fileName;
+	if(!strcmp(fileName,"-"))
+		device->file = isOutput ? stdout : stdin;
+	else if(fileName[0] == '|')
+	{
+		fflush(stdout);
+		device->file = popen(fileName+1,isOutput ? "w" : "r");
+		device->isPipe = true;
+	}
+	else
+		device->file = fopen(fileName,isOutput ? "wb" : "rb");
+	if(!device->file)
+	{
+		fprintf(stderr,"cass-sim: Could not open \"%s\" for port %ld\n",fileName,port);
+		delete device;
+		return false;
+	}
+	*slot = device;
+	return true;
+}
+
+
+/**
+ *Function to refill buffer of an input port once INP has taken all of its words
+ *Text input is read PORT_TEXT characters at a time, a number cut at end of a chunk is
+ *kept and completed by next chunk
+ *@param 	portDevice* device 				//Input device
+ *@return false if input has no more data
+ */
+bool fillPort(portDevice * device)
+{
+	unsigned char raw[4*PORT_BUFFER];
+	char *start,*end;
+	long long value;
+	size_t bytes,i;
+	int left;
+
+	device->transferred += device->head;
+	device->head = 0;
+	device->count = 0;
+	if(device->isEnd && device->textStart == device->textEnd)
+		return false;
+	if(rawPortsFlag)
+	{
+		bytes = fread(raw,1,sizeof(raw),device->file);
+		for(i=0;i+4<=bytes;i+=4)
+			device->words[device->count++] = raw[i] | raw[i+1]<<8 | raw[i+2]<<16 | (unsigned int)raw[i+3]<<24;
+		if(bytes < sizeof(raw))
+			device->isEnd = true;
+		return device->count > 0;
+	}
+	while(device->count < PORT_BUFFER)
+	{
+		//Skip blanks, then take a number only if its end is known
+		while(device->textStart < device->textEnd && isspace((unsigned char)device->text[device->textStart]))
+			device->textStart++;
+		for(i=device->textStart;(int)i<device->textEnd && !isspace((unsigned char)device->text[i]);i++)
+			;
+		if((int)i == device->textEnd && !device->isEnd)
+		{
+			left = device->textEnd - device->textStart;
+			memmove(device->text,device->text+device->textStart,left);
+			device->textStart = 0;
+			device->textEnd = left + fread(device->text+left,1,PORT_TEXT-left,device->file);
+			device->text[device->textEnd] = '\0';
+			if(device->textEnd < PORT_TEXT)
+				device->isEnd = true;
+			else if(left == PORT_TEXT)
+			{
+				fprintf(stderr,"cass-sim: Port input \"%s\" has a word longer than %d characters\n",device->fileName.c_str(),PORT_TEXT);
+				device->isEnd = true;
+				device->textEnd = 0;
+			}
+			continue;
+		}
+		if(device->textStart == device->textEnd)
+			break;
+		start = device->text + device->textStart;
+		value = strtoll(start,&end,0);
+		if(end != device->text + i || value < INT_MIN || value > UINT_MAX)
+		{
+			fprintf(stderr,"cass-sim: Port input \"%s\" has \"%.*s\" which is not a number\n",device->fileName.c_str(),
+				(int)(i-device->textStart),start);
+			device->isEnd = true;
+			device->textStart = device->textEnd = 0;
+			break;
+		}
+		device->words[device->count++] = (unsigned int)value;
+		device->textStart = i;
+	}
+	return device->count > 0;
+}
+
+
+/**
+ *Function to write buffer of an output port to its file
+ *@param 	portDevice* device 				//Output device
+ *@return void
+ */
+void flushPort(portDevice * device)
+{
+	unsigned char raw[4*PORT_BUFFER];
+	char text[12*PORT_BUFFER],digits[12],*p;
+	unsigned int magnitude;
+	int i,j;
+
+	if(rawPortsFlag)
+	{
+		for(i=0;i<device->count;i++)
+			putLittle(raw+4*i,device->words[i],4);
+		fwrite(raw,4,device->count,device->file);
+	}
+	else
+	{
+		p = text;
+		for(i=0;i<device->count;i++)
+		{
+			magnitude = (int)device->words[i] < 0 ? 0u - device->words[i] : device->words[i];
+			if((int)device->words[i] < 0)
+				*p++ = '-';
+			j = 0;
+			do
+			{
+				digits[j++] = '0' + magnitude%10;
+				magnitude /= 10;
+			}while(magnitude);
+			while(j)
+				*p++ = digits[--j];
+			*p++ = '\n';
+		}
+		fwrite(text,1,p-text,device->file);
+	}
+	device->transferred += device->count;
+	device->count = 0;
+}
+
+
+/**
+ *Function to flush and close every device of ports
+ *@param 	portSet* ports 					//Devices
+ *@return void
+ */
+void closePorts(portSet * ports)
+{
+	portDevice *device;
+	int i,j;
+
+	for(j=0;j<2;j++)
+		for(i=0;i<MAX_PORTS;i++)
+		{
+			device = j ? ports->output[i] : ports->input[i];
+			if(!device)
+				continue;
+			if(j)
+				flushPort(device);
+			else
+				device->transferred += device->head;
+			if(device->isPipe)
+				pclose(device->file);
+			else if(device->file == stdout)
+				fflush(stdout);
+			else if(device->file != stdin)
+				fclose(device->file);
+			if(verbosFlag)
+				printf("Port %d : %llu words %s \"%s\"\n",i,device->transferred,j ? "written to" : "read from",device->fileName.c_str());
+			delete device;
+			if(j)
+				ports->output[i] = NULL;
+			else
+				ports->input[i] = NULL;
+		}
+}
+
+
+#ifdef HAS_JIT
+
+/**
+ *Structure to hold blocks translated into x86-64 code for a machine
+ *Guest registers used most by the program are kept in r8d to r15d, others stay in
+ *"regs" of machine which is pointed by rbx. A block which exits to a block not yet
+ *translated leaves a stub "mov eax,pc; jmp epilogue" which is patched into a direct
+ *jump once that block is translated
+ */
+struct jitCache {
+	unsigned char *buffer;
+	size_t used;
+	unsigned char *translation[MAX_IMAGE_WORDS+2];		//Native code of block starting at each word
+	vector<unsigned char *> *pending;					//Stubs waiting for block starting at each word
+	int hostReg[NUMBER_OF_REG];							//Host register of guest register, -1 if in memory
+	int pinnedGuest[JIT_PINNED];
+	int pinnedCount;
+	unsigned char *epilogue;
+	size_t codeStart;									//Bytes used by entry and epilogue code
+	unsigned int (*enter)(machine * , unsigned char * );
+	bool isChaining;
+};
+
+typedef struct jitCache jitCache;
+
+#define OFFSET_REG(r) ((int)(offsetof(machine,regs)+4*(r)))
+#define OFFSET_MEM ((int)offsetof(machine,memory))
+#define HOST_EAX 0
+#define HOST_ECX 1
+#define HOST_EDX 2
+#define HOST_EBX 3
+#define HOST_ESI 6
+#define CC_B 2
+#define CC_AE 3
+#define CC_E 4
+#define CC_NE 5
+
+
+/**
+ *Functions to write bytes of x86-64 code at end of buffer
+ */
+static void emit8(jitCache * jit, unsigned int byte)
+{
+	jit->buffer[jit->used++] = (unsigned char)byte;
+}
+
+static void emit32(jitCache * jit, unsigned int word)
+{
+	memcpy(jit->buffer+jit->used,&word,4);
+	jit->used += 4;
+}
+
+static void emitRex(jitCache * jit, int reg, int index, int base)
+{
+	if(reg >= 8 || index >= 8 || base >= 8)
+		emit8(jit,0x40 | (reg>>3)<<2 | (index>>3)<<1 | base>>3);
+}
+
+
+/**
+ *Function to write "op [rbx+disp32],reg" or "op reg,[rbx+disp32]" depending on opcode
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int opcode 						//0x8B for load, 0x89 for store
+ *@param 	int reg 						//Host register
+ *@param 	int disp 						//Offset from machine
+ *@return void
+ */
+static void emitField(jitCache * jit, int opcode, int reg, int disp)
+{
+	emitRex(jit,reg,0,HOST_EBX);
+	emit8(jit,opcode);
+	emit8(jit,0x80 | (reg&7)<<3 | HOST_EBX);
+	emit32(jit,disp);
+}
+
+
+/**
+ *Function to write "op reg,[rbx+rcx*4+disp32]" or its store form
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int opcode 						//0x8B for load, 0x89 for store, 0xFF for dec
+ *@param 	int reg 						//Host register, or extension of opcode
+ *@param 	int disp 						//Offset from machine
+ *@return void
+ */
+static void emitIndexed(jitCache * jit, int opcode, int reg, int disp)
+{
+	emitRex(jit,reg,HOST_ECX,HOST_EBX);
+	emit8(jit,opcode);
+	emit8(jit,0x84 | (reg&7)<<3);
+	emit8(jit,0x80 | HOST_ECX<<3 | HOST_EBX);
+	emit32(jit,disp);
+}
+
+
+/**
+ *Function to write "op dst,src" for two 32 bit host registers
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int opcode 						//0x89 mov, 0x01 add, 0x29 sub
+ *@param 	int dst 						//Destination register
+ *@param 	int src 						//Source register
+ *@return void
+ */
+static void emitRegReg(jitCache * jit, int opcode, int dst, int src)
+{
+	emitRex(jit,src,0,dst);
+	emit8(jit,opcode);
+	emit8(jit,0xC0 | (src&7)<<3 | (dst&7));
+}
+
+static void loadGuest(jitCache * jit, int host, int guest)
+{
+	if(jit->hostReg[guest] != -1)
+		emitRegReg(jit,0x89,host,jit->hostReg[guest]);
+	else
+		emitField(jit,0x8B,host,OFFSET_REG(guest));
+}
+
+static void storeGuest(jitCache * jit, int guest, int host)
+{
+	if(jit->hostReg[guest] != -1)
+		emitRegReg(jit,0x89,jit->hostReg[guest],host);
+	else
+		emitField(jit,0x89,host,OFFSET_REG(guest));
+}
+
+
+/**
+ *Function to write a conditional jump whose target is filled later by "patchHere"
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int cc 							//Condition code (CC_XXX)
+ *@return Position of displacement to patch
+ */
+static size_t emitJcc(jitCache * jit, int cc)
+{
+	emit8(jit,0x0F);
+	emit8(jit,0x80 | cc);
+	emit32(jit,0);
+	return jit->used-4;
+}
+
+static void patchHere(jitCache * jit, size_t position)
+{
+	int rel = (int)(jit->used - (position+4));
+	memcpy(jit->buffer+position,&rel,4);
+}
+
+static void emitJump(jitCache * jit, const unsigned char * target)
+{
+	emit8(jit,0xE9);
+	emit32(jit,(unsigned int)(target - (jit->buffer+jit->used+4)));
+}
+
+
+/**
+ *Function to leave translated code so that interpreter runs the instruction at "index"
+ *Steps of instructions of the block not executed are taken back
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int index 						//Word of instruction
+ *@param 	int notExecuted 				//Instructions of block from "index" onwards
+ *@return void
+ */
+static void emitInterpretExit(jitCache * jit, int index, int notExecuted)
+{
+	if(notExecuted)
+	{
+		emit8(jit,0x48);				//sub qword [rbx+steps],notExecuted
+		emit8(jit,0x81);
+		emit8(jit,0xAB);
+		emit32(jit,offsetof(machine,steps));
+		emit32(jit,notExecuted);
+	}
+	emit8(jit,0xB8);					//mov eax,index|JIT_INTERPRET
+	emit32(jit,index | JIT_INTERPRET);
+	emitJump(jit,jit->epilogue);
+}
+
+
+/**
+ *Function to continue at block starting at "index", jumping straight to it when translated
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int index 						//Word where execution continues
+ *@return void
+ */
+static void emitChain(jitCache * jit, int index)
+{
+	if(jit->isChaining && jit->translation[index])
+	{
+		emitJump(jit,jit->translation[index]);
+		return;
+	}
+	if(jit->isChaining)
+		jit->pending[index].push_back(jit->buffer+jit->used);
+	emit8(jit,0xB8);					//mov eax,index
+	emit32(jit,index);
+	emitJump(jit,jit->epilogue);
+}
+
+
+/**
+ *Function called by translated code to read flags for JMC and JMP
+ */
+static unsigned int jitFlags(const machine * m)
+{
+	return currentFlags(m);
+}
+
+
+/**
+ *Function to save flags of an arithmetic operation in machine
+ *@param 	jitCache* jit 					//Translation cache
+ *@param 	int op 							//Operation
+ *@param 	int a 							//Host register holding first operand
+ *@param 	int b 							//Host register holding second operand, -1 for immediate "value"
+ *@param 	unsigned int value 				//Second operand of NOT, INC and DEC
+ *@param 	int result 						//Host register holding result
+ *@return void
+ */
+static void emitFlags(jitCache * jit, int op, int a, int b, unsigned int value, int result)
+{
+	emit8(jit,0xC7);
+	emit8(jit,0x83);
+	emit32(jit,offsetof(machine,flagOp));
+	emit32(jit,op);
+	emitField(jit,0x89,a,offsetof(machine,flagA));
+	if(b == -1)
+	{
+		emit8(jit,0xC7);
+		emit8(jit,0x83);
+		emit32(jit,offsetof(machine,flagB));
+		emit32(jit,value);
+	}
+	else
+		emitField(jit,0x89,b,offsetof(machine,flagB));
+	emitField(jit,0x89,result,offsetof(machine,flagResult));
+}
+
+
+/**
+ *Function to check if flags of an arithmetic operation must be saved
+ *They need not be saved if another arithmetic operation follows before block can be left
+ *@param 	machine* m 						//Machine
+ *@param 	int index 						//Word of operation
+ *@param 	int end 						//Word following the block
+ *@return true if flags must be saved
+ */
+static bool isFlagNeeded(const machine * m, int index, int end)
+{
+	int i,kind;
+	for(i=index+1;i<end;i += instructionSize(m->ops[i].kind)/4)
+	{
+		kind = m->ops[i].kind;
+		if(kind == OP_ADD || kind == OP_SUB || kind == OP_MUL || kind == OP_NOT || kind == OP_INC || kind == OP_DEC)
+			return false;
+		if(kind == OP_DIV || kind == OP_MOD || kind == OP_STI || kind == K_MVR_STORE)
+			return true;
+	}
+	return true;
+}
+
+
+/**
+ *Function to create translation cache of a machine
+ *Writes entry code, which saves host registers, loads pinned guest registers and
+ *jumps to a block, and epilogue which does the reverse and returns pc in eax
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+static void createJit(machine * m)
+{
+	const unsigned char enterCode[] = {0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,
+		0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB};			//push rbx..r15; sub rsp,8; mov rbx,rdi
+	const unsigned char leaveCode[] = {0x48, 0x83, 0xC4, 0x08, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D,
+		0x41, 0x5C, 0x5D, 0x5B, 0xC3};						//add rsp,8; pop r15..rbx; ret
+	jitCache *jit = new jitCache;
+	int uses[NUMBER_OF_REG],i,j,best;
+
+	jit->buffer = (unsigned char *)mmap(NULL,JIT_BUFFER_SIZE,PROT_READ | PROT_WRITE | PROT_EXEC,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+	if(jit->buffer == MAP_FAILED)
+	{
+		fprintf(stderr,"cass-sim: Could not map executable memory for JIT\n");
+		exit(1);
+	}
+	jit->pending = new vector<unsigned char *>[MAX_IMAGE_WORDS+2];
+	jit->isChaining = true;
+
+	//Registers referred by most instructions are pinned
+	memset(uses,0,sizeof(uses));
+	for(i=0;i<m->codeWords;i += instructionSize(m->ops[i].kind)/4)
+	{
+		uses[m->ops[i].r1]++;
+		uses[m->ops[i].r2]++;
+		if(m->ops[i].kind == K_MVR_LOAD || m->ops[i].kind == K_MVR_STORE)
+			uses[REG_ME]++;
+	}
+	for(i=0;i<NUMBER_OF_REG;i++)
+		jit->hostReg[i] = -1;
+	for(jit->pinnedCount=0;jit->pinnedCount<JIT_PINNED;jit->pinnedCount++)
+	{
+		for(best=-1,j=0;j<NUMBER_OF_REG;j++)
+			if(jit->hostReg[j] == -1 && uses[j] && (best == -1 || uses[j] > uses[best]))
+				best = j;
+		if(best == -1)
+			break;
+		jit->hostReg[best] = 8+jit->pinnedCount;
+		jit->pinnedGuest[jit->pinnedCount] = best;
+	}
+
+	jit->used = 0;
+	jit->enter = (unsigned int (*)(machine * , unsigned char * ))jit->buffer;
+	memcpy(jit->buffer,enterCode,sizeof(enterCode));
+	jit->used = sizeof(enterCode);
+	for(i=0;i<jit->pinnedCount;i++)
+		emitField(jit,0x8B,jit->hostReg[jit->pinnedGuest[i]],OFFSET_REG(jit->pinnedGuest[i]));
+	emit8(jit,0xFF);					//jmp rsi
+	emit8(jit,0xE6);
+	jit->epilogue = jit->buffer+jit->used;
+	for(i=0;i<jit->pinnedCount;i++)
+		emitField(jit,0x89,jit->hostReg[jit->pinnedGuest[i]],OFFSET_REG(jit->pinnedGuest[i]));
+	memcpy(jit->buffer+jit->used,leaveCode,sizeof(leaveCode));
+	jit->used += sizeof(leaveCode);
+	jit->codeStart = jit->used;
+	memset(jit->translation,0,sizeof(jit->translation));
+	m->jit = jit;
+}
+
+
+/**
+ *Function to drop all translated blocks, keeping entry and epilogue code
+ *@param 	machine* m 						//Machine
+ *@return void
+ */
+static void flushJit(machine * m)
+{
+	jitCache *jit = m->jit;
+	int i;
+	jit->used = jit->codeStart;
+	memset(jit->translation,0,sizeof(jit->translation));
+	for(i=0;i<MAX_IMAGE_WORDS+2;i++)
+		jit->pending[i].clear();
+}
+
+
+/**
+ *Function to translate the block starting at a word into x86-64 code
+ *Block ends at a jump, LOP, ELP, HLT, an instruction left to interpreter or after
+ *JIT_MAX_BLOCK instructions. Stores into the program, division errors and loop
+ *stack errors leave the block so that interpreter handles them
+ *@param 	machine* m 						//Machine
+ *@param 	int start 						//Word where block starts
+ *@return Native code of block
+ */
+static unsigned char * translateBlock(machine * m, int start)
+{
+	jitCache *jit = m->jit;
+	const simOp *op;
+	unsigned char *code;
+	size_t skip,other;
+	int i,count=0,end,k,position[JIT_MAX_BLOCK+1];
+	bool isEnd=false;
+
+	if(JIT_BUFFER_SIZE - jit->used < JIT_BLOCK_RESERVE)
+		flushJit(m);
+	code = jit->buffer+jit->used;
+
+	//Find instructions of block, "count" of them are translated
+	for(i=start;count<JIT_MAX_BLOCK && !isEnd;i += instructionSize(m->ops[i].kind)/4)
+	{
+		position[count++] = i;
+		switch(m->ops[i].kind)
+		{
+			case OP_STR : isEnd = (int)m->ops[i].imm < m->codeWords;
+						break;
+			case OP_JZR : case OP_JUM : case OP_JMC : case OP_JMZ : case OP_JMP :
+			case OP_LOP : case OP_ELP : case OP_HLT : case OP_OUT : case OP_INP :
+			case OP_INVALID : case K_UNMATCHED : case K_OUTSIDE :
+						isEnd = true;
+		}
+	}
+	end = i;
+
+	emit8(jit,0x48);					//add qword [rbx+steps],count
+	emit8(jit,0x81);
+	emit8(jit,0x83);
+	emit32(jit,offsetof(machine,steps));
+	emit32(jit,count);
+	for(k=0;k<count;k++)
+	{
+		i = position[k];
+		op = &m->ops[i];
+		switch(op->kind)
+		{
+			case OP_LDR :
+				emitField(jit,0x8B,HOST_EAX,OFFSET_MEM+4*op->imm);
+				storeGuest(jit,op->r1,HOST_EAX);
+				break;
+			case OP_STR :
+				if((int)op->imm < m->codeWords)
+				{
+					emitInterpretExit(jit,i,count-k);
+					break;
+				}
+				loadGuest(jit,HOST_EAX,op->r1);
+				emitField(jit,0x89,HOST_EAX,OFFSET_MEM+4*op->imm);
+				break;
+			case OP_MAI : case OP_MOI :
+				emit8(jit,0xB8);
+				emit32(jit,op->imm);
+				storeGuest(jit,op->r1,HOST_EAX);
+				break;
+			case OP_MVR :
+				loadGuest(jit,HOST_EAX,op->r2);
+				storeGuest(jit,op->r1,HOST_EAX);
+				break;
+			case K_MVR_LOAD :
+				loadGuest(jit,HOST_ECX,REG_ME);
+				emit8(jit,0x81);		//and ecx,ADDRESS_MASK
+				emit8(jit,0xE1);
+				emit32(jit,ADDRESS_MASK);
+				emitIndexed(jit,0x8B,HOST_EAX,OFFSET_MEM);
+				storeGuest(jit,op->r1,HOST_EAX);
+				break;
+			case K_MVR_STORE : case OP_STI :
+				loadGuest(jit,HOST_ECX,op->kind == OP_STI ? op->r2 : REG_ME);
+				emit8(jit,0x81);		//and ecx,ADDRESS_MASK
+				emit8(jit,0xE1);
+				emit32(jit,ADDRESS_MASK);
+				emit8(jit,0x81);		//cmp ecx,codeWords
+				emit8(jit,0xF9);
+				emit32(jit,m->codeWords);
+				skip = emitJcc(jit,CC_AE);
+				emitInterpretExit(jit,i,count-k);
+				patchHere(jit,skip);
+				loadGuest(jit,HOST_EAX,op->kind == OP_STI ? op->r1 : op->r2);
+				emitIndexed(jit,0x89,HOST_EAX,OFFSET_MEM);
+				break;
+			case OP_ADD : case OP_SUB : case OP_MUL :
+				loadGuest(jit,HOST_EAX,op->r1);
+				loadGuest(jit,HOST_ECX,op->r2);
+				emitRegReg(jit,0x89,HOST_EDX,HOST_EAX);
+				if(op->kind == OP_MUL)
+				{
+					emit8(jit,0x0F);	//imul eax,ecx
+					emit8(jit,0xAF);
+					emit8(jit,0xC1);
+				}
+				else
+					emitRegReg(jit,op->kind == OP_ADD ? 0x01 : 0x29,HOST_EAX,HOST_ECX);
+				storeGuest(jit,op->r1,HOST_EAX);
+				if(isFlagNeeded(m,i,end))
+					emitFlags(jit,op->kind,HOST_EDX,HOST_ECX,0,HOST_EAX);
+				break;
+			case OP_DIV : case OP_MOD :
+				loadGuest(jit,HOST_EAX,op->r1);
+				loadGuest(jit,HOST_ECX,op->r2);
+				emit8(jit,0x85);		//test ecx,ecx
+				emit8(jit,0xC9);
+				skip = emitJcc(jit,CC_NE);
+				emitInterpretExit(jit,i,count-k);
+				patchHere(jit,skip);
+				emit8(jit,0x83);		//cmp ecx,-1
+				emit8(jit,0xF9);
+				emit8(jit,0xFF);
+				skip = emitJcc(jit,CC_NE);
+				emit8(jit,0x3D);		//cmp eax,0x80000000
+				emit32(jit,0x80000000u);
+				other = emitJcc(jit,CC_NE);
+				emitInterpretExit(jit,i,count-k);
+				patchHere(jit,skip);
+				patchHere(jit,other);
+				emitRegReg(jit,0x89,HOST_ESI,HOST_EAX);
+				emit8(jit,0x99);		//cdq
+				emit8(jit,0xF7);		//idiv ecx
+				emit8(jit,0xF9);
+				storeGuest(jit,op->r1,op->kind == OP_DIV ? HOST_EAX : HOST_EDX);
+				if(isFlagNeeded(m,i,end))
+					emitFlags(jit,op->kind,HOST_ESI,HOST_ECX,0,op->kind == OP_DIV ? HOST_EAX : HOST_EDX);
+				break;
+			case OP_NOT : case OP_INC : case OP_DEC :
+				loadGuest(jit,HOST_EAX,op->r1);
+				emitRegReg(jit,0x89,HOST_EDX,HOST_EAX);
+				emit8(jit,op->kind == OP_NOT ? 0xF7 : 0x83);
+				emit8(jit,op->kind == OP_NOT ? 0xD0 : op->kind == OP_INC ? 0xC0 : 0xE8);
+				if(op->kind != OP_NOT)
+					emit8(jit,1);
+				storeGuest(jit,op->r1,HOST_EAX);
+				if(isFlagNeeded(m,i,end))
+					emitFlags(jit,op->kind,HOST_EDX,-1,op->kind == OP_NOT ? 0 : 1,HOST_EAX);
+				break;
+			case OP_NOP :
+				break;
+			case OP_JUM :
+				emitChain(jit,op->target);
+				break;
+			case OP_JZR :
+				loadGuest(jit,HOST_EAX,op->r1);
+				emit8(jit,0x85);		//test eax,eax
+				emit8(jit,0xC0);
+				skip = emitJcc(jit,CC_NE);
+				emitChain(jit,op->target);
+				patchHere(jit,skip);
+				emitChain(jit,i+1);
+				break;
+			case OP_JMZ :
+				emit8(jit,0x83);		//cmp dword [rbx+flagOp],-1
+				emit8(jit,0xBB);
+				emit32(jit,offsetof(machine,flagOp));
+				emit8(jit,0xFF);
+				skip = emitJcc(jit,CC_E);
+				emit8(jit,0x83);		//cmp dword [rbx+flagResult],0
+				emit8(jit,0xBB);
+				emit32(jit,offsetof(machine,flagResult));
+				emit8(jit,0);
+				other = emitJcc(jit,CC_NE);
+				emitChain(jit,op->target);
+				patchHere(jit,skip);
+				patchHere(jit,other);
+				emitChain(jit,i+1);
+				break;
+			case OP_JMC : case OP_JMP :
+			{
+				const unsigned char callCode[] = {0x41, 0x50, 0x41, 0x51, 0x41, 0x52, 0x41, 0x53,
+					0x48, 0x89, 0xDF, 0x48, 0xB8};				//push r8..r11; mov rdi,rbx; mov rax,
+				const unsigned char returnCode[] = {0xFF, 0xD0, 0x41, 0x5B, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58};
+				unsigned long long helper = (unsigned long long)&jitFlags;
+				memcpy(jit->buffer+jit->used,callCode,sizeof(callCode));
+				jit->used += sizeof(callCode);
+				memcpy(jit->buffer+jit->used,&helper,8);
+				jit->used += 8;
+				memcpy(jit->buffer+jit->used,returnCode,sizeof(returnCode));	//call rax; pop r11..r8
+				jit->used += sizeof(returnCode);
+				emit8(jit,0xA9);		//test eax,flag
+				emit32(jit,op->kind == OP_JMC ? FLAG_C : FLAG_P);
+				skip = emitJcc(jit,CC_E);
+				emitChain(jit,op->target);
+				patchHere(jit,skip);
+				emitChain(jit,i+1);
+				break;
+			}
+			case OP_LOP :
+				loadGuest(jit,HOST_EAX,op->r1);
+				emit8(jit,0x85);		//test eax,eax
+				emit8(jit,0xC0);
+				skip = emitJcc(jit,CC_NE);
+				emitChain(jit,op->target);
+				patchHere(jit,skip);
+				emitField(jit,0x8B,HOST_ECX,offsetof(machine,loopDepth));
+				emit8(jit,0x81);		//cmp ecx,MAX_LOOP_DEPTH
+				emit8(jit,0xF9);
+				emit32(jit,MAX_LOOP_DEPTH);
+				skip = emitJcc(jit,CC_NE);
+				emitInterpretExit(jit,i,count-k);
+				patchHere(jit,skip);
+				emitIndexed(jit,0x89,HOST_EAX,offsetof(machine,loopStack));
+				emit8(jit,0x83);		//add ecx,1
+				emit8(jit,0xC1);
+				emit8(jit,1);
+				emitField(jit,0x89,HOST_ECX,offsetof(machine,loopDepth));
+				emitChain(jit,i+1);
+				break;
+			case OP_ELP :
+				emitField(jit,0x8B,HOST_ECX,offsetof(machine,loopDepth));
+				emit8(jit,0x85);		//test ecx,ecx
+				emit8(jit,0xC9);
+				skip = emitJcc(jit,CC_NE);
+				emitInterpretExit(jit,i,count-k);
+				patchHere(jit,skip);
+				emitIndexed(jit,0xFF,1,offsetof(machine,loopStack)-4);		//dec dword [rbx+rcx*4+top]
+				skip = emitJcc(jit,CC_E);
+				emitChain(jit,op->target);
+				patchHere(jit,skip);
+				emit8(jit,0x83);		//sub ecx,1
+				emit8(jit,0xE9);
+				emit8(jit,1);
+				emitField(jit,0x89,HOST_ECX,offsetof(machine,loopDepth));
+				emitChain(jit,i+1);
+				break;
+			default :					//HLT and errors are left to interpreter
+				emitInterpretExit(jit,i,count-k);
+		}
+	}
+	if(!isEnd)
+		emitChain(jit,end);
+
+	//Blocks which were waiting for this one now jump straight to it
+	jit->translation[start] = code;
+	for(k=0;k<(int)jit->pending[start].size();k++)
+	{
+		unsigned char *stub = jit->pending[start][k];
+		int rel = (int)(code - (stub+5));
+		stub[0] = 0xE9;
+		memcpy(stub+1,&rel,4);
+	}
+	jit->pending[start].clear();
+	return code;
+}
+
+
+/**
+ *Function to run a machine by translating its blocks into x86-64 code
+ *Instructions left by translated code are run one at a time by interpreter, all
+ *translations are dropped when the program writes into itself
+ *@param 	machine* m 						//Machine
+ *@param 	bool isSingleBlock 				//Return after one block (and its interpreted instruction)
+ *@return Status of machine (SIM_XXX)
+ */
+int runJit(machine * m, bool isSingleBlock)
+{
+	unsigned char *code;
+	unsigned int pc;
+	unsigned long long version;
+
+	if(!m->jit)
+	{
+		createJit(m);
+		m->jit->isChaining = !isSingleBlock;
+	}
+	m->status = SIM_RUNNING;
+	while(1)
+	{
+		code = m->jit->translation[m->pc];
+		if(!code)
+			code = translateBlock(m,m->pc);
+		pc = m->jit->enter(m,code);
+		m->pc = pc & ~JIT_INTERPRET;
+		if(pc & JIT_INTERPRET)
+		{
+			version = m->codeVersion;
+			if(run(m,1) != SIM_STEP_LIMIT)
+				return m->status;
+			m->status = SIM_RUNNING;
+			if(m->codeVersion != version)
+				flushJit(m);
+		}
+		if(isSingleBlock)
+			return m->status;
+	}
+}
+
+#else
+
+int runJit(machine * m, bool isSingleBlock)
+{
+	fprintf(stderr,"cass-sim: JIT needs an x86-64 host, using interpreter\n");
+	return run(m,0);
+}
+
+#endif
+
+
+/**
+ *Function to compare state of two machines
+ *@param 	machine* a 						//Machine run by interpreter
+ *@param 	machine* b 						//Machine run by JIT
+ *@param 	int pc 							//Word where block of JIT started
+ *@return true if both machines are same
+ */
+bool compareMachines(const machine * a, const machine * b, int pc)
+{
+	const char *field = NULL;
+	int i;
+
+	if(a->pc != b->pc)
+		field = "pc";
+	else if(a->steps != b->steps)
+		field = "instruction count";
+	else if(memcmp(a->regs,b->regs,sizeof(a->regs)))
+		field = "registers";
+	else if(currentFlags(a) != currentFlags(b))
+		field = "flags";
+	else if(a->loopDepth != b->loopDepth || memcmp(a->loopStack,b->loopStack,sizeof(unsigned int)*a->loopDepth))
+		field = "loop stack";
+	else if(memcmp(a->memory,b->memory,sizeof(a->memory)))
+		field = "memory";
+	if(!field)
+		return true;
+	fprintf(stderr,"cass-sim: JIT and interpreter differ in %s after block at address %d\n",field,pc*4);
+	printf("Interpreter: pc %d, %llu instructions\n",a->pc*4,a->steps);
+	printState(a,false);
+	printf("JIT: pc %d, %llu instructions\n",b->pc*4,b->steps);
+	printState(b,false);
+	for(i=0;i<MAX_IMAGE_WORDS;i++)
+		if(a->memory[i] != b->memory[i])
+			printf("%04XH : %d / %d\n",i,(int)a->memory[i],(int)b->memory[i]);
+	return false;
+}
+
+
+/**
+ *Function to run a program with JIT one block at a time and interpreter for the same
+ *number of instructions, comparing both machines after every block
+ *@param 	const char* imageFileName 		//Name of image file
+ *@param 	const char* memoryFileName 		//Name of memory file, NULL if none
+ *@return 0 if both agree till the end, 1 otherwise
+ */
+int diffTest(const char * imageFileName, const char * memoryFileName)
+{
+	machine *reference = createMachine(),*test = createMachine();
+	unsigned long long blocks=0,before;
+	int pc,status;
+
+	if(!loadImage(reference,imageFileName) || !loadImage(test,imageFileName))
+		return 1;
+	if(memoryFileName && (!loadMemory(reference,memoryFileName) || !loadMemory(test,memoryFileName)))
+		return 1;
+	while(1)
+	{
+		pc = test->pc;
+		before = test->steps;
+		status = runJit(test,true);
+		run(reference,test->steps-before);
+		blocks++;
+		if(reference->status == SIM_STEP_LIMIT)
+			reference->status = SIM_RUNNING;
+		if(!compareMachines(reference,test,pc))
+			return 1;
+		if(reference->status != status)
+		{
+			fprintf(stderr,"cass-sim: JIT stopped with \"%s\", interpreter with \"%s\" after block at address %d\n",
+				statusMessage[status],statusMessage[reference->status],pc*4);
+			return 1;
+		}
+		if(status != SIM_RUNNING || (maxSteps && test->steps >= maxSteps))
+			break;
+	}
+	printf("JIT and interpreter agree after %llu blocks and %llu instructions (%s)\n",blocks,test->steps,statusMessage[status]);
+	return 0;
+}
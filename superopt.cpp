@@ -0,0 +1,493 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-SUPEROPT : Superoptimizer for short straight-line sequences						****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Enumerates sequences of MVR, ADD, SUB, MUL, DIV, MOD, NOT, INC, DEC and MOI
+ *				and finds, for each sequence, the cheapest sequence computing the same
+ *				registers. Results are written as a rewrite database which cass applies
+ *				with --rewrites
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<string>
+#include<vector>
+#include<algorithm>
+#include<unordered_map>
+#include<unordered_set>
+#include<thread>
+#include<mutex>
+#include "isa.h"
+
+/**
+ *Macros
+ */
+#define MAX_LENGTH 6					//Specifies max length of an enumerated sequence
+#define MAX_VARIABLES 4					//Specifies max number of registers used by a sequence
+#define MAX_CONSTANTS 16				//Specifies max number of constants tried with MOI
+#define TEST_COUNT 16					//Specifies number of random inputs used for fingerprint
+#define DOMAIN_SIZE 13					//Specifies number of values of every register in exhaustive check
+
+using namespace std;
+
+
+/**
+ *Structure to hold an enumerated sequence
+ *@int Number of instructions
+ *@int Index of every instruction in "candidates"
+ *@int Size of sequence in bytes
+ */
+struct sequence {
+	int length;
+	int ins[MAX_LENGTH];
+	int cost;
+};
+
+typedef struct sequence sequence;
+
+
+/**
+ *Structure to hold a rewrite found by the superoptimizer
+ */
+struct rewrite {
+	sequence pattern;
+	sequence replacement;
+};
+
+typedef struct rewrite rewrite;
+
+
+/**
+ *Global Variables
+ */
+int maxLength=3,variableCount=3,threadCount=0,verbosFlag=0;
+int constants[MAX_CONSTANTS] = {0, 1, -1};
+int constantCount=3;
+vector<instruction> candidates;							//Every instruction which may appear in a sequence
+unsigned int testInput[TEST_COUNT][MAX_VARIABLES];		//Random inputs used for fingerprints
+vector<sequence> representatives;						//Cheapest sequence of every function found
+unordered_map<unsigned long long, vector<int> > functionTable;	//Fingerprint to index in "representatives"
+unordered_set<string> irreducible[MAX_LENGTH+1];		//Sequences of each length with no cheaper equivalent
+vector<rewrite> rewrites;
+mutex rewriteLock;
+
+
+/**
+ *Function declarations
+ */
+void buildCandidates(void);
+bool execute(const sequence * , unsigned int * );
+unsigned long long fingerprint(const sequence * );
+bool isEquivalent(const sequence * , const sequence * );
+bool isCanonical(const sequence * );
+string sequenceKey(const sequence * , int , int );
+bool isMinimal(const sequence * );
+void searchSlice(int , int , vector<pair<unsigned long long,sequence> > * );
+void printSequence(FILE * , const sequence * );
+
+
+/**
+ *Accepting command line arguments for search limits and database file
+ */
+int main(int argc, char const *argv[])
+{
+	int i,length;
+	unsigned long long total;
+	const char *outputFileName = "rewrites.db";
+	char *token,list[256];
+	FILE *fileOut;
+
+	for(i=1;i<argc;i++)
+	{
+		if(!strcmp(argv[i],"--help"))
+		{
+			printf("\n\t\tcass-superopt: Usage: %s [options]\n\t\t[options]\t-l N \t Max length of sequences (default 3)\n",argv[0]);
+			printf("\t\t\t\t-r N \t Number of registers used by sequences (default 3)\n\t\t\t\t-c LIST \t Comma separated constants tried with MOI (default 0,1,-1)\n");
+			printf("\t\t\t\t-j N \t Number of threads (default all cores)\n\t\t\t\t-o FILE \t Rewrite database to write (default rewrites.db)\n\t\t\t\t-v \t For verbose output\n\n");
+			return 0;
+		}
+		else if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(i+1 < argc && !strcmp(argv[i],"-l"))
+			maxLength = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i],"-r"))
+			variableCount = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i],"-j"))
+			threadCount = atoi(argv[++i]);
+		else if(i+1 < argc && !strcmp(argv[i],"-o"))
+			outputFileName = argv[++i];
+		else if(i+1 < argc && !strcmp(argv[i],"-c"))
+		{
+			strncpy(list,argv[++i],sizeof(list)-1);
+			list[sizeof(list)-1] = '\0';
+			constantCount = 0;
+			for(token=strtok(list,",");token && constantCount<MAX_CONSTANTS;token=strtok(NULL,","))
+				constants[constantCount++] = atoi(token);
+		}
+		else
+		{
+			fprintf(stderr,"cass-superopt: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+	if(maxLength < 1 || maxLength > MAX_LENGTH || variableCount < 1 || variableCount > MAX_VARIABLES)
+	{
+		fprintf(stderr,"cass-superopt: Length must be 1 to %d and registers 1 to %d\n",MAX_LENGTH,MAX_VARIABLES);
+		return 1;
+	}
+	if(threadCount <= 0)
+		threadCount = thread::hardware_concurrency() ? thread::hardware_concurrency() : 1;
+
+	srand(1);
+	for(i=0;i<TEST_COUNT;i++)
+		for(length=0;length<MAX_VARIABLES;length++)
+			testInput[i][length] = i < 2 ? i*7+length : ((unsigned int)rand()<<16) ^ (unsigned int)rand();
+	buildCandidates();
+
+	//Empty sequence is the cheapest way to leave registers unchanged
+	sequence empty;
+	empty.length = empty.cost = 0;
+	representatives.push_back(empty);
+	functionTable[fingerprint(&empty)].push_back(0);
+	irreducible[0].insert(sequenceKey(&empty,0,0));
+
+	for(length=1;length<=maxLength;length++)
+	{
+		vector<thread> workers;
+		vector<vector<pair<unsigned long long,sequence> > > found(threadCount);
+		for(i=0;i<threadCount;i++)
+			workers.push_back(thread(searchSlice,length,i,&found[i]));
+		for(i=0;i<threadCount;i++)
+			workers[i].join();
+
+		//Sequences with no cheaper equivalent become representatives, cheapest first
+		vector<pair<unsigned long long,sequence> > merged;
+		for(i=0;i<threadCount;i++)
+			merged.insert(merged.end(),found[i].begin(),found[i].end());
+		sort(merged.begin(),merged.end(),[](const pair<unsigned long long,sequence> &a, const pair<unsigned long long,sequence> &b)
+			{ return a.second.cost < b.second.cost; });
+		total = 0;
+		for(i=0;i<(int)merged.size();i++)
+		{
+			vector<int> &same = functionTable[merged[i].first];
+			int match = -1;
+			for(int j=0;j<(int)same.size() && match == -1;j++)
+				if(isEquivalent(&merged[i].second,&representatives[same[j]]))
+					match = same[j];
+			if(match != -1 && representatives[match].cost < merged[i].second.cost)
+			{
+				rewrite found = {merged[i].second, representatives[match]};
+				rewrites.push_back(found);
+				continue;
+			}
+			irreducible[length].insert(sequenceKey(&merged[i].second,0,length));
+			if(match == -1)
+			{
+				same.push_back(representatives.size());
+				representatives.push_back(merged[i].second);
+				total++;
+			}
+		}
+		printf("Length %d: %llu new functions, %d rewrites so far\n",length,total,(int)rewrites.size());
+	}
+
+	fileOut = fopen(outputFileName,"w");
+	if(!fileOut)
+	{
+		fprintf(stderr,"cass-superopt: Could not open \"%s\"\n",outputFileName);
+		return 1;
+	}
+	sort(rewrites.begin(),rewrites.end(),[](const rewrite &a, const rewrite &b)
+		{ return a.pattern.length != b.pattern.length ? a.pattern.length < b.pattern.length : a.pattern.cost > b.pattern.cost; });
+	fprintf(fileOut,"; cass superoptimizer rewrite database\n; %d registers, sequences upto %d instructions\n; pattern => replacement, applied where flags are not read afterwards\n",variableCount,maxLength);
+	for(i=0;i<(int)rewrites.size();i++)
+	{
+		printSequence(fileOut,&rewrites[i].pattern);
+		fprintf(fileOut," =>");
+		if(rewrites[i].replacement.length)
+			fprintf(fileOut," ");
+		printSequence(fileOut,&rewrites[i].replacement);
+		fprintf(fileOut,"\n");
+	}
+	fclose(fileOut);
+	printf("Rewrite database with %d rewrites written to file \"%s\" \n",(int)rewrites.size(),outputFileName);
+	return 0;
+}
+
+
+/**
+ *Function to list every instruction which may appear in a sequence
+ *Registers are numbered 0 to variableCount-1
+ *@return void
+ */
+void buildCandidates(void)
+{
+	const int twoRegOps[] = {OP_MVR, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD};
+	const int oneRegOps[] = {OP_NOT, OP_INC, OP_DEC};
+	instruction ins;
+	int i,r1,r2;
+
+	ins.addr = -1;
+	ins.data = 0;
+	for(i=0;i<6;i++)
+		for(r1=0;r1<variableCount;r1++)
+			for(r2=0;r2<variableCount;r2++)
+			{
+				ins.op = twoRegOps[i];
+				ins.reg1 = r1;
+				ins.reg2 = r2;
+				candidates.push_back(ins);
+			}
+	ins.reg2 = -1;
+	for(i=0;i<3;i++)
+		for(r1=0;r1<variableCount;r1++)
+		{
+			ins.op = oneRegOps[i];
+			ins.reg1 = r1;
+			candidates.push_back(ins);
+		}
+	for(i=0;i<constantCount;i++)
+		for(r1=0;r1<variableCount;r1++)
+		{
+			ins.op = OP_MOI;
+			ins.reg1 = r1;
+			ins.data = constants[i];
+			candidates.push_back(ins);
+		}
+}
+
+
+/**
+ *Function to run a sequence on some register values
+ *@param 	sequence* seq 					//Sequence to run
+ *@param 	unsigned int* regs 				//Registers, updated in place
+ *@return false if sequence traps
+ */
+bool execute(const sequence * seq, unsigned int * regs)
+{
+	int i;
+	const instruction *ins;
+	for(i=0;i<seq->length;i++)
+	{
+		ins = &candidates[seq->ins[i]];
+		if(ins->op == OP_MOI)
+			regs[ins->reg1] = ins->data;
+		else if(!evaluateAlu(ins->op,regs[ins->reg1],ins->reg2 == -1 ? 0 : regs[ins->reg2],&regs[ins->reg1]))
+			return false;
+	}
+	return true;
+}
+
+
+/**
+ *Function to compute fingerprint of a sequence by running it on "testInput"
+ *@param 	sequence* seq 					//Sequence
+ *@return Hash of all results
+ */
+unsigned long long fingerprint(const sequence * seq)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned int regs[MAX_VARIABLES];
+	int i,j;
+	for(i=0;i<TEST_COUNT;i++)
+	{
+		memcpy(regs,testInput[i],sizeof(regs));
+		if(!execute(seq,regs))
+		{
+			hash = (hash ^ 0xDEAD) * 1099511628211ULL;
+			continue;
+		}
+		for(j=0;j<variableCount;j++)
+			hash = (hash ^ regs[j]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+
+/**
+ *Function to check two sequences on every combination of register values of a small domain
+ *Domain contains small numbers around zero and the extreme values of a register
+ *@param 	sequence* a 					//First sequence
+ *@param 	sequence* b 					//Second sequence
+ *@return true if both give same registers (or both trap) for every input
+ */
+bool isEquivalent(const sequence * a, const sequence * b)
+{
+	const unsigned int domain[DOMAIN_SIZE] = {0, 1, 2, 3, 0xFFFFFFFFu, 0xFFFFFFFEu, 0xFFFFFFFDu,
+		0x7FFFFFFFu, 0x80000000u, 0x80000001u, 0x10000u, 0x12345678u, 0xFFFFu};
+	unsigned int regsA[MAX_VARIABLES],regsB[MAX_VARIABLES];
+	int index[MAX_VARIABLES]={0},i;
+	bool isTrapA,isTrapB;
+
+	while(1)
+	{
+		for(i=0;i<variableCount;i++)
+			regsA[i] = regsB[i] = domain[index[i]];
+		isTrapA = !execute(a,regsA);
+		isTrapB = !execute(b,regsB);
+		if(isTrapA != isTrapB || (!isTrapA && memcmp(regsA,regsB,sizeof(unsigned int)*variableCount)))
+			return false;
+		for(i=0;i<variableCount && ++index[i] == DOMAIN_SIZE;i++)
+			index[i] = 0;
+		if(i == variableCount)
+			return true;
+	}
+}
+
+
+/**
+ *Function to check if registers of a sequence are numbered in order of first use
+ *Other sequences are renamings of a canonical one and need not be searched
+ *@param 	sequence* seq 					//Sequence
+ *@return true if sequence is canonical
+ */
+bool isCanonical(const sequence * seq)
+{
+	int i,next=0,reg[2],j;
+	for(i=0;i<seq->length;i++)
+	{
+		reg[0] = candidates[seq->ins[i]].reg1;
+		reg[1] = candidates[seq->ins[i]].reg2;
+		for(j=0;j<2;j++)
+		{
+			if(reg[j] > next)
+				return false;
+			if(reg[j] == next)
+				next++;
+		}
+	}
+	return true;
+}
+
+
+/**
+ *Function to make a key for part of a sequence, registers renamed in order of first use
+ *@param 	sequence* seq 					//Sequence
+ *@param 	int start 						//First instruction of part
+ *@param 	int end 						//Instruction following part
+ *@return Key of part
+ */
+string sequenceKey(const sequence * seq, int start, int end)
+{
+	int rename[MAX_VARIABLES],next=0,i;
+	const instruction *ins;
+	char text[32];
+	string key;
+
+	for(i=0;i<MAX_VARIABLES;i++)
+		rename[i] = -1;
+	for(i=start;i<end;i++)
+	{
+		ins = &candidates[seq->ins[i]];
+		if(rename[ins->reg1] == -1)
+			rename[ins->reg1] = next++;
+		if(ins->reg2 != -1 && rename[ins->reg2] == -1)
+			rename[ins->reg2] = next++;
+		sprintf(text,"%d %d %d %d;",ins->op,rename[ins->reg1],ins->reg2 == -1 ? -1 : rename[ins->reg2],ins->data);
+		key += text;
+	}
+	return key;
+}
+
+
+/**
+ *Function to check that a sequence does not start or end with a sequence having a cheaper equivalent
+ *Such a sequence is covered by the rewrite of its shorter part
+ *@param 	sequence* seq 					//Sequence
+ *@return true if both its prefix and suffix are irreducible
+ */
+bool isMinimal(const sequence * seq)
+{
+	int length = seq->length-1;
+	return irreducible[length].count(sequenceKey(seq,0,length)) && irreducible[length].count(sequenceKey(seq,1,seq->length));
+}
+
+
+/**
+ *Function to search one slice of all sequences of a length
+ *Sequence with a cheaper equivalent becomes a rewrite, others are returned to be merged
+ *@param 	int length 						//Length of sequences
+ *@param 	int slice 						//Sequences whose first instruction is slice modulo threadCount
+ *@param 	vector* found 					//Sequences with no cheaper equivalent, with their fingerprint
+ *@return void
+ */
+void searchSlice(int length, int slice, vector<pair<unsigned long long,sequence> > * found)
+{
+	sequence seq;
+	unsigned long long hash;
+	int i,j,count = candidates.size();
+	unordered_map<unsigned long long, vector<int> >::const_iterator same;
+
+	seq.length = length;
+	for(i=0;i<length;i++)
+		seq.ins[i] = 0;
+	seq.ins[0] = slice;
+	while(seq.ins[0] < count)
+	{
+		if(isCanonical(&seq) && isMinimal(&seq))
+		{
+			seq.cost = 0;
+			for(i=0;i<length;i++)
+				seq.cost += instructionSize(candidates[seq.ins[i]].op);
+			hash = fingerprint(&seq);
+			same = functionTable.find(hash);
+			j = -1;
+			if(same != functionTable.end())
+				for(i=0;i<(int)same->second.size() && j == -1;i++)
+					if(representatives[same->second[i]].cost < seq.cost && isEquivalent(&seq,&representatives[same->second[i]]))
+						j = same->second[i];
+			if(j != -1)
+			{
+				rewrite result = {seq, representatives[j]};
+				lock_guard<mutex> guard(rewriteLock);
+				rewrites.push_back(result);
+				if(verbosFlag)
+				{
+					printSequence(stdout,&seq);
+					printf(" => ");
+					printSequence(stdout,&representatives[j]);
+					printf("\n");
+				}
+			}
+			else
+				found->push_back(make_pair(hash,seq));
+		}
+		//Next sequence, first instruction moves by number of threads
+		for(i=length-1;i>0 && ++seq.ins[i] == count;i--)
+			seq.ins[i] = 0;
+		if(i == 0)
+			seq.ins[0] += threadCount;
+	}
+}
+
+
+/**
+ *Function to print a sequence in the format of rewrite database
+ *Registers are written as %0, %1 and instructions are separated by '|'
+ *@param 	FILE* fileOut 					//Output file
+ *@param 	sequence* seq 					//Sequence
+ *@return void
+ */
+void printSequence(FILE * fileOut, const sequence * seq)
+{
+	int i;
+	const instruction *ins;
+	for(i=0;i<seq->length;i++)
+	{
+		ins = &candidates[seq->ins[i]];
+		if(i)
+			fprintf(fileOut," | ");
+		fprintf(fileOut,"%s %%%d",mneumonicName[ins->op],ins->reg1);
+		if(ins->reg2 != -1)
+			fprintf(fileOut,",%%%d",ins->reg2);
+		if(ins->op == OP_MOI)
+			fprintf(fileOut,",%d",ins->data);
+	}
+}
@@ -0,0 +1,101 @@
+/**
+ *******************************************************************************************************************
+ *						CASS : Symbol files written by cass -g												****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Reading of out_file.sym, which holds labels and source line of every
+ *				address of an image, for cass-sim and other tools
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include<cstdio>
+#include<cstring>
+#include<string>
+#include<vector>
+
+/**
+ *Structure to hold contents of a symbol file
+ *@string Name of source file, empty if not known
+ *@vector Name and byte address of every label, in order of address
+ *@vector Source line number of every word, 0 if not known
+ *@vector Source text of every word
+ */
+struct debugInfo {
+	std::string sourceFile;
+	std::vector<std::string> labelName;
+	std::vector<int> labelAddress;
+	std::vector<int> line;
+	std::vector<std::string> source;
+};
+
+typedef struct debugInfo debugInfo;
+
+
+/**
+ *Function to read a symbol file
+ *Lines are "SOURCE name", "LABEL name address" and "LINE address line source", ';' starts a comment line
+ *@param 	const char* fileName			//Name of symbol file
+ *@param 	debugInfo* info					//Contents of file
+ *@param 	int words 						//Number of words of image
+ *@return false if file could not be read
+ */
+inline bool readSymbols(const char * fileName, debugInfo * info, int words)
+{
+	FILE *fileSymbols;
+	char text[256],name[64];
+	int address,number,offset,i,j;
+
+	fileSymbols = fopen(fileName,"r");
+	if(!fileSymbols)
+		return false;
+	info->sourceFile.clear();
+	info->labelName.clear();
+	info->labelAddress.clear();
+	info->line.assign(words,0);
+	info->source.assign(words,std::string());
+	while(fgets(text,sizeof(text),fileSymbols))
+	{
+		text[strcspn(text,"\r\n")] = '\0';
+		if(!strncmp(text,"SOURCE ",7))
+			info->sourceFile = text+7;
+		else if(sscanf(text,"LABEL %63s %d",name,&address) == 2)
+		{
+			//Kept sorted by address, labels at same address stay in order of file
+			for(i=info->labelAddress.size();i>0 && info->labelAddress[i-1] > address;i--)
+				;
+			info->labelName.insert(info->labelName.begin()+i,name);
+			info->labelAddress.insert(info->labelAddress.begin()+i,address);
+		}
+		else if(sscanf(text,"LINE %d %d %n",&address,&number,&offset) == 2 && address >= 0 && address/4 < words)
+		{
+			j = address/4;
+			info->line[j] = number;
+			info->source[j] = text+offset;
+		}
+	}
+	fclose(fileSymbols);
+	return true;
+}
+
+
+/**
+ *Function to find the label under which an address lies
+ *@param 	debugInfo* info					//Contents of symbol file
+ *@param 	int address 					//Byte address
+ *@return Index of last label at or before address, -1 if none
+ */
+inline int labelOf(const debugInfo * info, int address)
+{
+	int i;
+	for(i=info->labelAddress.size()-1;i>=0 && info->labelAddress[i] > address;i--)
+		;
+	return i;
+}
+
+#endif
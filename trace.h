@@ -0,0 +1,459 @@
+/**
+ *******************************************************************************************************************
+ *						CASS : Binary execution traces written by cass-sim										****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Format of --trace files. Every executed instruction is a record of its
+ *				address, word, register written and memory accessed. Records are delta
+ *				encoded against the previous one, grouped in blocks which start with the
+ *				registers, and every block is compressed with a small LZ77 coder. An index
+ *				of blocks at the end of file allows seeking by instruction count
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include<cstdio>
+#include<cstring>
+#include<vector>
+#include "isa.h"
+
+/**
+ *Macros
+ */
+#define TRACE_MAGIC "CASSTRC1"			//First 8 bytes of a trace file
+#define TRACE_INDEX_MAGIC "CASSIDX1"	//Last 8 bytes of a trace file which was closed properly
+#define TRACE_BLOCK_EVENTS 65536		//Specifies number of records in a block
+#define TRACE_REGS 28					//Specifies number of registers in a block header
+#define TRACE_BLOCK_HEADER 20			//Bytes of raw size, stored size, first step and records before a block
+#define TRACE_FOOTER 20					//Bytes of index offset, number of blocks and index magic
+#define TRACE_NO_REG 0xFF				//Register field of a record which writes no register
+#define TRACE_LZ_HASH 12				//Bits of hash of 4 bytes used to find matches
+#define TRACE_LZ_MIN 4					//Specifies shortest match coded by LZ77
+
+//Bits of first byte of a record
+#define TRACE_JUMPED 1					//Address is not the one following previous record
+#define TRACE_NEW_WORD 2				//Word differs from the one last seen at this address in block
+#define TRACE_REG 4						//A register was written
+#define TRACE_READ 8					//Memory was read
+#define TRACE_WRITE 16					//Memory was written
+
+
+/**
+ *Structure to hold one executed instruction
+ *@unsigned int Index of word executed
+ *@unsigned int Word executed
+ *@unsigned char Register written, TRACE_NO_REG if none
+ *@unsigned char TRACE_READ, TRACE_WRITE or 0
+ *@unsigned int Value written in register
+ *@unsigned int Address of memory accessed
+ *@unsigned int Value read or written
+ */
+struct traceEvent {
+	unsigned int pc;
+	unsigned int word;
+	unsigned char reg;
+	unsigned char memory;
+	unsigned int regValue;
+	unsigned int address;
+	unsigned int value;
+};
+
+typedef struct traceEvent traceEvent;
+
+
+/**
+ *Structure to hold state shared by records of a block, kept alike by encoder and decoder
+ *@unsigned int Registers after previous record
+ *@unsigned int Word last seen at every address, valid where "seen" equals "generation"
+ *@unsigned char Words taken by instruction at every address, kept with "words"
+ *@unsigned int Address expected for next record
+ *@unsigned int Address of previous memory access
+ */
+struct traceState {
+	unsigned int regs[TRACE_REGS];
+	unsigned int words[MAX_IMAGE_WORDS];
+	unsigned char sizes[MAX_IMAGE_WORDS];
+	unsigned int seen[MAX_IMAGE_WORDS];
+	unsigned int generation;
+	unsigned int expected;
+	unsigned int address;
+};
+
+typedef struct traceState traceState;
+
+
+/**
+ *Function to append an unsigned number in 7 bit groups, low group first
+ *@param 	vector<unsigned char>& out 		//Buffer
+ *@param 	unsigned long long value 		//Number
+ *@return void
+ */
+inline void putVarint(std::vector<unsigned char> & out, unsigned long long value)
+{
+	while(value >= 0x80)
+	{
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+
+/**
+ *Function to read a number written by putVarint
+ *@param 	const unsigned char** in 		//Position in buffer, moved past number
+ *@param 	const unsigned char* end 		//End of buffer
+ *@param 	unsigned long long* value 		//Number
+ *@return false if buffer ended in between
+ */
+inline bool getVarint(const unsigned char ** in, const unsigned char * end, unsigned long long * value)
+{
+	int shift;
+	*value = 0;
+	for(shift=0;*in < end && shift < 64;shift += 7)
+	{
+		*value |= (unsigned long long)(**in & 0x7F) << shift;
+		if(!(*(*in)++ & 0x80))
+			return true;
+	}
+	return false;
+}
+
+
+/**
+ *Function to map a signed difference to an unsigned number, small magnitudes to small numbers
+ *@param 	unsigned int delta 				//Difference modulo 2^32
+ *@return Zigzag coded difference
+ */
+inline unsigned int zigzag(unsigned int delta)
+{
+	return (delta << 1) ^ (unsigned int)((int)delta >> 31);
+}
+
+
+/**
+ *Function to undo zigzag
+ *@param 	unsigned int value 				//Zigzag coded difference
+ *@return Difference modulo 2^32
+ */
+inline unsigned int unzigzag(unsigned int value)
+{
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+
+/**
+ *Function to start a block, its registers are written first
+ *@param 	traceState* state 				//Encoder or decoder state, registers must be set
+ *@param 	vector<unsigned char>* out 		//Block buffer, NULL for decoder
+ *@return void
+ */
+inline void beginTraceBlock(traceState * state, std::vector<unsigned char> * out)
+{
+	int i;
+	if(++state->generation == 0)			//Stamps wrapped around, old ones must not match
+	{
+		memset(state->seen,0,sizeof(state->seen));
+		state->generation = 1;
+	}
+	state->expected = 0;
+	state->address = 0;
+	if(out)
+	{
+		out->clear();
+		for(i=0;i<TRACE_REGS;i++)
+			putVarint(*out,state->regs[i]);
+	}
+}
+
+
+/**
+ *Function to find number of words taken by an instruction
+ *@param 	unsigned int word 				//Instruction word
+ *@return 2 for MOI, 1 otherwise
+ */
+inline unsigned char traceSize(unsigned int word)
+{
+	instruction ins;
+	return instructionSize(decodeWord(word,&ins))/4;
+}
+
+
+/**
+ *Function to append a record to a block
+ *@param 	traceState* state 				//Encoder state
+ *@param 	traceEvent* event 				//Executed instruction
+ *@param 	vector<unsigned char>& out 		//Block buffer
+ *@return void
+ */
+inline void encodeTraceEvent(traceState * state, const traceEvent * event, std::vector<unsigned char> & out)
+{
+	unsigned int pc = event->pc & (MAX_IMAGE_WORDS-1);
+	unsigned char bits = 0;
+
+	if(event->pc != state->expected)
+		bits |= TRACE_JUMPED;
+	if(state->seen[pc] != state->generation || state->words[pc] != event->word)
+		bits |= TRACE_NEW_WORD;
+	if(event->reg < TRACE_REGS)
+		bits |= TRACE_REG;
+	bits |= event->memory;
+	out.push_back(bits);
+
+	if(bits & TRACE_JUMPED)
+		putVarint(out,zigzag(event->pc - state->expected));
+	if(bits & TRACE_NEW_WORD)
+	{
+		putVarint(out,event->word);
+		state->words[pc] = event->word;
+		state->sizes[pc] = traceSize(event->word);
+		state->seen[pc] = state->generation;
+	}
+	if(bits & TRACE_REG)
+	{
+		out.push_back(event->reg);
+		putVarint(out,zigzag(event->regValue - state->regs[event->reg]));
+		state->regs[event->reg] = event->regValue;
+	}
+	if(event->memory)
+	{
+		putVarint(out,zigzag(event->address - state->address));
+		putVarint(out,event->value);
+		state->address = event->address;
+	}
+	state->expected = event->pc + state->sizes[pc];
+}
+
+
+/**
+ *Function to read a record of a block
+ *@param 	traceState* state 				//Decoder state
+ *@param 	const unsigned char** in 		//Position in block, moved past record
+ *@param 	const unsigned char* end 		//End of block
+ *@param 	traceEvent* event 				//Executed instruction
+ *@return false if block is corrupt
+ */
+inline bool decodeTraceEvent(traceState * state, const unsigned char ** in, const unsigned char * end, traceEvent * event)
+{
+	unsigned long long value;
+	unsigned char bits;
+	unsigned int pc;
+
+	if(*in >= end)
+		return false;
+	bits = *(*in)++;
+	event->pc = state->expected;
+	if(bits & TRACE_JUMPED)
+	{
+		if(!getVarint(in,end,&value))
+			return false;
+		event->pc += unzigzag((unsigned int)value);
+	}
+	pc = event->pc & (MAX_IMAGE_WORDS-1);
+	if(bits & TRACE_NEW_WORD)
+	{
+		if(!getVarint(in,end,&value))
+			return false;
+		state->words[pc] = (unsigned int)value;
+		state->sizes[pc] = traceSize(state->words[pc]);
+		state->seen[pc] = state->generation;
+	}
+	else if(state->seen[pc] != state->generation)
+		return false;
+	event->word = state->words[pc];
+	event->reg = TRACE_NO_REG;
+	if(bits & TRACE_REG)
+	{
+		if(*in >= end || **in >= TRACE_REGS)
+			return false;
+		event->reg = *(*in)++;
+		if(!getVarint(in,end,&value))
+			return false;
+		state->regs[event->reg] += unzigzag((unsigned int)value);
+		event->regValue = state->regs[event->reg];
+	}
+	event->memory = bits & (TRACE_READ | TRACE_WRITE);
+	if(event->memory)
+	{
+		if(!getVarint(in,end,&value))
+			return false;
+		state->address += unzigzag((unsigned int)value);
+		event->address = state->address;
+		if(!getVarint(in,end,&value))
+			return false;
+		event->value = (unsigned int)value;
+	}
+	state->expected = event->pc + state->sizes[pc];
+	return true;
+}
+
+
+/**
+ *Function to append a length of LZ77 sequence beyond what fits in its token
+ *@param 	unsigned char* out 				//Output position
+ *@param 	size_t length 					//Remaining length, 15 less than actual
+ *@return Output position after length
+ */
+inline unsigned char * putLzLength(unsigned char * out, size_t length)
+{
+	for(;length >= 255;length -= 255)
+		*out++ = 255;
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+
+/**
+ *Function to compress a block with LZ77
+ *Every sequence is a token of literal and match length, literals, 16 bit offset of
+ *match and extra length bytes. Last sequence holds only literals
+ *@param 	const unsigned char* in 		//Data
+ *@param 	size_t length 					//Bytes of data
+ *@param 	unsigned char* out 				//Output of at least length + length/255 + 16 bytes
+ *@return Bytes of output
+ */
+inline size_t compressLz(const unsigned char * in, size_t length, unsigned char * out)
+{
+	static thread_local int table[1<<TRACE_LZ_HASH];
+	const unsigned char *literal = in,*p = in,*end = in + length,*match;
+	unsigned char *start = out,*token;
+	unsigned int key;
+	size_t literals,matched;
+
+	for(key=0;key<(1u<<TRACE_LZ_HASH);key++)
+		table[key] = -1;
+	while(p + TRACE_LZ_MIN <= end)
+	{
+		memcpy(&key,p,4);
+		key = (key * 2654435761u) >> (32 - TRACE_LZ_HASH);
+		match = table[key] >= 0 ? in + table[key] : NULL;
+		table[key] = p - in;
+		if(!match || p - match > 0xFFFF || memcmp(match,p,TRACE_LZ_MIN))
+		{
+			p++;
+			continue;
+		}
+		for(matched=TRACE_LZ_MIN;p + matched < end && match[matched] == p[matched];matched++)
+			;
+		literals = p - literal;
+		token = out++;
+		*token = (unsigned char)((literals < 15 ? literals : 15) << 4 | (matched - TRACE_LZ_MIN < 15 ? matched - TRACE_LZ_MIN : 15));
+		if(literals >= 15)
+			out = putLzLength(out,literals - 15);
+		memcpy(out,literal,literals);
+		out += literals;
+		*out++ = (unsigned char)(p - match);
+		*out++ = (unsigned char)((p - match) >> 8);
+		if(matched - TRACE_LZ_MIN >= 15)
+			out = putLzLength(out,matched - TRACE_LZ_MIN - 15);
+		p += matched;
+		literal = p;
+	}
+	literals = end - literal;
+	*out++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+	if(literals >= 15)
+		out = putLzLength(out,literals - 15);
+	memcpy(out,literal,literals);
+	return out + literals - start;
+}
+
+
+/**
+ *Function to read a length of LZ77 sequence beyond what fits in its token
+ *@param 	const unsigned char** in 		//Input position, moved past length
+ *@param 	const unsigned char* end 		//End of input
+ *@param 	size_t* length 					//Length, 15 on call
+ *@return false if input ended in between
+ */
+inline bool getLzLength(const unsigned char ** in, const unsigned char * end, size_t * length)
+{
+	unsigned char byte;
+	do
+	{
+		if(*in >= end)
+			return false;
+		byte = *(*in)++;
+		*length += byte;
+	}while(byte == 255);
+	return true;
+}
+
+
+/**
+ *Function to decompress a block compressed by compressLz
+ *@param 	const unsigned char* in 		//Compressed data
+ *@param 	size_t length 					//Bytes of compressed data
+ *@param 	unsigned char* out 				//Output
+ *@param 	size_t size 					//Bytes of output expected
+ *@return false if data is corrupt
+ */
+inline bool decompressLz(const unsigned char * in, size_t length, unsigned char * out, size_t size)
+{
+	const unsigned char *end = in + length;
+	unsigned char *p = out,*outEnd = out + size;
+	size_t literals,matched,offset;
+
+	while(in < end)
+	{
+		literals = *in >> 4;
+		matched = (*in++ & 15) + TRACE_LZ_MIN;
+		if(literals == 15 && !getLzLength(&in,end,&literals))
+			return false;
+		if(literals > (size_t)(end - in) || literals > (size_t)(outEnd - p))
+			return false;
+		memcpy(p,in,literals);
+		p += literals;
+		in += literals;
+		if(in == end)						//Last sequence has no match
+			break;
+		if(end - in < 2)
+			return false;
+		offset = in[0] | in[1] << 8;
+		in += 2;
+		if(matched == 15 + TRACE_LZ_MIN && !getLzLength(&in,end,&matched))
+			return false;
+		if(offset == 0 || offset > (size_t)(p - out) || matched > (size_t)(outEnd - p))
+			return false;
+		for(;matched;matched--,p++)			//Byte by byte, match may overlap its output
+			*p = p[-offset];
+	}
+	return p == outEnd;
+}
+
+
+/**
+ *Function to write a number in little endian order
+ *@param 	unsigned char* out 				//Output
+ *@param 	unsigned long long value 		//Number
+ *@param 	int bytes 						//Bytes to write
+ *@return void
+ */
+inline void putLittle(unsigned char * out, unsigned long long value, int bytes)
+{
+	int i;
+	for(i=0;i<bytes;i++)
+		out[i] = (unsigned char)(value >> 8*i);
+}
+
+
+/**
+ *Function to read a number in little endian order
+ *@param 	const unsigned char* in 		//Input
+ *@param 	int bytes 						//Bytes to read
+ *@return Number
+ */
+inline unsigned long long getLittle(const unsigned char * in, int bytes)
+{
+	unsigned long long value = 0;
+	int i;
+	for(i=bytes-1;i>=0;i--)
+		value = value << 8 | in[i];
+	return value;
+}
+
+#endif
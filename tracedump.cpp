@@ -0,0 +1,275 @@
+/**
+ *******************************************************************************************************************
+ *						CASS-TRACE : Decoder of binary traces written by cass-sim --trace						****
+ *******************************************************************************************************************
+ *					  **LICENSED UNDER GNU GENERAL PUBLIC LICENSE**
+ *
+ *@description Prints records of a trace as text, one executed instruction on every line,
+ *				starting from any instruction count. Only the block holding that count is
+ *				read and decoded, found through the index at the end of trace
+ *@authors 	Shivam Dixit, Ritesh Agrawal
+ *
+ *******************************************************************************************************************
+ */
+
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<vector>
+#include "isa.h"
+#include "trace.h"
+
+using namespace std;
+
+
+/**
+ *Structure to hold position of a block in trace file
+ *@unsigned long long Step of first record of block
+ *@unsigned long long Offset of block header in file
+ */
+struct blockEntry {
+	unsigned long long firstStep;
+	unsigned long long offset;
+};
+
+typedef struct blockEntry blockEntry;
+
+
+/**
+ *Global Variables
+ */
+int verbosFlag=0;
+vector<blockEntry> blocks;				//Every block of trace in order of steps
+
+
+/**
+ *Function declarations
+ */
+bool readIndex(FILE * );
+bool readBlock(FILE * , int , vector<unsigned char> & , unsigned long long * );
+void printEvent(unsigned long long , const traceEvent * );
+
+
+/**
+ *Accepting command line arguments for trace file
+ */
+int main(int argc, char const *argv[])
+{
+	FILE *fileTrace;
+	vector<unsigned char> block;
+	traceState *state;
+	traceEvent event;
+	const unsigned char *p,*end;
+	unsigned long long seek=0,count=~0ULL,records,step,printed=0,value;
+	int i,first,last,middle;
+	long bytes;
+	bool isStats=false;
+
+	for(i=1;i<argc && argv[i][0] == '-';i++)
+	{
+		if(!strcmp(argv[i],"--help"))
+		{
+			printf("\n\t\tcass-trace: Usage: %s [options] trace_file\n\t\t[options]\t--seek=N \t Start from Nth instruction executed, counting from 0\n",argv[0]);
+			printf("\t\t\t\t--count=N \t Print N instructions\n\t\t\t\t--stats \t Print blocks, instructions and bytes per instruction only\n");
+			printf("\t\t\t\t-v \t Print all registers at start of each block\n\n");
+			printf("\t\tEvery line is : step address word mneumonic [register=value] [read|write ADDRH=value]\n\n");
+			return 0;
+		}
+		else if(!strcmp(argv[i],"-v"))
+			verbosFlag=1;
+		else if(!strncmp(argv[i],"--seek=",7))
+			seek = strtoull(argv[i]+7,NULL,10);
+		else if(!strncmp(argv[i],"--count=",8))
+			count = strtoull(argv[i]+8,NULL,10);
+		else if(!strcmp(argv[i],"--stats"))
+			isStats = true;
+		else
+		{
+			fprintf(stderr,"cass-trace: Unknown option \"%s\"\nFor help use %s --help\n",argv[i],argv[0]);
+			return 1;
+		}
+	}
+	if(i != argc-1)
+	{
+		printf("cass-trace: Usage: %s [options] trace_file\nFor help use %s --help\n",argv[0],argv[0]);
+		return 0;
+	}
+
+	fileTrace = fopen(argv[i],"rb");
+	if(!fileTrace)
+	{
+		fprintf(stderr,"cass-trace: Trace file \"%s\" not found !!\n",argv[i]);
+		return 1;
+	}
+	if(!readIndex(fileTrace))
+	{
+		fprintf(stderr,"cass-trace: \"%s\" is not a trace written by cass-sim\n",argv[i]);
+		return 1;
+	}
+	if(isStats)
+	{
+		fseek(fileTrace,0,SEEK_END);
+		bytes = ftell(fileTrace);
+		records = 0;
+		if(!blocks.empty() && readBlock(fileTrace,blocks.size()-1,block,&records))
+			records += blocks.back().firstStep;
+		printf("%d blocks, %llu instructions, %ld bytes (%.2f bytes per instruction)\n",(int)blocks.size(),records,
+			bytes,records ? (double)bytes/records : 0.0);
+		return 0;
+	}
+
+	//Last block starting at or before seek holds it
+	first = 0;
+	last = blocks.size()-1;
+	while(first < last)
+	{
+		middle = (first + last + 1)/2;
+		if(blocks[middle].firstStep <= seek)
+			first = middle;
+		else
+			last = middle-1;
+	}
+
+	state = new traceState();
+	for(i=first;i<(int)blocks.size() && printed < count;i++)
+	{
+		if(!readBlock(fileTrace,i,block,&records))
+		{
+			fprintf(stderr,"cass-trace: Block %d is corrupt\n",i);
+			return 1;
+		}
+		p = block.data();
+		end = p + block.size();
+		beginTraceBlock(state,NULL);
+		for(middle=0;middle<TRACE_REGS;middle++)
+		{
+			if(!getVarint(&p,end,&value))
+			{
+				fprintf(stderr,"cass-trace: Block %d is corrupt\n",i);
+				return 1;
+			}
+			state->regs[middle] = (unsigned int)value;
+		}
+		if(verbosFlag && blocks[i].firstStep + records > seek)
+		{
+			printf("; registers at step %llu :",blocks[i].firstStep);
+			for(middle=0;middle<TRACE_REGS;middle++)
+				printf(" %s=%d",registerName[middle],(int)state->regs[middle]);
+			printf("\n");
+		}
+		for(step=blocks[i].firstStep;step < blocks[i].firstStep + records && printed < count;step++)
+		{
+			if(!decodeTraceEvent(state,&p,end,&event))
+			{
+				fprintf(stderr,"cass-trace: Block %d is corrupt at step %llu\n",i,step);
+				return 1;
+			}
+			if(step < seek)
+				continue;
+			printEvent(step,&event);
+			printed++;
+		}
+	}
+	delete state;
+	fclose(fileTrace);
+	return 0;
+}
+
+
+/**
+ *Function to read index of blocks from end of trace
+ *Trace which was not closed properly has no index, its blocks are then found one by one
+ *@param 	FILE* fileTrace 				//Trace file
+ *@return false if file is not a trace
+ */
+bool readIndex(FILE * fileTrace)
+{
+	unsigned char header[TRACE_BLOCK_HEADER];
+	unsigned long long offset,size;
+	blockEntry entry;
+	int i,count;
+
+	if(fread(header,1,8,fileTrace) != 8 || memcmp(header,TRACE_MAGIC,8))
+		return false;
+	fseek(fileTrace,0,SEEK_END);
+	size = ftell(fileTrace);
+	if(size >= 8 + TRACE_FOOTER && !fseek(fileTrace,size - TRACE_FOOTER,SEEK_SET)
+		&& fread(header,1,TRACE_FOOTER,fileTrace) == TRACE_FOOTER && !memcmp(header+12,TRACE_INDEX_MAGIC,8))
+	{
+		offset = getLittle(header,8);
+		count = getLittle(header+8,4);
+		if(offset + 16ULL*count + TRACE_FOOTER == size)
+		{
+			fseek(fileTrace,offset,SEEK_SET);
+			for(i=0;i<count && fread(header,1,16,fileTrace) == 16;i++)
+			{
+				entry.firstStep = getLittle(header,8);
+				entry.offset = getLittle(header+8,8);
+				blocks.push_back(entry);
+			}
+			if((int)blocks.size() == count)
+				return true;
+			blocks.clear();
+		}
+	}
+
+	fprintf(stderr,"cass-trace: Trace has no index, it was not closed properly. Reading its blocks\n");
+	for(offset=8;offset + TRACE_BLOCK_HEADER <= size;offset += TRACE_BLOCK_HEADER + getLittle(header+4,4))
+	{
+		fseek(fileTrace,offset,SEEK_SET);
+		if(fread(header,1,TRACE_BLOCK_HEADER,fileTrace) != TRACE_BLOCK_HEADER
+			|| offset + TRACE_BLOCK_HEADER + getLittle(header+4,4) > size)
+			break;
+		entry.firstStep = getLittle(header+8,8);
+		entry.offset = offset;
+		blocks.push_back(entry);
+	}
+	return true;
+}
+
+
+/**
+ *Function to read and decompress a block
+ *@param 	FILE* fileTrace 				//Trace file
+ *@param 	int index 						//Index of block
+ *@param 	vector<unsigned char>& block 	//Encoded records of block
+ *@param 	unsigned long long* records 	//Number of records in block
+ *@return false if block is corrupt
+ */
+bool readBlock(FILE * fileTrace, int index, vector<unsigned char> & block, unsigned long long * records)
+{
+	unsigned char header[TRACE_BLOCK_HEADER];
+	vector<unsigned char> packed;
+	size_t size,stored;
+
+	if(fseek(fileTrace,blocks[index].offset,SEEK_SET) || fread(header,1,TRACE_BLOCK_HEADER,fileTrace) != TRACE_BLOCK_HEADER)
+		return false;
+	size = getLittle(header,4);
+	stored = getLittle(header+4,4);
+	*records = getLittle(header+16,4);
+	block.resize(size);
+	if(stored == size)						//Block did not compress and is stored as it is
+		return fread(block.data(),1,size,fileTrace) == size;
+	packed.resize(stored);
+	return fread(packed.data(),1,stored,fileTrace) == stored && decompressLz(packed.data(),stored,block.data(),size);
+}
+
+
+/**
+ *Function to print a record as a line of text
+ *@param 	unsigned long long step 		//Number of instructions executed before it
+ *@param 	traceEvent* event 				//Record
+ *@return void
+ */
+void printEvent(unsigned long long step, const traceEvent * event)
+{
+	instruction ins;
+
+	printf("%llu %u %08X %s",step,event->pc*4,event->word,mneumonicName[decodeWord(event->word,&ins)]);
+	if(event->reg != TRACE_NO_REG)
+		printf(" %s=%d",registerName[event->reg],(int)event->regValue);
+	if(event->memory)
+		printf(" %s %04XH=%d",event->memory == TRACE_READ ? "read" : "write",event->address,(int)event->value);
+	printf("\n");
+}